@@ -0,0 +1,161 @@
+#include "ast.h"
+#include "intern.h"
+#include "parser.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// ========================================
+// helper declaration
+// ========================================
+
+#define BENCH_SRC_SIZE (1024 * 1024)
+#define BENCH_RUNS 20
+
+typedef struct {
+	char *data;
+	int len;
+	int cap;
+} buffer_t;
+
+static unsigned int g_seed;
+
+void buffer_append(buffer_t *buffer, const char *str);
+unsigned int bench_rand();
+void bench_gen_expr(buffer_t *buffer, int depth);
+void bench_gen_literals(buffer_t *buffer);
+void bench_gen_exprs(buffer_t *buffer);
+void bench_gen_chains(buffer_t *buffer);
+double bench_now();
+void bench_run(const char *name, void (*gen)(buffer_t *));
+
+// ========================================
+// main definition
+// ========================================
+
+int main() {
+	bench_run("literals", bench_gen_literals);
+	bench_run("exprs", bench_gen_exprs);
+	bench_run("chains", bench_gen_chains);
+	return 0;
+}
+
+// ========================================
+// helper definition
+// ========================================
+
+void buffer_append(buffer_t *buffer, const char *str) {
+	int len = strlen(str);
+	if (buffer->cap <= buffer->len + len) {
+		buffer->cap = (buffer->cap + len + 1) * 2;
+		buffer->data = realloc(buffer->data, buffer->cap);
+		if (buffer->data == NULL) {
+			perror("something went wrong with realloc in buffer_append");
+			exit(1);
+		}
+	}
+	memcpy(buffer->data + buffer->len, str, len);
+	buffer->len += len;
+}
+
+unsigned int bench_rand() {
+	g_seed = g_seed * 1103515245u + 12345u;
+	return g_seed >> 8;
+}
+
+void bench_gen_expr(buffer_t *buffer, int depth) {
+	static const char *binary_ops[] = {
+		" + ", " - ", " * ", " / ", " % ", " << ", " >> ", " < ", " <= ", " > ", " >= ",
+		" == ", " != ", " & ", " ^ ", " | ", " && ", " || ",
+	};
+	static const char *unary_ops[] = {"-", "+", "!", "~"};
+	static const char *operands[] = {"a", "b", "c", "d", "1", "2", "42", "7"};
+
+	int choice = depth <= 0 ? 0 : bench_rand() % 8;
+	switch (choice) {
+	case 0:
+	case 1:
+		buffer_append(buffer, operands[bench_rand() % 8]);
+		break;
+	case 2:
+		buffer_append(buffer, unary_ops[bench_rand() % 4]);
+		bench_gen_expr(buffer, depth - 1);
+		break;
+	case 3:
+		buffer_append(buffer, "(");
+		bench_gen_expr(buffer, depth - 1);
+		buffer_append(buffer, ")");
+		break;
+	case 4:
+		bench_gen_expr(buffer, depth - 1);
+		buffer_append(buffer, " ? ");
+		bench_gen_expr(buffer, depth - 1);
+		buffer_append(buffer, " : ");
+		bench_gen_expr(buffer, depth - 1);
+		break;
+	default:
+		bench_gen_expr(buffer, depth - 1);
+		buffer_append(buffer, binary_ops[bench_rand() % 18]);
+		bench_gen_expr(buffer, depth - 1);
+		break;
+	}
+}
+
+void bench_gen_literals(buffer_t *buffer) {
+	while (buffer->len < BENCH_SRC_SIZE) {
+		buffer_append(buffer, "print 1;\n");
+	}
+}
+
+void bench_gen_exprs(buffer_t *buffer) {
+	while (buffer->len < BENCH_SRC_SIZE) {
+		buffer_append(buffer, "a = ");
+		bench_gen_expr(buffer, 6);
+		buffer_append(buffer, ";\n");
+	}
+}
+
+void bench_gen_chains(buffer_t *buffer) {
+	while (buffer->len < BENCH_SRC_SIZE) {
+		buffer_append(buffer, "a = b = ");
+		for (int i = 0; i < 16; i++) {
+			buffer_append(buffer, "a + b * c - ");
+		}
+		buffer_append(buffer, "d;\n");
+	}
+}
+
+double bench_now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void bench_run(const char *name, void (*gen)(buffer_t *)) {
+	buffer_t buffer = {};
+	g_seed = 1;
+	gen(&buffer);
+
+	double best = -1;
+	for (int run = 0; run < BENCH_RUNS; run++) {
+		intern_init();
+
+		double start = bench_now();
+		ast_t *ast = parse_stream(name, buffer.data, buffer.len);
+		double elapsed = bench_now() - start;
+		if (ast == NULL) {
+			exit(1);
+		}
+
+		ast_free(ast);
+		intern_free();
+
+		if (best < 0 || elapsed < best) best = elapsed;
+	}
+
+	printf("parser %-10s %10d bytes %9.2f ms %9.2f MB/s\n", name, buffer.len, best * 1000,
+		buffer.len / best / (1024 * 1024));
+	free(buffer.data);
+}
@@ -0,0 +1,181 @@
+#!/usr/bin/env python3
+"""Performance regression gate for smol.
+
+Runs the generated benchmark workloads (see bench/smol.c) through the smol
+binary several times, computes the median and a 95% confidence interval of
+the compile time, the run time and the peak RSS of every workload, and
+compares them with a checked-in baseline.
+
+A metric regresses when it is slower (or bigger) than the baseline by more
+than the allowed margin and a one-sided Mann-Whitney U test says the
+difference is significant. The exit code is 1 when anything regresses.
+
+    python3 bench/regress.py --smol build/smol_bench --bench build/bench_smol
+    python3 bench/regress.py ... --update    # rewrite the baseline
+"""
+
+import argparse
+import json
+import math
+import os
+import random
+import subprocess
+import sys
+import tempfile
+
+METRICS = ("compile_ms", "run_ms", "peak_rss_kb")
+COMPILE_PHASES = ("read_file", "tokenize", "parse", "analyze", "generate_ir")
+BOOTSTRAP_ROUNDS = 2000
+
+
+def median(values):
+    values = sorted(values)
+    mid = len(values) // 2
+    if len(values) % 2:
+        return values[mid]
+    return (values[mid - 1] + values[mid]) / 2
+
+
+def median_ci(values, rng):
+    """95% percentile bootstrap interval of the median."""
+    medians = sorted(median(rng.choices(values, k=len(values))) for _ in range(BOOTSTRAP_ROUNDS))
+    return medians[int(0.025 * BOOTSTRAP_ROUNDS)], medians[int(0.975 * BOOTSTRAP_ROUNDS) - 1]
+
+
+def mann_whitney_greater(current, baseline):
+    """One-sided p-value that current tends to be greater than baseline
+    (normal approximation with tie and continuity correction)."""
+    values = sorted([(v, 0) for v in current] + [(v, 1) for v in baseline])
+    ranks = [0.0] * len(values)
+    ties = 0.0
+    i = 0
+    while i < len(values):
+        j = i
+        while j + 1 < len(values) and values[j + 1][0] == values[i][0]:
+            j += 1
+        for k in range(i, j + 1):
+            ranks[k] = (i + j) / 2 + 1
+        count = j - i + 1
+        ties += count ** 3 - count
+        i = j + 1
+
+    n1, n2 = len(current), len(baseline)
+    n = n1 + n2
+    u = sum(rank for rank, (_, group) in zip(ranks, values) if group == 0) - n1 * (n1 + 1) / 2
+    mean = n1 * n2 / 2
+    var = n1 * n2 / 12 * ((n + 1) - ties / (n * (n - 1)))
+    if var <= 0:
+        return 1.0
+    z = (u - mean - 0.5) / math.sqrt(var)
+    return 0.5 * math.erfc(z / math.sqrt(2))
+
+
+def run_once(smol, path):
+    """Run smol on one program and return its compile time, run time and peak RSS."""
+    proc = subprocess.Popen([smol, "--stats-json", path], stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
+    stderr = proc.stderr.read()
+    _, status, usage = os.wait4(proc.pid, 0)
+    proc.returncode = os.waitstatus_to_exitcode(status)
+    if proc.returncode != 0:
+        sys.exit("%s failed on %s:\n%s" % (smol, path, stderr.decode(errors="replace")))
+
+    stats = json.loads(stderr.decode().strip().splitlines()[-1])
+    phases = stats["phases_ms"]
+    return {
+        "compile_ms": sum(phases[name] or 0 for name in COMPILE_PHASES),
+        "run_ms": phases["vm_run"],
+        "peak_rss_kb": usage.ru_maxrss,
+    }
+
+
+def measure(smol, bench, runs):
+    with tempfile.TemporaryDirectory() as tmp:
+        subprocess.run([bench, "--write", tmp], check=True)
+        names = sorted(name[:-len(".smol")] for name in os.listdir(tmp) if name.endswith(".smol"))
+        samples = {name: {metric: [] for metric in METRICS} for name in names}
+
+        # the workloads take turns so a slow moment of the machine is spread over all of them
+        for _ in range(runs):
+            for name in names:
+                result = run_once(smol, os.path.join(tmp, name + ".smol"))
+                for metric in METRICS:
+                    samples[name][metric].append(result[metric])
+    return samples
+
+
+def summarize(samples, rng):
+    summary = {}
+    for name, metrics in samples.items():
+        summary[name] = {}
+        for metric, values in metrics.items():
+            low, high = median_ci(values, rng)
+            summary[name][metric] = {"median": median(values), "ci95": [low, high], "samples": values}
+    return summary
+
+
+def compare(summary, baseline, args):
+    margins = {"compile_ms": args.time_margin, "run_ms": args.time_margin, "peak_rss_kb": args.rss_margin}
+    regressions = 0
+    print("%-10s %-12s %24s %24s %8s  %s" % ("workload", "metric", "baseline [95% ci]", "current [95% ci]",
+        "change", "verdict"))
+    for name in sorted(summary):
+        if name not in baseline["workloads"]:
+            print("%-10s (not in the baseline)" % name)
+            continue
+        for metric in METRICS:
+            cur = summary[name][metric]
+            base = baseline["workloads"][name][metric]
+            change = cur["median"] / base["median"] - 1 if base["median"] > 0 else 0.0
+            p = mann_whitney_greater(cur["samples"], base["samples"])
+
+            # tiny timings are noise, so a slowdown must also be a few tenths of a millisecond
+            floor = args.min_ms if metric != "peak_rss_kb" else 0
+            regressed = (change > margins[metric] and p < args.alpha and
+                cur["median"] - base["median"] > floor)
+            regressions += regressed
+            print("%-10s %-12s %10.2f [%5.2f, %5.2f] %10.2f [%5.2f, %5.2f] %+7.1f%%  %s" % (name, metric,
+                base["median"], base["ci95"][0], base["ci95"][1], cur["median"], cur["ci95"][0], cur["ci95"][1],
+                change * 100, "REGRESSION (p=%.3f)" % p if regressed else "ok"))
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare smol benchmarks with a stored baseline.")
+    parser.add_argument("--smol", default="build/smol_bench", help="smol binary to measure")
+    parser.add_argument("--bench", default="build/bench_smol", help="bench binary that writes the workloads")
+    parser.add_argument("--baseline", default=os.path.join(os.path.dirname(__file__), "baseline.json"))
+    parser.add_argument("--runs", type=int, default=7, help="runs of every workload")
+    parser.add_argument("--alpha", type=float, default=0.01, help="significance level of the test")
+    parser.add_argument("--time-margin", type=float, default=0.10, help="allowed relative slowdown")
+    parser.add_argument("--rss-margin", type=float, default=0.05, help="allowed relative growth of peak RSS")
+    parser.add_argument("--min-ms", type=float, default=0.5, help="smallest slowdown in ms that counts")
+    parser.add_argument("--update", action="store_true", help="write the measurements as the new baseline")
+    args = parser.parse_args()
+
+    rng = random.Random(1)
+    summary = summarize(measure(args.smol, args.bench, args.runs), rng)
+
+    if args.update:
+        with open(args.baseline, "w") as fd:
+            json.dump({"runs": args.runs, "workloads": summary}, fd, indent=1, sort_keys=True)
+            fd.write("\n")
+        print("baseline written to %s" % args.baseline)
+        return 0
+
+    try:
+        with open(args.baseline) as fd:
+            baseline = json.load(fd)
+    except FileNotFoundError:
+        print("no baseline at %s (run with --update to create it)" % args.baseline, file=sys.stderr)
+        return 2
+
+    regressions = compare(summary, baseline, args)
+    if regressions:
+        print("%d regression(s)" % regressions)
+        return 1
+    print("no regressions")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
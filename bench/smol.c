@@ -0,0 +1,351 @@
+#include "analyzer.h"
+#include "ast.h"
+#include "intern.h"
+#include "ir.h"
+#include "lexer.h"
+#include "parser.h"
+#include "st.h"
+#include "vm.h"
+
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// ========================================
+// helper declaration
+// ========================================
+
+#define BENCH_RUNS 5
+#define BENCH_LINE_SIZE 256
+
+typedef struct {
+	char *data;
+	int len;
+	int cap;
+} buffer_t;
+
+// Phases of the pipeline, timed one by one
+enum {
+	BENCH_TOKENIZE = 0,
+	BENCH_PARSE,
+	BENCH_ANALYZE,
+	BENCH_GENERATE_IR,
+	BENCH_INLINE,
+	BENCH_VM_RUN,
+	BENCH_PHASES,
+};
+
+static const char *g_phase_names[BENCH_PHASES] = {
+	"tokenize",
+	"parse",
+	"analyze",
+	"generate_ir",
+	"inline",
+	"vm_run",
+};
+
+typedef struct {
+	const char *name;
+	void (*gen)(buffer_t *);
+} bench_t;
+
+static unsigned int g_seed;
+
+void buffer_append(buffer_t *buffer, const char *str);
+void buffer_printf(buffer_t *buffer, const char *format, ...);
+unsigned int bench_rand();
+void bench_gen_expr(buffer_t *buffer, int depth);
+void bench_gen_arith(buffer_t *buffer);
+void bench_gen_branches(buffer_t *buffer);
+void bench_gen_print(buffer_t *buffer);
+void bench_gen_straight(buffer_t *buffer);
+void bench_gen_deep(buffer_t *buffer);
+void bench_gen_names(buffer_t *buffer);
+double bench_now();
+void bench_run(const char *name, void (*gen)(buffer_t *));
+void bench_write(const char *dir, const char *name, void (*gen)(buffer_t *));
+
+static const bench_t g_benches[] = {
+	{"arith", bench_gen_arith},		// tight arithmetic loop
+	{"branches", bench_gen_branches},	// branch-heavy state machine
+	{"print", bench_gen_print},		// print-heavy output
+	{"straight", bench_gen_straight},	// huge straight-line program
+	{"deep", bench_gen_deep},		// deeply nested expressions
+	{"names", bench_gen_names},		// many variables and labels
+};
+
+#define BENCH_COUNT ((int) (sizeof(g_benches) / sizeof(g_benches[0])))
+
+// ========================================
+// main definition
+// ========================================
+
+int main(int argc, const char **argv) {
+	// --write <dir> only writes the generated programs, so they can be run by smol itself
+	if (argc == 3 && strcmp(argv[1], "--write") == 0) {
+		for (int i = 0; i < BENCH_COUNT; i++) {
+			bench_write(argv[2], g_benches[i].name, g_benches[i].gen);
+		}
+		return 0;
+	}
+	if (argc != 1) {
+		fprintf(stderr, "USAGE: %s [--write <dir>]\n", argv[0]);
+		return 1;
+	}
+
+	for (int i = 0; i < BENCH_COUNT; i++) {
+		bench_run(g_benches[i].name, g_benches[i].gen);
+	}
+	return 0;
+}
+
+// ========================================
+// helper definition
+// ========================================
+
+void buffer_append(buffer_t *buffer, const char *str) {
+	int len = strlen(str);
+	if (buffer->cap <= buffer->len + len) {
+		buffer->cap = (buffer->cap + len + 1) * 2;
+		buffer->data = realloc(buffer->data, buffer->cap);
+		if (buffer->data == NULL) {
+			perror("something went wrong with realloc in buffer_append");
+			exit(1);
+		}
+	}
+	memcpy(buffer->data + buffer->len, str, len);
+	buffer->len += len;
+	buffer->data[buffer->len] = '\0';
+}
+
+void buffer_printf(buffer_t *buffer, const char *format, ...) {
+	char line[BENCH_LINE_SIZE];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(line, sizeof(line), format, args);
+	va_end(args);
+	buffer_append(buffer, line);
+}
+
+unsigned int bench_rand() {
+	g_seed = g_seed * 1103515245u + 12345u;
+	return g_seed >> 8;
+}
+
+void bench_gen_expr(buffer_t *buffer, int depth) {
+	// no division, so the programs never divide by zero
+	static const char *binary_ops[] = {" + ", " - ", " * ", " & ", " ^ ", " | ", " < ", " == "};
+	static const char *operands[] = {"a", "b", "c", "d", "1", "2", "42", "7"};
+
+	if (depth <= 0) {
+		buffer_append(buffer, operands[bench_rand() % 8]);
+		return;
+	}
+	buffer_append(buffer, "(");
+	bench_gen_expr(buffer, depth - 1);
+	buffer_append(buffer, binary_ops[bench_rand() % 8]);
+	bench_gen_expr(buffer, depth - 1);
+	buffer_append(buffer, ")");
+}
+
+void bench_gen_arith(buffer_t *buffer) {
+	buffer_append(buffer,
+		"var s = 0;\n"
+		"var i = 0;\n"
+		"while (i < 5000000) {\n"
+		"\ts = (s + i * 7) % 1000003;\n"
+		"\ts ^= i << 3;\n"
+		"\t++i;\n"
+		"}\n"
+		"print s;\n");
+}
+
+void bench_gen_branches(buffer_t *buffer) {
+	buffer_append(buffer,
+		"var state = 0;\n"
+		"var n = 0;\n"
+		"var acc = 0;\n"
+		"while (n < 2000000) {\n"
+		"\tswitch (state) {\n"
+		"\tcase 0: if (n & 1) state = 1; else state = 2;\n"
+		"\tcase 1: { acc += 3; state = 3; }\n"
+		"\tcase 2: { acc -= 1; state = n % 3 == 0 ? 4 : 3; }\n"
+		"\tcase 3: if (acc > 1000) { acc = 0; state = 0; } else state = 4;\n"
+		"\tdefault: state = 0;\n"
+		"\t}\n"
+		"\t++n;\n"
+		"}\n"
+		"print acc;\n");
+}
+
+void bench_gen_print(buffer_t *buffer) {
+	buffer_append(buffer,
+		"var i = 0;\n"
+		"while (i < 500000) {\n"
+		"\tprint i * 31 % 100003;\n"
+		"\t++i;\n"
+		"}\n");
+}
+
+void bench_gen_straight(buffer_t *buffer) {
+	buffer_append(buffer, "var a = 1;\nvar b = 2;\nvar c = 3;\nvar d = 4;\n");
+	for (int i = 0; i < 40000; i++) {
+		buffer_printf(buffer, "a = b + c * %d;\n", i % 97);
+		buffer_append(buffer, "b = a - d;\n");
+		buffer_append(buffer, "c = c ^ a;\n");
+		buffer_printf(buffer, "d = d + %d;\n", i % 13);
+	}
+	buffer_append(buffer, "print a + b + c + d;\n");
+}
+
+void bench_gen_deep(buffer_t *buffer) {
+	buffer_append(buffer, "var a = 1;\nvar b = 2;\nvar c = 3;\nvar d = 4;\n");
+	for (int i = 0; i < 200; i++) {
+		buffer_append(buffer, "a = ");
+		bench_gen_expr(buffer, 10);
+		buffer_append(buffer, ";\n");
+	}
+
+	// one long chain of nested parentheses
+	buffer_append(buffer, "b = ");
+	for (int i = 0; i < 20000; i++) buffer_append(buffer, "(1 + ");
+	buffer_append(buffer, "a");
+	for (int i = 0; i < 20000; i++) buffer_append(buffer, ")");
+	buffer_append(buffer, ";\nprint a + b;\n");
+}
+
+void bench_gen_names(buffer_t *buffer) {
+	// every variable is read by the next one and every label jumps forward
+	buffer_append(buffer, "var v0 = 1;\n");
+	for (int i = 1; i < 20000; i++) {
+		buffer_printf(buffer, "var v%d = v%d + %d;\n", i, i - 1, i % 7);
+		buffer_printf(buffer, "if (v%d < 0) goto l%d;\n", i, i);
+		buffer_printf(buffer, "l%d:\n", i);
+	}
+	buffer_append(buffer, "print v19999;\n");
+}
+
+double bench_now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void bench_run(const char *name, void (*gen)(buffer_t *)) {
+	buffer_t buffer = {};
+	g_seed = 1;
+	gen(&buffer);
+
+	// the output of the programs is thrown away
+	fflush(stdout);
+	int saved_stdout = dup(STDOUT_FILENO);
+	int null_fd = open("/dev/null", O_WRONLY);
+	if (saved_stdout < 0 || null_fd < 0) {
+		perror("something went wrong while opening /dev/null in bench_run");
+		exit(1);
+	}
+
+	double best[BENCH_PHASES];
+	int instructions = 0;
+	long long executed = 0;
+	for (int run = 0; run < BENCH_RUNS; run++) {
+		double times[BENCH_PHASES];
+		intern_init();
+
+		double start = bench_now();
+		token_t *tokens = tokenize(name, buffer.data, buffer.len);
+		times[BENCH_TOKENIZE] = bench_now() - start;
+		if (tokens == NULL) {
+			exit(1);
+		}
+
+		start = bench_now();
+		ast_t *ast = parse(tokens);
+		times[BENCH_PARSE] = bench_now() - start;
+		if (ast == NULL) {
+			exit(1);
+		}
+		lexer_free_tokens(tokens);
+
+		st_init();
+		st_create_type("int");
+		st_create_type("int[]");
+		st_create_type("i64");
+		st_create_type("bigint");
+
+		start = bench_now();
+		int error = analyze(ast);
+		times[BENCH_ANALYZE] = bench_now() - start;
+		if (error) {
+			exit(1);
+		}
+
+		ir_builder_t builder;
+		ir_builder_init(&builder);
+		start = bench_now();
+		ir_t *ir_list = generate_ir(&builder, ast);
+		times[BENCH_GENERATE_IR] = bench_now() - start;
+		ast_free(ast);
+
+		start = bench_now();
+		ir_list = ir_inline(&builder);
+		times[BENCH_INLINE] = bench_now() - start;
+
+		dup2(null_fd, STDOUT_FILENO);
+		start = bench_now();
+		vm_run(ir_list);
+		fflush(stdout);
+		times[BENCH_VM_RUN] = bench_now() - start;
+		dup2(saved_stdout, STDOUT_FILENO);
+
+		instructions = builder.len;
+		executed = vm_executed();
+		ir_builder_free(&builder);
+		st_free();
+		intern_free();
+
+		for (int i = 0; i < BENCH_PHASES; i++) {
+			if (run == 0 || times[i] < best[i]) best[i] = times[i];
+		}
+	}
+	close(null_fd);
+	close(saved_stdout);
+
+	// one JSON object per line; compile phases in MB/s of source, the vm in
+	// millions of executed instructions per second
+	printf("{\"bench\": \"%s\", \"bytes\": %d, \"ir_instructions\": %d, \"executed_instructions\": %lld, \"ms\": {",
+		name, buffer.len, instructions, executed);
+	for (int i = 0; i < BENCH_PHASES; i++) {
+		printf("%s\"%s\": %.3f", i ? ", " : "", g_phase_names[i], best[i] * 1e3);
+	}
+	printf("}, \"throughput\": {");
+	for (int i = 0; i < BENCH_VM_RUN; i++) {
+		printf("\"%s_mb_s\": %.2f, ", g_phase_names[i], buffer.len / best[i] / (1024 * 1024));
+	}
+	printf("\"vm_run_mips\": %.2f}}\n", executed / best[BENCH_VM_RUN] / 1e6);
+	fflush(stdout);
+	free(buffer.data);
+}
+
+void bench_write(const char *dir, const char *name, void (*gen)(buffer_t *)) {
+	buffer_t buffer = {};
+	g_seed = 1;
+	gen(&buffer);
+
+	char path[1024];
+	snprintf(path, sizeof(path), "%s/%s.smol", dir, name);
+	FILE *fd = fopen(path, "w");
+	if (fd == NULL) {
+		char message[1100];
+		snprintf(message, sizeof(message), "Error opening '%s'", path);
+		perror(message);
+		exit(1);
+	}
+	fwrite(buffer.data, 1, buffer.len, fd);
+	fclose(fd);
+	free(buffer.data);
+}
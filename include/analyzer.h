@@ -12,4 +12,32 @@
  */
 int analyze(ast_t *ast);
 
+/**
+ * Start analyzing a program one statement at a time
+ */
+void analyze_begin();
+
+/**
+ * Analyze the next statement of the program started by analyze_begin
+ *
+ * Parameters:
+ * 	stmt	The ast of the statement
+ *
+ * Returns:
+ * 	0 (if no error)
+ * 	1 (if error)
+ */
+int analyze_stmt(ast_t *stmt);
+
+/**
+ * Finish the program started by analyze_begin and release the analyzer memory
+ *
+ * Labels used by a goto before their declaration are checked here.
+ *
+ * Returns:
+ * 	0 (if no error)
+ * 	1 (if error)
+ */
+int analyze_end();
+
 #endif // ANALYZER_H
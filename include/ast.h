@@ -12,15 +12,35 @@ enum {
 	AST_BINARY,
 	AST_TERNARY,
 	AST_IDENTIFIER,
+	AST_INDEX,
+	AST_BUILTIN,
 	AST_PROG,
 	AST_LABEL_STMT,
 	AST_VAR_STMT,
 	AST_PRINT_STMT,
 	AST_GOTO_STMT,
+	AST_PROC_STMT,
+	AST_CALL_STMT,
+	AST_RETURN_STMT,
 	AST_IF_STMT,
+	AST_WHILE_STMT,
+	AST_FOR_STMT,
+	AST_SWITCH_STMT,
+	AST_CASE_STMT,
+	AST_BLOCK_STMT,
 	AST_EXPR_STMT,
 };
 
+// Built-in functions working on whole arrays
+enum {
+	BUILTIN_LEN,	// len(array): number of elements
+	BUILTIN_FILL,	// fill(array, value): set every element, evaluates to the length
+	BUILTIN_COPY,	// copy(dst, src): copy the common prefix, evaluates to the length of dst
+	BUILTIN_SUM,	// sum(array): wrapping sum of the elements
+	BUILTIN_MIN,	// min(array): smallest element
+	BUILTIN_MAX,	// max(array): largest element
+};
+
 struct ast_t {
 	int type;
 	pos_t start;
@@ -31,73 +51,145 @@ struct ast_t {
 	int type_id;	// for type related information
 	int label_id;	// for label related information
 	int var_id;	// for variable related information
-
-	struct {
-		token_t token;
-	} literal;
-
-	struct {
-		token_t op;
-		struct ast_t *right;
-	} unary;
-
-	struct {
-		struct ast_t *left;
-		token_t op;
-		struct ast_t *right;
-	} binary;
-
-	struct {
-		struct ast_t *left;
-		struct ast_t *mid;
-		struct ast_t *right;
-	} ternary;
-
-	struct {
-		token_t token;
-	} identifier;
-
-	struct {
-		struct ast_t *expr;
-		token_t semicolon;
-	} expr_stmt;
-
-	struct {
-		token_t label;
-		token_t colon;
-	} label_stmt;
-
-	struct {
-		token_t var_keyword;
-		token_t name;
-		struct ast_t *expr;
-		token_t semicolon;
-	} var_stmt;
-
-	struct {
-		token_t print_keyword;
-		struct ast_t *expr;
-		token_t semicolon;
-	} print_stmt;
-
-	struct {
-		token_t goto_keyword;
-		token_t label;
-		token_t semicolon;
-	} goto_stmt;
-
-	struct {
-		token_t if_keyword;
-		struct ast_t *if_cond;
-		struct ast_t *if_block;
-		struct ast_t *else_block;
-	} if_stmt;
-
-	struct {
-		struct ast_t **stmts;
-		int cap;
-		int len;
-	} prog;
+	int proc_id;	// for procedure related information
+
+	// only the member matching type is valid
+	union {
+		struct {
+			token_t token;
+		} literal;
+
+		struct {
+			token_t op;
+			struct ast_t *right;
+		} unary;
+
+		struct {
+			struct ast_t *left;
+			token_t op;
+			struct ast_t *right;
+		} binary;
+
+		struct {
+			struct ast_t *left;
+			struct ast_t *mid;
+			struct ast_t *right;
+		} ternary;
+
+		struct {
+			token_t token;
+		} identifier;
+
+		struct {
+			struct ast_t *array;	// identifier of the array
+			struct ast_t *expr;	// index expression
+			token_t rbracket;
+		} index;
+
+		struct {
+			token_t name;
+			struct ast_t **args;	// arguments in source order
+			int cap;
+			int len;
+			int kind;		// BUILTIN_* (set by the analyzer)
+		} builtin;
+
+		struct {
+			struct ast_t *expr;
+			token_t semicolon;
+		} expr_stmt;
+
+		struct {
+			token_t label;
+			token_t colon;
+		} label_stmt;
+
+		struct {
+			token_t var_keyword;
+			token_t name;
+			struct ast_t *type;	// identifier of the declared type (null if inferred)
+			struct ast_t *size;	// length literal of an array (null for scalars)
+			struct ast_t *expr;
+			token_t semicolon;
+		} var_stmt;
+
+		struct {
+			token_t print_keyword;
+			struct ast_t *expr;
+			token_t semicolon;
+		} print_stmt;
+
+		struct {
+			token_t goto_keyword;
+			token_t label;
+			token_t semicolon;
+		} goto_stmt;
+
+		struct {
+			token_t proc_keyword;
+			token_t name;
+			struct ast_t *body;	// block stmt
+		} proc_stmt;
+
+		struct {
+			token_t call_keyword;
+			token_t name;
+			token_t semicolon;
+		} call_stmt;
+
+		struct {
+			token_t return_keyword;
+			token_t semicolon;
+		} return_stmt;
+
+		struct {
+			token_t if_keyword;
+			struct ast_t *if_cond;
+			struct ast_t *if_block;
+			struct ast_t *else_block;
+		} if_stmt;
+
+		struct {
+			token_t while_keyword;
+			struct ast_t *cond;
+			struct ast_t *body;
+		} while_stmt;
+
+		struct {
+			token_t for_keyword;
+			struct ast_t *init;	// null if missing
+			struct ast_t *cond;	// null if missing
+			struct ast_t *step;	// null if missing
+			struct ast_t *body;
+		} for_stmt;
+
+		struct {
+			token_t switch_keyword;
+			struct ast_t *expr;
+			struct ast_t **cases;	// case stmts in source order
+			int cap;
+			int len;
+		} switch_stmt;
+
+		struct {
+			token_t case_keyword;	// 'case' or 'default'
+			struct ast_t *value;	// literal or negated literal (null for default)
+			int number;		// value of the case (set by the analyzer)
+			struct ast_t *body;	// block stmt of the statements after the colon
+		} case_stmt;
+
+		struct {
+			struct ast_t **stmts;
+			int cap;
+			int len;
+		} block_stmt;
+
+		struct {
+			struct ast_t **stmts;
+			int cap;
+			int len;
+		} prog;
+	};
 };
 
 typedef struct ast_t ast_t;
@@ -170,6 +262,48 @@ ast_t *ast_ternary(ast_t *left, ast_t *mid, ast_t *right);
  */
 ast_t *ast_identifier(token_t token);
 
+/**
+ * Create an index ast
+ *
+ * Parameter:
+ * 	array		identifier ast of the indexed array
+ * 	expr		index expression
+ * 	rbracket	closing bracket
+ *
+ * Returns:
+ * 	ast memory
+ */
+ast_t *ast_index(ast_t *array, ast_t *expr, token_t rbracket);
+
+/**
+ * Create a builtin call ast without any argument
+ *
+ * Parameter:
+ * 	name	identifier token of the builtin
+ *
+ * Returns:
+ * 	ast memory
+ */
+ast_t *ast_builtin(token_t name);
+
+/**
+ * Append argument to the builtin call ast
+ *
+ * Parameters:
+ * 	builtin	The builtin ast where arg is appended
+ * 	arg	Argument that is appended
+ */
+void ast_builtin_append(ast_t *builtin, ast_t *arg);
+
+/**
+ * Close the builtin call ast
+ *
+ * Parameters:
+ * 	builtin	The builtin ast
+ * 	rparen	closing parenthesis
+ */
+void ast_builtin_close(ast_t *builtin, token_t rparen);
+
 /**
  * Create a expr stmt ast
  *
@@ -200,13 +334,15 @@ ast_t *ast_label_stmt(token_t label, token_t colon);
  * Parameter:
  * 	var_keyword	var keyword
  * 	name		name of the variable
+ * 	type		identifier of the declared type (NULL if inferred)
+ * 	size		length literal of an array (NULL for scalars)
  * 	expr		initialize expr (NULL if no expression)
  * 	semicolon	semicolon at the end of the statement
  *
  * Returns:
  * 	ast memory
  */
-ast_t *ast_var_stmt(token_t var_keyword, token_t name, ast_t *expr, token_t semicolon);
+ast_t *ast_var_stmt(token_t var_keyword, token_t name, ast_t *type, ast_t *size, ast_t *expr, token_t semicolon);
 
 /**
  * Create a print stmt ast
@@ -234,6 +370,44 @@ ast_t *ast_print_stmt(token_t print_keyword, ast_t *expr, token_t semicolon);
  */
 ast_t *ast_goto_stmt(token_t goto_keyword, token_t label, token_t semicolon);
 
+/**
+ * Create a proc stmt ast
+ *
+ * Parameters:
+ * 	proc_keyword	proc keyword
+ * 	name		name of the procedure
+ * 	body		block stmt run by a call
+ *
+ * Returns:
+ * 	ast memory
+ */
+ast_t *ast_proc_stmt(token_t proc_keyword, token_t name, ast_t *body);
+
+/**
+ * Create a call stmt ast
+ *
+ * Parameters:
+ * 	call_keyword	call keyword
+ * 	name		name of the called procedure
+ * 	semicolon	semicolon at the end of the statement
+ *
+ * Returns:
+ * 	ast memory
+ */
+ast_t *ast_call_stmt(token_t call_keyword, token_t name, token_t semicolon);
+
+/**
+ * Create a return stmt ast
+ *
+ * Parameters:
+ * 	return_keyword	return keyword
+ * 	semicolon	semicolon at the end of the statement
+ *
+ * Returns:
+ * 	ast memory
+ */
+ast_t *ast_return_stmt(token_t return_keyword, token_t semicolon);
+
 /**
  * Create a if stmt ast
  *
@@ -248,6 +422,106 @@ ast_t *ast_goto_stmt(token_t goto_keyword, token_t label, token_t semicolon);
  */
 ast_t *ast_if_stmt(token_t if_keyword, ast_t *if_cond, ast_t *if_block, ast_t *else_block);
 
+/**
+ * Create a while stmt ast
+ *
+ * Parameters:
+ * 	while_keyword	while keyword
+ * 	cond		condition expression
+ * 	body		statement repeated while the condition is true
+ *
+ * Returns:
+ * 	ast memory
+ */
+ast_t *ast_while_stmt(token_t while_keyword, ast_t *cond, ast_t *body);
+
+/**
+ * Create a for stmt ast
+ *
+ * Parameters:
+ * 	for_keyword	for keyword
+ * 	init		expression run once before the loop (null if missing)
+ * 	cond		condition expression (null if missing, loops forever)
+ * 	step		expression run after every iteration (null if missing)
+ * 	body		statement repeated while the condition is true
+ *
+ * Returns:
+ * 	ast memory
+ */
+ast_t *ast_for_stmt(token_t for_keyword, ast_t *init, ast_t *cond, ast_t *step, ast_t *body);
+
+/**
+ * Create a switch stmt ast without any case
+ *
+ * Parameters:
+ * 	switch_keyword	switch keyword
+ * 	expr		expression that selects the case
+ *
+ * Returns:
+ * 	ast memory
+ */
+ast_t *ast_switch_stmt(token_t switch_keyword, ast_t *expr);
+
+/**
+ * Append case to the switch stmt ast
+ *
+ * Parameters:
+ * 	switch_stmt	The switch ast where case_stmt is appended
+ * 	case_stmt	Case that is appended
+ */
+void ast_switch_stmt_append(ast_t *switch_stmt, ast_t *case_stmt);
+
+/**
+ * Close the switch stmt ast
+ *
+ * Parameters:
+ * 	switch_stmt	The switch ast
+ * 	rbrace		closing brace
+ */
+void ast_switch_stmt_close(ast_t *switch_stmt, token_t rbrace);
+
+/**
+ * Create a case stmt ast with an empty body
+ *
+ * Parameters:
+ * 	case_keyword	case or default keyword
+ * 	value		case value (null for default)
+ * 	colon		colon after the case value
+ *
+ * Returns:
+ * 	ast memory
+ */
+ast_t *ast_case_stmt(token_t case_keyword, ast_t *value, token_t colon);
+
+/**
+ * Create an empty block stmt ast
+ *
+ * Parameters:
+ * 	lbrace	opening brace
+ *
+ * Returns:
+ * 	ast memory
+ */
+ast_t *ast_block_stmt(token_t lbrace);
+
+/**
+ * Append stmt to the block stmt ast
+ *
+ * Parameters:
+ * 	block	The block ast where stmt is appended
+ * 	stmt	Statement that is appended
+ */
+void ast_block_stmt_append(ast_t *block, ast_t *stmt);
+
+/**
+ * Close the block stmt ast
+ *
+ * Parameters:
+ * 	block	The block ast
+ * 	rbrace	closing brace
+ */
+void ast_block_stmt_close(ast_t *block, token_t rbrace);
+
 /**
  * Create a prog ast
  *
@@ -265,6 +539,27 @@ ast_t *ast_prog();
  */
 void ast_prog_append(ast_t *prog, ast_t *stmt);
 
+/**
+ * Check if the ast is a statement holding other statements
+ * (if, while, for, switch and block statements)
+ *
+ * Parameters:
+ * 	ast	The ast that is checked
+ *
+ * Returns:
+ * 	1 (if compound statement)
+ * 	0 (otherwise)
+ */
+int ast_is_compound_stmt(ast_t *ast);
+
+/**
+ * Get the number of ast nodes allocated so far (freed ones included)
+ *
+ * Returns:
+ * 	number of ast nodes
+ */
+int ast_count();
+
 /**
  * Print the given ast
  *
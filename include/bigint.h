@@ -0,0 +1,177 @@
+#ifndef BIGINT_H
+#define BIGINT_H
+
+#include <stdint.h>
+
+// A limb is as wide as the widest product the compiler can compute in one
+// step, so 64 bits with a 128 bit integer type and 32 bits otherwise
+#if defined(__SIZEOF_INT128__)
+typedef uint64_t bigint_limb_t;
+#define BIGINT_LIMB_BITS 64
+#else
+typedef uint32_t bigint_limb_t;
+#define BIGINT_LIMB_BITS 32
+#endif
+
+typedef struct {
+	bigint_limb_t *limbs;	// magnitude, least significant limb first
+	int len;		// number of used limbs (0 for zero, no leading zero limbs)
+	int cap;		// number of allocated limbs
+	int negative;		// sign (never set for zero)
+} bigint_t;
+
+/**
+ * Initialize a bigint to zero
+ *
+ * Parameters:
+ * 	x	bigint to initialize
+ */
+void bigint_init(bigint_t *x);
+
+/**
+ * Free the limbs of a bigint (it is zero afterwards)
+ *
+ * Parameters:
+ * 	x	bigint to free
+ */
+void bigint_free(bigint_t *x);
+
+/**
+ * Set a bigint to a machine integer
+ *
+ * Parameters:
+ * 	x	destination
+ * 	value	new value
+ */
+void bigint_set(bigint_t *x, long long value);
+
+/**
+ * Set the bits [32 * index, 32 * index + 32) of a non-negative bigint
+ *
+ * Parameters:
+ * 	x	destination
+ * 	index	index of the 32 bit chunk
+ * 	chunk	new bits of the chunk
+ */
+void bigint_set_chunk(bigint_t *x, int index, unsigned int chunk);
+
+/**
+ * Get the number of 32 bit chunks of the magnitude of a bigint
+ *
+ * Parameters:
+ * 	x	bigint
+ *
+ * Returns:
+ * 	number of chunks (0 for zero)
+ */
+int bigint_chunks(const bigint_t *x);
+
+/**
+ * Get a 32 bit chunk of the magnitude of a bigint
+ *
+ * Parameters:
+ * 	x	bigint
+ * 	index	index of the chunk (least significant first)
+ *
+ * Returns:
+ * 	bits [32 * index, 32 * index + 32) of the magnitude
+ */
+unsigned int bigint_chunk(const bigint_t *x, int index);
+
+/**
+ * Set a bigint to a decimal number
+ *
+ * Parameters:
+ * 	x	destination
+ * 	str	decimal digits (need not be NUL terminated)
+ * 	len	number of digits
+ */
+void bigint_parse(bigint_t *x, const char *str, int len);
+
+/**
+ * Copy a bigint
+ *
+ * Parameters:
+ * 	dst	destination
+ * 	src	source
+ */
+void bigint_copy(bigint_t *dst, const bigint_t *src);
+
+/**
+ * Compute res = a + b (res may be a or b, which adds in place)
+ *
+ * Parameters:
+ * 	res	destination
+ * 	a	left operand
+ * 	b	right operand
+ */
+void bigint_add(bigint_t *res, const bigint_t *a, const bigint_t *b);
+
+/**
+ * Compute res = a - b (res may be a or b, which subtracts in place)
+ *
+ * Parameters:
+ * 	res	destination
+ * 	a	left operand
+ * 	b	right operand
+ */
+void bigint_sub(bigint_t *res, const bigint_t *a, const bigint_t *b);
+
+/**
+ * Add a machine integer to a bigint in place
+ *
+ * Parameters:
+ * 	x	bigint to update
+ * 	value	value to add
+ */
+void bigint_add_int(bigint_t *x, long long value);
+
+/**
+ * Compute res = a * b (res may be a or b)
+ *
+ * Parameters:
+ * 	res	destination
+ * 	a	left operand
+ * 	b	right operand
+ */
+void bigint_mul(bigint_t *res, const bigint_t *a, const bigint_t *b);
+
+/**
+ * Compute the quotient and the remainder of a / b rounded toward zero, so the
+ * remainder has the sign of a (either result may be a, b or NULL)
+ *
+ * Parameters:
+ * 	quot	destination of the quotient
+ * 	rem	destination of the remainder
+ * 	a	dividend
+ * 	b	divisor
+ *
+ * Returns:
+ * 	0 if b is zero (nothing is computed), 1 otherwise
+ */
+int bigint_divmod(bigint_t *quot, bigint_t *rem, const bigint_t *a, const bigint_t *b);
+
+/**
+ * Compare two bigints
+ *
+ * Parameters:
+ * 	a	left operand
+ * 	b	right operand
+ *
+ * Returns:
+ * 	-1, 0 or 1 when a is lesser than, equal to or greater than b
+ */
+int bigint_compare(const bigint_t *a, const bigint_t *b);
+
+/**
+ * Convert a bigint to decimal
+ *
+ * Parameters:
+ * 	x	bigint to convert
+ *
+ * Returns:
+ * 	NUL terminated string (to be freed by the caller with mem_free(MEM_VM, ...))
+ */
+char *bigint_str(const bigint_t *x);
+
+#endif // BIGINT_H
@@ -0,0 +1,57 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+/**
+ * Initialize the string pool
+ */
+void intern_init();
+
+/**
+ * Free the string pool (all interned strings become invalid)
+ */
+void intern_free();
+
+/**
+ * Intern a string, adding it to the pool if it is not there yet
+ *
+ * Parameters:
+ * 	str	characters of the string (need not be NUL terminated)
+ * 	len	number of characters in str
+ *
+ * Returns:
+ * 	symbol id of the string (equal strings get equal ids)
+ */
+int intern(const char *str, int len);
+
+/**
+ * Find the symbol id of a string without adding it to the pool
+ *
+ * Parameters:
+ * 	str	characters of the string (need not be NUL terminated)
+ * 	len	number of characters in str
+ *
+ * Returns:
+ * 	symbol id of the string (-1 if it was never interned)
+ */
+int intern_find(const char *str, int len);
+
+/**
+ * Get the string of a symbol
+ *
+ * Parameters:
+ * 	sym_id	symbol id returned by intern
+ *
+ * Returns:
+ * 	NUL terminated string owned by the pool
+ */
+const char *intern_str(int sym_id);
+
+/**
+ * Get the number of interned strings
+ *
+ * Returns:
+ * 	number of symbols (symbol ids are 0 to count - 1)
+ */
+int intern_count();
+
+#endif // INTERN_H
@@ -3,6 +3,8 @@
 
 #include "ast.h"
 
+#include <stdio.h>
+
 enum {
 	OP_ADD = 0,		// Arguments are variable id; Result is a variable id
 	OP_SUB,			// Arguments are variable id; Result is a variable id
@@ -25,17 +27,86 @@ enum {
 	OP_LOGICAL_NOT,		// 1st argument is variable id; Result is a variable id
 	OP_BITWISE_NOT,		// 1st argument is variable id; Result is a variable id
 
+	// The same operations on i64 variable ids; an i64 takes two consecutive
+	// variable ids, low half first. Comparisons still give an int.
+	OP_ADD_I64,
+	OP_SUB_I64,
+	OP_MUL_I64,
+	OP_DIV_I64,
+	OP_MOD_I64,
+	OP_LSHIFT_I64,
+	OP_RSHIFT_I64,
+	OP_EQUAL_EQUAL_I64,
+	OP_NOT_EQUAL_I64,
+	OP_LESSER_I64,
+	OP_LESSER_EQUAL_I64,
+	OP_GREATER_I64,
+	OP_GREATER_EQUAL_I64,
+	OP_BITWISE_AND_I64,
+	OP_BITWISE_OR_I64,
+	OP_BITWISE_XOR_I64,
+	OP_BITWISE_NOT_I64,
+
+	// The arithmetic operations and comparisons on bigint variable ids; a
+	// bigint takes one variable id, which refers to its limbs in the vm.
+	OP_ADD_BIG,
+	OP_SUB_BIG,
+	OP_MUL_BIG,
+	OP_DIV_BIG,
+	OP_MOD_BIG,
+	OP_EQUAL_EQUAL_BIG,
+	OP_NOT_EQUAL_BIG,
+	OP_LESSER_BIG,
+	OP_LESSER_EQUAL_BIG,
+	OP_GREATER_BIG,
+	OP_GREATER_EQUAL_BIG,
 
 	OP_LABEL,	// No arguments; Result is a label id
 	OP_JMP,		// No arguments; Result is a label id
 	OP_JMP_TRUE,	// 1st argument is variable id; Result is a label id
 	OP_JMP_FALSE,	// 1st argument is variable id; Result is a label id
+	OP_JMP_TABLE,	// 1st argument is the lowest value; 2nd argument is the number of values; Result is a variable id
+			// followed by one OP_JMP per value and a last OP_JMP taken when the value is out of range
+	OP_PROC,	// 1st argument is a label id; Result is a label id (the body follows; reaching it jumps to the 1st argument)
+	OP_CALL,	// No arguments; Result is a label id of an OP_PROC
+	OP_RET,		// No arguments; continues after the last OP_CALL
 
+	// OP_CONST, OP_CONST_I64 and OP_CONST_BIG all come first in the list
 	OP_COPY,	// 1st argument is variable id; Result is a variable id
+	OP_CONST,	// 1st argument is the value; Result is a variable id (set before the program runs)
+	OP_INC,		// No arguments; Result is a variable id (incremented in place)
+	OP_DEC,		// No arguments; Result is a variable id (decremented in place)
+	OP_ADD_IMM,	// 1st argument is the value; Result is a variable id (value added in place)
+	OP_COPY_I64,	// 1st argument is i64 variable id; Result is an i64 variable id
+	OP_CONST_I64,	// 1st argument is the low half of the value; 2nd argument is the high half; Result is an i64 variable id
+	OP_INC_I64,	// No arguments; Result is an i64 variable id (incremented in place)
+	OP_DEC_I64,	// No arguments; Result is an i64 variable id (decremented in place)
+	OP_ADD_IMM_I64,	// 1st argument is the value; Result is an i64 variable id (value added in place)
+	OP_WIDEN,	// 1st argument is variable id; Result is an i64 variable id
+	OP_COPY_BIG,	// 1st argument is bigint variable id; Result is a bigint variable id
+	OP_CONST_BIG,	// 1st argument is a 32 bit chunk of the value; 2nd argument is the index of the chunk; Result is a bigint variable id
+			// (one per chunk that is not zero, at least one per constant)
+	OP_INC_BIG,	// No arguments; Result is a bigint variable id (incremented in place)
+	OP_DEC_BIG,	// No arguments; Result is a bigint variable id (decremented in place)
+	OP_ADD_IMM_BIG,	// 1st argument is the value; Result is a bigint variable id (value added in place)
+	OP_WIDEN_BIG,	// 1st argument is variable id; Result is a bigint variable id
+	OP_WIDEN_I64_BIG,	// 1st argument is i64 variable id; Result is a bigint variable id
+
+	// An array variable id holds the length of the array (set like an OP_CONST)
+	// and its elements are the variable ids right after it.
+	OP_LOAD,	// 1st argument is an array variable id; 2nd argument is the index variable id; Result is a variable id
+	OP_STORE,	// 1st argument is the index variable id; 2nd argument is the value variable id; Result is an array variable id
+	OP_FILL,	// 1st argument is the value variable id; Result is an array variable id
+	OP_ARRAY_COPY,	// 1st argument is the source array variable id; Result is the destination array variable id
+	OP_SUM,		// 1st argument is an array variable id; Result is a variable id
+	OP_MIN,		// 1st argument is an array variable id; Result is a variable id
+	OP_MAX,		// 1st argument is an array variable id; Result is a variable id
 
 	OP_PRINT,	// No arguments; Result is a variable id
+	OP_PRINT_I64,	// No arguments; Result is an i64 variable id
+	OP_PRINT_BIG,	// No arguments; Result is a bigint variable id
 
-	OP_END,		// End of the instructions
+	OP_END,		// End of the instructions; Result is the number of variable ids; 1st argument is the number of label ids
 };
 
 typedef struct {
@@ -45,23 +116,177 @@ typedef struct {
 	int arg2_id;	// 2nd argument; (variable id)
 } ir_t;
 
+// Variable ids and label ids are numbered by the ir generator itself,
+// starting from 0. Names are only kept for print_ir.
+enum {
+	IR_NAME_VAR = 0,	// id is the symbol table id of the variable
+	IR_NAME_TEMP,		// id is the number of the temporary
+	IR_NAME_CONST,		// id is the value of the constant
+	IR_NAME_CONST_I64,	// id is the low half of the value; the high half is the name of the next id
+	IR_NAME_CONST_BIG,	// id is the number of the bigint constant
+	IR_NAME_LABEL,		// id is the symbol table id of the label
+	IR_NAME_GEN_LABEL,	// id is the number of the generated label
+	IR_NAME_PROC,		// id is the symbol table id of the procedure
+	IR_NAME_INLINE_LABEL,	// id is the label id of the copy made by the inliner
+	IR_NAME_ELEMENT,	// id is the index of the array element
+};
+
+typedef struct {
+	int kind;
+	int id;
+} ir_name_t;
+
+// Source span of a run of instructions; an entry covers the instructions from
+// its index up to the index of the next entry
+typedef struct {
+	int index;	// first instruction of the run
+	pos_t start;	// start of the ast node the run comes from (included)
+	pos_t end;	// end of the ast node (excluded)
+} ir_pos_t;
+
+// Growable array of ir; the buffer is kept across ir_builder_reset so it can
+// be reused by the next compilation
+typedef struct {
+	ir_t *list;	// Instructions
+	int len;	// Number of instructions
+	int cap;	// Number of instructions that fit in list
+
+	ir_pos_t *positions;	// Source spans, run-length encoded by instruction index
+	int positions_len, positions_cap;
+
+	int debug;		// record the names of variable and label ids for print_ir
+	ir_name_t *var_names;	// Name of every variable id (only with debug)
+	ir_name_t *label_names;	// Name of every label id (only with debug)
+	int var_names_cap, label_names_cap;
+} ir_builder_t;
+
+/**
+ * Initialize an empty ir builder
+ *
+ * Parameters:
+ * 	builder	The builder
+ */
+void ir_builder_init(ir_builder_t *builder);
+
+/**
+ * Make sure the builder has room for more instructions
+ *
+ * Parameters:
+ * 	builder	The builder
+ * 	count	Number of instructions that will be added
+ */
+void ir_builder_reserve(ir_builder_t *builder, int count);
+
+/**
+ * Drop all instructions while keeping the allocated memory
+ *
+ * Parameters:
+ * 	builder	The builder
+ */
+void ir_builder_reset(ir_builder_t *builder);
+
+/**
+ * Free the memory of the builder
+ *
+ * Parameters:
+ * 	builder	The builder
+ */
+void ir_builder_free(ir_builder_t *builder);
+
+/**
+ * Find the source span an instruction was generated from
+ *
+ * Parameters:
+ * 	builder	The builder
+ * 	index	Index of the instruction in the list
+ *
+ * Returns:
+ * 	Entry covering the instruction (zero positions if there is none)
+ */
+ir_pos_t ir_builder_pos(ir_builder_t *builder, int index);
+
 /**
  * Generate the Intermediate Representation
  *
  * Parameters:
+ * 	builder	The builder the instructions are written to (it is reset first)
  * 	ast	The ast
  * 
  * Returns:
- * 	Array of intermediate representation
+ * 	Array of intermediate representation (owned by the builder)
+ */
+ir_t *generate_ir(ir_builder_t *builder, ast_t *ast);
+
+/**
+ * Start generating the Intermediate Representation one statement at a time
+ *
+ * Parameters:
+ * 	builder	The builder the instructions are written to (it is reset first)
+ */
+void ir_begin(ir_builder_t *builder);
+
+/**
+ * Generate the Intermediate Representation of the next statement
+ *
+ * Parameters:
+ * 	stmt	The analyzed ast of the statement
+ */
+void ir_stmt(ast_t *stmt);
+
+/**
+ * Finish the Intermediate Representation started by ir_begin
+ *
+ * Returns:
+ * 	Array of intermediate representation (owned by the builder)
+ */
+ir_t *ir_end();
+
+/**
+ * Inline calls to small procedures
+ *
+ * A procedure that calls no other procedure is copied into every call site
+ * when its body is small or when it is called only once. Repeated so that
+ * procedures become inlinable once their own calls are gone.
+ *
+ * Parameters:
+ * 	builder	The builder holding the ir (the list is replaced)
+ *
+ * Returns:
+ * 	Array of intermediate representation (owned by the builder)
  */
-ir_t *generate_ir(ast_t *ast);
+ir_t *ir_inline(ir_builder_t *builder);
 
 /**
  * Print the list of intermediate representation
+ *
+ * Names are printed when the builder was generated with debug set.
  * 
  * Parameters:
- * 	ir_list	List of ir
+ * 	builder	The builder holding the ir
+ */
+void print_ir(ir_builder_t *builder);
+
+/**
+ * Get the source name of a label id
+ *
+ * Parameters:
+ * 	builder	The builder (generated with debug)
+ * 	label_id	The label id
+ * 	kind	IR_NAME_LABEL for a user label, IR_NAME_PROC for a procedure
+ *
+ * Returns:
+ * 	Name of the label or procedure (NULL if the label id is of another kind)
+ */
+const char *ir_label_name(ir_builder_t *builder, int label_id, int kind);
+
+/**
+ * Print one instruction the same way print_ir does
+ *
+ * Parameters:
+ * 	builder	The builder holding the ir
+ * 	index	Index of the instruction in the list
+ * 	fd	File to print to
  */
-void print_ir(ir_t *ir_list);
+void print_ir_instruction(ir_builder_t *builder, int index, FILE *fd);
 
 #endif // IR_H
@@ -9,10 +9,53 @@
  * Parameters:
  * 	filepath	filepath the source code belongs to
  * 	src		source code that needs tokenization
+ * 	src_len		length of the source code (src need not be NUL terminated)
  *
  * Returns:
  * 	list of tokens (Users responsibility for freeing memory)
  */
-token_t *tokenize(const char *filepath, const char *src);
+token_t *tokenize(const char *filepath, const char *src, int src_len);
+
+/**
+ * Start tokenizing the source code one token at a time
+ *
+ * Parameters:
+ * 	filepath	filepath the source code belongs to
+ * 	src		source code that needs tokenization
+ * 	src_len		length of the source code (src need not be NUL terminated)
+ */
+void lexer_stream_init(const char *filepath, const char *src, int src_len);
+
+/**
+ * Get the next token of the source code started by lexer_stream_init
+ *
+ * Returns:
+ * 	next token (TT_EOF at the end of the source or after an error)
+ */
+token_t lexer_stream_next();
+
+/**
+ * Check if the token stream stopped because of an error
+ *
+ * Returns:
+ * 	error message (NULL if there was no error)
+ */
+const char *lexer_stream_error();
+
+/**
+ * Get the number of tokens handed out since the lexer was initialized
+ *
+ * Returns:
+ * 	number of tokens (the TT_EOF token included)
+ */
+int lexer_token_count();
+
+/**
+ * Free the tokens returned by tokenize
+ *
+ * Parameters:
+ * 	tokens	tokens to free
+ */
+void lexer_free_tokens(token_t *tokens);
 
 #endif // LEXER_H
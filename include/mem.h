@@ -0,0 +1,95 @@
+#ifndef MEM_H
+#define MEM_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Subsystems whose allocations are accounted for
+enum {
+	MEM_LEXER = 0,
+	MEM_INTERN,	// the pool of identifier names
+	MEM_PARSER,	// the explicit stacks of the parser
+	MEM_AST,
+	MEM_ANALYZER,	// the explicit stack, labels and procedures of the analyzer
+	MEM_ST,
+	MEM_IR,
+	MEM_VM,		// includes the limbs of bigints
+	MEM_SUBSYSTEMS,
+};
+
+#ifdef SMOL_MEMSTATS
+
+/**
+ * Allocate memory on behalf of a subsystem
+ *
+ * Parameters:
+ * 	subsystem	one of MEM_LEXER ... MEM_VM
+ * 	size		bytes to allocate
+ *
+ * Returns:
+ * 	the memory (NULL if the allocation failed)
+ */
+void *mem_malloc(int subsystem, size_t size);
+
+/**
+ * Allocate zeroed memory on behalf of a subsystem
+ *
+ * Parameters:
+ * 	subsystem	one of MEM_LEXER ... MEM_VM
+ * 	count		number of elements
+ * 	size		bytes of one element
+ *
+ * Returns:
+ * 	the memory (NULL if the allocation failed)
+ */
+void *mem_calloc(int subsystem, size_t count, size_t size);
+
+/**
+ * Resize memory of a subsystem
+ *
+ * Parameters:
+ * 	subsystem	one of MEM_LEXER ... MEM_VM
+ * 	ptr		memory from mem_malloc, mem_calloc or mem_realloc of the same subsystem (or NULL)
+ * 	size		new size in bytes
+ *
+ * Returns:
+ * 	the resized memory (NULL if the allocation failed, ptr is then untouched)
+ */
+void *mem_realloc(int subsystem, void *ptr, size_t size);
+
+/**
+ * Free memory of a subsystem
+ *
+ * Parameters:
+ * 	subsystem	one of MEM_LEXER ... MEM_VM
+ * 	ptr		memory from mem_malloc, mem_calloc or mem_realloc of the same subsystem (or NULL)
+ */
+void mem_free(int subsystem, void *ptr);
+
+#else
+
+// without SMOL_MEMSTATS the subsystems call the allocator directly
+#define mem_malloc(subsystem, size) malloc(size)
+#define mem_calloc(subsystem, count, size) calloc(count, size)
+#define mem_realloc(subsystem, ptr, size) realloc(ptr, size)
+#define mem_free(subsystem, ptr) free(ptr)
+
+#endif // SMOL_MEMSTATS
+
+/**
+ * Check whether allocations are tracked, which needs a build with SMOL_MEMSTATS
+ *
+ * Returns:
+ * 	1 if they are tracked, 0 otherwise
+ */
+int mem_tracking();
+
+/**
+ * Print the allocations, bytes allocated, peak and live bytes of every subsystem
+ *
+ * Parameters:
+ * 	fd	file to print to
+ */
+void mem_print(FILE *fd);
+
+#endif // MEM_H
@@ -15,4 +15,50 @@
  */
 ast_t *parse(token_t *tokens);
 
+/**
+ * Create the ast while pulling tokens from the lexer on demand
+ *
+ * Only a small ring buffer of tokens is kept alive, so memory does not grow
+ * with the size of the source code.
+ *
+ * Parameters:
+ * 	filepath	filepath the source code belongs to
+ * 	src		source code that needs to be parsed
+ * 	src_len		length of the source code
+ *
+ * Returns:
+ * 	ast memory
+ */
+ast_t *parse_stream(const char *filepath, const char *src, int src_len);
+
+/**
+ * Start parsing the source code one statement at a time
+ *
+ * Statements are handed out by parse_stream_stmt, so the caller can release
+ * each statement before the next one is parsed.
+ *
+ * Parameters:
+ * 	filepath	filepath the source code belongs to
+ * 	src		source code that needs to be parsed
+ * 	src_len		length of the source code
+ */
+void parse_stream_begin(const char *filepath, const char *src, int src_len);
+
+/**
+ * Parse the next statement of the source code given to parse_stream_begin
+ *
+ * Parameters:
+ * 	stmt	set to the ast of the statement, or NULL after the last statement
+ *
+ * Returns:
+ * 	0 (if no error)
+ * 	1 (if error)
+ */
+int parse_stream_stmt(ast_t **stmt);
+
+/**
+ * Release the memory held by the parser after parse_stream_begin
+ */
+void parse_stream_end();
+
 #endif // PARSER_H
@@ -0,0 +1,23 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "ir.h"
+
+#include <stdio.h>
+
+/**
+ * Print the report of a profiled run: the hottest source lines, the hottest
+ * instructions, the user labels and procedures, and the conditional jumps
+ *
+ * Parameters:
+ * 	fd	file to print to
+ * 	builder	builder holding the profiled ir (generated with debug for the names)
+ * 	hits	executions of every instruction (see vm_profile)
+ * 	taken	jumps taken by every OP_JMP_TRUE and OP_JMP_FALSE
+ * 	src	source code of the program
+ * 	src_len	length of the source code
+ */
+void profile_print(FILE *fd, ir_builder_t *builder, const long long *hits, const long long *taken,
+	const char *src, int src_len);
+
+#endif // PROFILE_H
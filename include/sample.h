@@ -0,0 +1,42 @@
+#ifndef SAMPLE_H
+#define SAMPLE_H
+
+#include "ir.h"
+
+#include <stdio.h>
+
+#define SAMPLE_PERIOD 1009	// default number of instructions between two samples
+
+/**
+ * Start collecting samples of a run
+ *
+ * Parameters:
+ * 	builder	builder holding the ir that is run (generated with debug for the names)
+ */
+void sample_init(ir_builder_t *builder);
+
+/**
+ * Free the collected samples
+ */
+void sample_free();
+
+/**
+ * Record the stack of the instruction that is about to run
+ *
+ * Parameters:
+ * 	ip		current instruction
+ * 	calls		return address of every active call, outermost first
+ * 	calls_len	number of active calls
+ */
+void sample_record(ir_t *ip, ir_t **calls, int calls_len);
+
+/**
+ * Print the samples as folded stacks, one 'frame;frame;frame count' line per
+ * distinct stack, which flame graph tools read as is
+ *
+ * Parameters:
+ * 	fd	file to print to
+ */
+void sample_print(FILE *fd);
+
+#endif // SAMPLE_H
@@ -0,0 +1,90 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+#include "ir.h"
+
+#include <stdio.h>
+
+#define SCHED_SLICE 10000	// default instruction budget of one turn of a program
+
+// State of a scheduled program after sched_run
+enum {
+	SCHED_DONE = 0,		// the program reached its end
+	SCHED_FAILED,		// the program stopped with a runtime error
+};
+
+/**
+ * Prepare the scheduler
+ *
+ * Parameters:
+ * 	workers		number of worker threads
+ * 	slice		instructions a program runs before it goes back in the queue
+ * 	max_steps	instructions after which a program fails (VM_UNLIMITED for no limit)
+ */
+void sched_init(int workers, long long slice, long long max_steps);
+
+/**
+ * Free the programs, their output and the scheduler
+ */
+void sched_free();
+
+/**
+ * Add a program to run; its print output is buffered until sched_run returns
+ *
+ * Parameters:
+ * 	builder		builder holding the ir of the program (must outlive the scheduler)
+ * 	filepath	path of the source file, for runtime errors
+ * 	src		source code, for runtime errors
+ *
+ * Returns:
+ * 	id of the program (0, 1, 2, ... in the order they are added)
+ */
+int sched_add(ir_builder_t *builder, const char *filepath, const char *src);
+
+/**
+ * Run every added program to its end, interleaved on the worker threads; an
+ * idle worker steals half of the queue of another one
+ */
+void sched_run();
+
+/**
+ * Get the state of a program after sched_run
+ *
+ * Parameters:
+ * 	id	id of the program
+ *
+ * Returns:
+ * 	SCHED_DONE or SCHED_FAILED
+ */
+int sched_status(int id);
+
+/**
+ * Get the runtime error of a failed program
+ *
+ * Parameters:
+ * 	id	id of the program
+ *
+ * Returns:
+ * 	error message (NULL if the program did not fail)
+ */
+const char *sched_error(int id);
+
+/**
+ * Write the buffered print output of a program
+ *
+ * Parameters:
+ * 	id	id of the program
+ * 	fd	file to write to
+ */
+void sched_write_output(int id, FILE *fd);
+
+/**
+ * Print the throughput and latency of the last sched_run and the work of
+ * every worker
+ *
+ * Parameters:
+ * 	fd	file to print to
+ */
+void sched_print(FILE *fd);
+
+#endif // SCHED_H
@@ -3,8 +3,9 @@
 
 typedef struct {
 	int id;
-	char *name;
+	const char *name;	// owned by the string pool (see intern.h)
 	int type_id;
+	int sym_id;		// interned name
 } name_t;
 
 /**
@@ -61,6 +62,28 @@ name_t st_create_label(const char *name);
  */
 name_t st_check_label(const char *name);
 
+/**
+ * Create a new label from an interned name
+ *
+ * Parameters:
+ * 	sym_id	Symbol id of the name of the label
+ *
+ * Returns:
+ * 	name_t type
+ */
+name_t st_create_label_sym(int sym_id);
+
+/**
+ * Check if label exists by its interned name
+ *
+ * Parameters:
+ * 	sym_id	Symbol id of the name of the label
+ *
+ * Returns:
+ * 	name_t type (id = -1 if doesn't exists)
+ */
+name_t st_check_label_sym(int sym_id);
+
 /**
  * Check if label exists by id of the label
  *
@@ -72,6 +95,39 @@ name_t st_check_label(const char *name);
  */
 name_t st_check_label_by_id(int label_id);
 
+/**
+ * Create a new procedure from an interned name
+ *
+ * Parameters:
+ * 	sym_id	Symbol id of the name of the procedure
+ *
+ * Returns:
+ * 	name_t type
+ */
+name_t st_create_proc_sym(int sym_id);
+
+/**
+ * Check if procedure exists by its interned name
+ *
+ * Parameters:
+ * 	sym_id	Symbol id of the name of the procedure
+ *
+ * Returns:
+ * 	name_t type (id = -1 if doesn't exists)
+ */
+name_t st_check_proc_sym(int sym_id);
+
+/**
+ * Check if procedure exists by id of the procedure
+ *
+ * Parameters:
+ * 	proc_id	Id of the procedure
+ *
+ * Returns:
+ * 	name_t type (id = -1 if doesn't exists)
+ */
+name_t st_check_proc_by_id(int proc_id);
+
 /**
  * Create a new variable name
  *
@@ -95,6 +151,29 @@ name_t st_create_var(const char *name, int type_id);
  */
 name_t st_check_var(const char *name);
 
+/**
+ * Create a new variable from an interned name
+ *
+ * Parameters:
+ * 	sym_id	Symbol id of the name of the variable
+ * 	type_id	Type of the variable
+ *
+ * Returns:
+ * 	name_t type
+ */
+name_t st_create_var_sym(int sym_id, int type_id);
+
+/**
+ * Check if variable exists by its interned name
+ *
+ * Parameters:
+ * 	sym_id	Symbol id of the name of the variable
+ *
+ * Returns:
+ * 	name_t type (id = -1 if doesn't exists)
+ */
+name_t st_check_var_sym(int sym_id);
+
 /**
  * Check if var exists by id of the var
  *
@@ -106,5 +185,13 @@ name_t st_check_var(const char *name);
  */
 name_t st_check_var_by_id(int var_id);
 
+/**
+ * Get the number of names in the symbol table
+ *
+ * Returns:
+ * 	number of types, labels, procedures and variables
+ */
+int st_count();
+
 #endif // ST_H
 
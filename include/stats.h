@@ -0,0 +1,84 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+
+// Phases of a run, in the order they happen
+enum {
+	STATS_READ_FILE = 0,
+	STATS_TOKENIZE,
+	STATS_PARSE,
+	STATS_ANALYZE,
+	STATS_GENERATE_IR,
+	STATS_VM_RUN,
+	STATS_PHASES,
+};
+
+// Counters of a run
+enum {
+	STATS_BYTES = 0,
+	STATS_TOKENS,
+	STATS_AST_NODES,
+	STATS_SYMBOLS,
+	STATS_IR_INSTRUCTIONS,
+	STATS_EXECUTED,
+	STATS_COUNTERS,
+};
+
+/**
+ * Enable the collection of stats; until then stats_now and stats_add_time
+ * cost nothing
+ */
+void stats_enable();
+
+/**
+ * Get the current time for timing a phase
+ *
+ * Returns:
+ * 	seconds on a monotonic clock (0 if stats are disabled)
+ */
+double stats_now();
+
+/**
+ * Add the time since start to a phase
+ *
+ * Parameters:
+ * 	phase	one of STATS_READ_FILE ... STATS_VM_RUN
+ * 	start	value of stats_now when the phase started
+ */
+void stats_add_time(int phase, double start);
+
+/**
+ * Mark a phase as folded into another one (it is reported without a time)
+ *
+ * Parameters:
+ * 	phase	one of STATS_READ_FILE ... STATS_VM_RUN
+ */
+void stats_skip(int phase);
+
+/**
+ * Set a counter
+ *
+ * Parameters:
+ * 	counter	one of STATS_BYTES ... STATS_EXECUTED
+ * 	value	new value of the counter
+ */
+void stats_set(int counter, long long value);
+
+/**
+ * Print the times and counters as a table
+ *
+ * Parameters:
+ * 	fd	file to print to
+ */
+void stats_print(FILE *fd);
+
+/**
+ * Print the times (in milliseconds) and counters as one JSON object
+ *
+ * Parameters:
+ * 	fd	file to print to
+ */
+void stats_print_json(FILE *fd);
+
+#endif // STATS_H
@@ -8,8 +8,11 @@ enum {
 	
 	TT_COLON, 
 	TT_SEMICOLON, 
+	TT_COMMA,
 	TT_QUESTION,
 	TT_LPAREN, TT_RPAREN,
+	TT_LBRACE, TT_RBRACE,
+	TT_LBRACKET, TT_RBRACKET,
 	TT_EQUAL, TT_EQUAL_EQUAL,
 	TT_PIPE, TT_LOGICAL_OR,
 	TT_AMPERSAND, TT_LOGICAL_AND,
@@ -23,6 +26,10 @@ enum {
 	TT_FSLASH,
 	TT_MOD,
 	TT_TILDE,
+	TT_PLUS_EQUAL, TT_MINUS_EQUAL,
+	TT_STAR_EQUAL, TT_FSLASH_EQUAL, TT_MOD_EQUAL,
+	TT_LSHIFT_EQUAL, TT_RSHIFT_EQUAL,
+	TT_AMPERSAND_EQUAL, TT_PIPE_EQUAL, TT_CARET_EQUAL,
 
 	TT_IDENTIFIER,
 
@@ -31,6 +38,14 @@ enum {
 	TT_ELSE_KEYWORD,
 	TT_GOTO_KEYWORD,
 	TT_PRINT_KEYWORD,
+	TT_WHILE_KEYWORD,
+	TT_FOR_KEYWORD,
+	TT_SWITCH_KEYWORD,
+	TT_CASE_KEYWORD,
+	TT_DEFAULT_KEYWORD,
+	TT_PROC_KEYWORD,
+	TT_CALL_KEYWORD,
+	TT_RETURN_KEYWORD,
 
 	TT_INT_LITERAL,
 
@@ -43,6 +58,7 @@ typedef struct {
 	pos_t end;
 	const char *filepath;
 	const char *src;
+	int sym_id;	// interned lexical of identifiers (-1 for other tokens)
 } token_t;
 
 /**
@@ -2,6 +2,90 @@
 #define VM_H
 
 #include "ir.h"
+#include "bigint.h"
+
+#include <limits.h>
+#include <setjmp.h>
+#include <stdio.h>
+
+#define VM_UNLIMITED LLONG_MAX	// budget of a vm_exec that runs until the program ends
+#define VM_ERROR_SIZE 256
+
+// Result of vm_exec
+enum {
+	VM_DONE = 0,	// the program reached its end
+	VM_PAUSED,	// the budget ran out, vm_exec resumes the program
+};
+
+// State of one running program
+typedef struct {
+	ir_t *ir_list;
+	ir_t *ip;		// next instruction to run
+	long long executed;	// instructions executed so far
+
+	int *vars;
+	int vars_len;
+	ir_t **labels;
+	int labels_len;
+	ir_t **calls;		// return address of every active call
+	int calls_len, calls_cap;
+
+	// a bigint variable id holds 1 + the index of its bigint (0 until first used)
+	bigint_t **bigs;
+	int bigs_len, bigs_cap;
+
+	FILE *out;		// where print writes (stdout after vm_init)
+
+	// where runtime errors are reported (see vm_set_source)
+	ir_builder_t *source;
+	const char *filepath, *src;
+
+	// when set, a runtime error stores its message in error and jumps here
+	// instead of exiting
+	jmp_buf *on_error;
+	char error[VM_ERROR_SIZE];
+} vm_t;
+
+/**
+ * Prepare a vm to run an instruction list from its start
+ *
+ * Parameters:
+ * 	vm	vm to prepare
+ * 	ir_list	list of ir (must outlive the vm)
+ */
+void vm_init(vm_t *vm, ir_t *ir_list);
+
+/**
+ * Run a vm until its program ends or its budget runs out; the budget is only
+ * checked on backward jumps and calls, so a paused vm may have executed up to
+ * one straight run of instructions more than the budget
+ *
+ * Parameters:
+ * 	vm	vm to run (prepared with vm_init)
+ * 	budget	number of instructions to run (VM_UNLIMITED for no limit)
+ *
+ * Returns:
+ * 	VM_DONE or VM_PAUSED
+ */
+int vm_exec(vm_t *vm, long long budget);
+
+/**
+ * Free the state of a vm
+ *
+ * Parameters:
+ * 	vm	vm to free
+ */
+void vm_free(vm_t *vm);
+
+/**
+ * Report that a vm ran out of steps at the instruction it paused at, as a
+ * runtime error
+ *
+ * Parameters:
+ * 	vm		paused vm
+ * 	max_steps	the limit that was reached
+ */
+void vm_step_limit(vm_t *vm, long long max_steps);
 
 /**
  * Run the instruction list in the vm
@@ -11,4 +95,42 @@
  */
 void vm_run(ir_t *ir_list);
 
+/**
+ * Get the number of instructions executed by the last vm_run
+ *
+ * Returns:
+ * 	number of executed instructions
+ */
+long long vm_executed();
+
+/**
+ * Count how often every instruction runs in the following vm_run and vm_exec calls
+ *
+ * Parameters:
+ * 	hits	one zeroed counter per instruction (NULL stops the counting)
+ * 	taken	one zeroed counter per instruction, raised when an OP_JMP_TRUE
+ * 		or OP_JMP_FALSE jumps
+ */
+void vm_profile(long long *hits, long long *taken);
+
+/**
+ * Record a sample of the stack every period instructions in the following
+ * vm_run and vm_exec calls (see sample_record)
+ *
+ * Parameters:
+ * 	period	instructions between two samples (0 stops the sampling)
+ */
+void vm_sample(int period);
+
+/**
+ * Let runtime errors of a vm point at the source of the failing instruction
+ *
+ * Parameters:
+ * 	vm		vm that runs the ir
+ * 	builder		builder holding the ir that is run (NULL to forget it)
+ * 	filepath	path of the source file
+ * 	src		source code
+ */
+void vm_set_source(vm_t *vm, ir_builder_t *builder, const char *filepath, const char *src);
+
 #endif // VM_H
\ No newline at end of file
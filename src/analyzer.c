@@ -1,9 +1,15 @@
 #include "analyzer.h"
+#include "mem.h"
 #include "error.h"
+#include "intern.h"
 #include "pos.h"
 #include "st.h"
 
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 // ========================================
 // helper declaration
@@ -15,8 +21,68 @@ static const char *g_error_src;
 static pos_t g_error_start, g_error_end;
 static const char *g_error_message;
 
+// Expressions and nested if statements are walked with explicit stacks, so
+// nesting depth is only limited by memory.
+typedef struct {
+	ast_t *ast;
+	int step;	// number of children analyzed so far
+} analyzer_frame_t;
+
+static analyzer_frame_t *g_frames;
+static int g_frames_len, g_frames_cap;
+
+// Labels and procedures may be used before they are declared. A whole
+// program has them collected up front; when statements arrive one at a time,
+// a goto or call to an unknown name creates it and it has to be declared
+// before analyze_end.
+typedef struct {
+	int declared;
+	token_t first_goto;	// reported if the label is never declared
+	int proc;		// procedure the label belongs to (0 outside procedures)
+} analyzer_label_t;
+
+typedef struct {
+	int declared;
+	token_t first_call;	// reported if the procedure is never declared
+} analyzer_proc_t;
+
+static analyzer_label_t *g_labels;	// indexed by label id
+static int g_labels_cap;
+static analyzer_proc_t *g_procs;	// indexed by procedure id
+static int g_procs_cap;
+static int g_proc;			// procedure being analyzed (0 outside procedures)
+static int g_names_collected;
+static int g_stmt_failed;	// an error was already reported by analyze_stmt
+
+#define ANALYZER_ARRAY_MAX (1 << 24)	// longest array in elements
+
+// Builtins are looked up by name, so they don't take identifiers away from
+// variables. Every character of args is an argument: 'a' for an array and
+// 'v' for a value. The table is in BUILTIN_* order.
+typedef struct {
+	const char *name;
+	int kind;
+	const char *args;
+} analyzer_builtin_t;
+
+static const analyzer_builtin_t g_builtins[] = {
+	{"len", BUILTIN_LEN, "a"},
+	{"fill", BUILTIN_FILL, "av"},
+	{"copy", BUILTIN_COPY, "aa"},
+	{"sum", BUILTIN_SUM, "a"},
+	{"min", BUILTIN_MIN, "a"},
+	{"max", BUILTIN_MAX, "a"},
+};
+
 void analyzer_init();
 void analyzer_free();
+void analyzer_push_frame(ast_t *ast);
+analyzer_label_t *analyzer_label(int label_id);
+void analyzer_declare_label(ast_t *stmt);
+analyzer_proc_t *analyzer_proc(int proc_id);
+void analyzer_declare_proc(ast_t *stmt);
+void analyzer_collect_names(ast_t *prog);
+void analyzer_check_names();
 
 void analyzer_error_set(const char *filepath, const char *src, pos_t start, pos_t end, const char *message);
 void analyzer_error_print();
@@ -27,20 +93,42 @@ void analyzer_rule_prog(ast_t *ast);
 void analyzer_rule_stmt(ast_t *stmt);
 void analyzer_rule_label_stmt(ast_t *stmt);
 void analyzer_rule_var_stmt(ast_t *stmt);
-void analyzer_rule_if_stmt(ast_t *stmt);
+void analyzer_rule_compound_stmt(ast_t *stmt);
+ast_t *analyzer_rule_if_stmt(ast_t *stmt, int step);
+ast_t *analyzer_rule_while_stmt(ast_t *stmt, int step);
+ast_t *analyzer_rule_for_stmt(ast_t *stmt, int step);
+ast_t *analyzer_rule_switch_stmt(ast_t *stmt, int step);
+void analyzer_rule_cases(ast_t *stmt);
+int analyzer_case_compare(const void *a, const void *b);
+ast_t *analyzer_rule_block_stmt(ast_t *stmt, int step);
+void analyzer_rule_cond(ast_t *stmt, ast_t *cond, const char *message);
 void analyzer_rule_goto_stmt(ast_t *stmt);
+void analyzer_rule_proc_stmt(ast_t *stmt);
+void analyzer_rule_call_stmt(ast_t *stmt);
+void analyzer_rule_return_stmt(ast_t *stmt);
 void analyzer_rule_print_stmt(ast_t *stmt);
 void analyzer_rule_expr_stmt(ast_t *stmt);
 void analyzer_rule_expr(ast_t *expr);
+ast_t *analyzer_rule_expr_step(ast_t *expr, int step);
 void analyzer_rule_literal(ast_t *expr);
 void analyzer_rule_identifier(ast_t *expr);
-void analyzer_rule_unary(ast_t *expr);
-void analyzer_rule_binary(ast_t *expr);
-void analyzer_rule_ternary(ast_t *expr);
+void analyzer_rule_array(ast_t *expr);
+ast_t *analyzer_rule_index(ast_t *expr, int step);
+ast_t *analyzer_rule_builtin(ast_t *expr, int step);
+const analyzer_builtin_t *analyzer_builtin(token_t name);
+ast_t *analyzer_builtin_value_arg(ast_t *expr, int n);
+ast_t *analyzer_rule_unary(ast_t *expr, int step);
+ast_t *analyzer_rule_binary(ast_t *expr, int step);
+ast_t *analyzer_rule_ternary(ast_t *expr, int step);
 
 int bigger_type_id(int ltype_id, int rtype_id);
 int is_numerical_type(int type_id);
+int is_bigint_type(int type_id);
+int is_array_type(int type_id);
 int is_lhs(ast_t *expr);
+int is_assign_op(int token_type);
+int is_bitwise_op(int token_type);
+int is_boolean_op(int token_type);
 int is_compatible_type(int ltype_id, int rtype_id);
 
 // ========================================
@@ -48,7 +136,41 @@ int is_compatible_type(int ltype_id, int rtype_id);
 // ========================================
 
 int analyze(ast_t *ast) {
-	analyzer_rule_prog(ast);
+	analyzer_init();
+
+	analyzer_collect_names(ast);
+	if (!analyzer_error_check()) {
+		analyzer_rule_prog(ast);
+	}
+	analyzer_free();
+	if (analyzer_error_check()) {
+		analyzer_error_print();
+		analyzer_error_clear();
+		return 1;
+	}
+
+	return 0;
+}
+
+void analyze_begin() {
+	analyzer_init();
+}
+
+int analyze_stmt(ast_t *stmt) {
+	analyzer_rule_stmt(stmt);
+	if (analyzer_error_check()) {
+		analyzer_error_print();
+		analyzer_error_clear();
+		g_stmt_failed = 1;
+		return 1;
+	}
+
+	return 0;
+}
+
+int analyze_end() {
+	analyzer_check_names();
+	analyzer_free();
 	if (analyzer_error_check()) {
 		analyzer_error_print();
 		analyzer_error_clear();
@@ -64,9 +186,177 @@ int analyze(ast_t *ast) {
 
 void analyzer_init() {
 	g_has_error = 0;
+	g_frames = NULL;
+	g_frames_len = g_frames_cap = 0;
+	g_labels = NULL;
+	g_labels_cap = 0;
+	g_procs = NULL;
+	g_procs_cap = 0;
+	g_proc = 0;
+	g_names_collected = 0;
+	g_stmt_failed = 0;
 }
 
 void analyzer_free() {
+	mem_free(MEM_ANALYZER, g_frames);
+	g_frames = NULL;
+	g_frames_len = g_frames_cap = 0;
+	mem_free(MEM_ANALYZER, g_labels);
+	g_labels = NULL;
+	g_labels_cap = 0;
+	mem_free(MEM_ANALYZER, g_procs);
+	g_procs = NULL;
+	g_procs_cap = 0;
+}
+
+void analyzer_push_frame(ast_t *ast) {
+	if (g_frames_cap <= g_frames_len) {
+		g_frames_cap = (g_frames_cap + 1) * 2;
+		g_frames = mem_realloc(MEM_ANALYZER, g_frames, g_frames_cap * sizeof(analyzer_frame_t));
+		if (g_frames == NULL) {
+			perror("something went wrong with realloc in analyzer_push_frame");
+			exit(1);
+		}
+	}
+	g_frames[g_frames_len++] = (analyzer_frame_t) {.ast = ast, .step = 0};
+}
+
+analyzer_label_t *analyzer_label(int label_id) {
+	if (label_id >= g_labels_cap) {
+		int old_cap = g_labels_cap;
+		g_labels_cap = (label_id + 1) * 2;
+		g_labels = mem_realloc(MEM_ANALYZER, g_labels, g_labels_cap * sizeof(analyzer_label_t));
+		if (g_labels == NULL) {
+			perror("something went wrong with realloc in analyzer_label");
+			exit(1);
+		}
+		for (int i = old_cap; i < g_labels_cap; i++) g_labels[i].declared = 0;
+	}
+	return &g_labels[label_id];
+}
+
+void analyzer_declare_label(ast_t *stmt) {
+	token_t label_token = stmt->label_stmt.label;
+	name_t name = st_check_label_sym(label_token.sym_id);
+	if (name.id == -1) {
+		name = st_create_label_sym(label_token.sym_id);
+	}
+	else if (analyzer_label(name.id)->declared) {
+		analyzer_error_set(label_token.filepath, label_token.src, label_token.start, label_token.end,
+			"label already declared");
+		return;
+	}
+	else if (analyzer_label(name.id)->proc != g_proc) {
+		token_t token = analyzer_label(name.id)->first_goto;
+		analyzer_error_set(token.filepath, token.src, token.start, token.end,
+			"goto can't cross a procedure boundary");
+		return;
+	}
+	analyzer_label(name.id)->declared = 1;
+	analyzer_label(name.id)->proc = g_proc;
+	stmt->label_id = name.id;
+}
+
+analyzer_proc_t *analyzer_proc(int proc_id) {
+	if (proc_id >= g_procs_cap) {
+		int old_cap = g_procs_cap;
+		g_procs_cap = (proc_id + 1) * 2;
+		g_procs = mem_realloc(MEM_ANALYZER, g_procs, g_procs_cap * sizeof(analyzer_proc_t));
+		if (g_procs == NULL) {
+			perror("something went wrong with realloc in analyzer_proc");
+			exit(1);
+		}
+		for (int i = old_cap; i < g_procs_cap; i++) g_procs[i].declared = 0;
+	}
+	return &g_procs[proc_id];
+}
+
+void analyzer_declare_proc(ast_t *stmt) {
+	token_t name_token = stmt->proc_stmt.name;
+	name_t name = st_check_proc_sym(name_token.sym_id);
+	if (name.id == -1) {
+		name = st_create_proc_sym(name_token.sym_id);
+	}
+	else if (analyzer_proc(name.id)->declared) {
+		analyzer_error_set(name_token.filepath, name_token.src, name_token.start, name_token.end,
+			"procedure already declared");
+		return;
+	}
+	analyzer_proc(name.id)->declared = 1;
+	stmt->proc_id = name.id;
+}
+
+void analyzer_collect_names(ast_t *prog) {
+	if (prog->type != AST_PROG) {
+		return;
+	}
+
+	// labels can sit in nested statements, so walk those on the frame stack;
+	// children are pushed last to first to declare labels in source order
+	for (int i = 0; i < prog->prog.len && !analyzer_error_check(); i++) {
+		ast_t *top = prog->prog.stmts[i];
+		g_proc = 0;
+		if (top->type == AST_PROC_STMT) {
+			analyzer_declare_proc(top);
+			g_proc = top->proc_id;
+			top = top->proc_stmt.body;
+		}
+		analyzer_push_frame(top);
+
+		while (g_frames_len > 0 && !analyzer_error_check()) {
+			ast_t *stmt = g_frames[--g_frames_len].ast;
+			switch (stmt->type) {
+			case AST_LABEL_STMT:
+				analyzer_declare_label(stmt);
+				break;
+			case AST_IF_STMT:
+				if (stmt->if_stmt.else_block) analyzer_push_frame(stmt->if_stmt.else_block);
+				analyzer_push_frame(stmt->if_stmt.if_block);
+				break;
+			case AST_WHILE_STMT:
+				analyzer_push_frame(stmt->while_stmt.body);
+				break;
+			case AST_FOR_STMT:
+				analyzer_push_frame(stmt->for_stmt.body);
+				break;
+			case AST_SWITCH_STMT:
+				for (int j = stmt->switch_stmt.len - 1; j >= 0; j--) {
+					analyzer_push_frame(stmt->switch_stmt.cases[j]->case_stmt.body);
+				}
+				break;
+			case AST_BLOCK_STMT:
+				for (int j = stmt->block_stmt.len - 1; j >= 0; j--) {
+					analyzer_push_frame(stmt->block_stmt.stmts[j]);
+				}
+				break;
+			}
+		}
+	}
+	g_frames_len = 0;
+	g_proc = 0;
+	g_names_collected = 1;
+}
+
+void analyzer_check_names() {
+	if (g_stmt_failed) {
+		return;
+	}
+
+	for (int i = 1; st_check_label_by_id(i).id != -1; i++) {
+		if (!analyzer_label(i)->declared) {
+			token_t token = analyzer_label(i)->first_goto;
+			analyzer_error_set(token.filepath, token.src, token.start, token.end, "label not defined");
+			return;
+		}
+	}
+
+	for (int i = 1; st_check_proc_by_id(i).id != -1; i++) {
+		if (!analyzer_proc(i)->declared) {
+			token_t token = analyzer_proc(i)->first_call;
+			analyzer_error_set(token.filepath, token.src, token.start, token.end, "procedure not defined");
+			return;
+		}
+	}
 }
 
 void analyzer_error_set(const char *filepath, const char *src, pos_t start, pos_t end, const char *message) {
@@ -114,11 +404,24 @@ void analyzer_rule_stmt(ast_t *stmt) {
 		analyzer_rule_var_stmt(stmt);
 		break;
 	case AST_IF_STMT:
-		analyzer_rule_if_stmt(stmt);
+	case AST_WHILE_STMT:
+	case AST_FOR_STMT:
+	case AST_SWITCH_STMT:
+	case AST_BLOCK_STMT:
+		analyzer_rule_compound_stmt(stmt);
 		break;
 	case AST_GOTO_STMT:
 		analyzer_rule_goto_stmt(stmt);
 		break;
+	case AST_PROC_STMT:
+		analyzer_rule_proc_stmt(stmt);
+		break;
+	case AST_CALL_STMT:
+		analyzer_rule_call_stmt(stmt);
+		break;
+	case AST_RETURN_STMT:
+		analyzer_rule_return_stmt(stmt);
+		break;
 	case AST_PRINT_STMT:
 		analyzer_rule_print_stmt(stmt);
 		break;
@@ -132,114 +435,368 @@ void analyzer_rule_stmt(ast_t *stmt) {
 }
 
 void analyzer_rule_label_stmt(ast_t *stmt) {
-	char *lexical = NULL;
-
 	if (stmt->type != AST_LABEL_STMT) {
 		analyzer_error_set(stmt->filepath, stmt->src, stmt->start, stmt->end, 
 			"expected AST_LABEL_STMT ast");
-		goto cleanup;
+		return;
 	}
 
-	token_t label_token = stmt->label_stmt.label;
-	lexical = token_lexical(label_token);
-	if (st_check_label(lexical).id != -1) {
-		analyzer_error_set(label_token.filepath, label_token.src, label_token.start, label_token.end,
-			"label already declared");
-		goto cleanup;
+	// a whole program had its labels declared by analyzer_collect_names
+	if (!g_names_collected) {
+		analyzer_declare_label(stmt);
 	}
-	name_t name = st_create_label(lexical);
-	stmt->label_id = name.id;
-
-cleanup:
-	free(lexical);
 }
 
 void analyzer_rule_var_stmt(ast_t *stmt) {
-	char *lexical = NULL;
-
 	if (stmt->type != AST_VAR_STMT) {
 		analyzer_error_set(stmt->filepath, stmt->src, stmt->start, stmt->end,
 			"expected AST_VAR_STMT ast");
-		goto cleanup;
+		return;
 	}
 
 	token_t var_token = stmt->var_stmt.name;
-	lexical = token_lexical(var_token);
-	if (st_check_var(lexical).id != -1) {
+	if (st_check_var_sym(var_token.sym_id).id != -1) {
 		analyzer_error_set(var_token.filepath, var_token.src, var_token.start, var_token.end,
 			"variable already declared");
-		goto cleanup;
+		return;
 	}
 	int type_id = st_check_type("int").id;
 
+	ast_t *type = stmt->var_stmt.type;
+	if (type) {
+		type_id = st_check_type(intern_str(type->identifier.token.sym_id)).id;
+		if (!is_numerical_type(type_id)) {
+			analyzer_error_set(type->filepath, type->src, type->start, type->end,
+				"unknown type");
+			return;
+		}
+	}
+
+	if (stmt->var_stmt.size) {
+		// the literal is followed by a non digit, so strtol stops at its end
+		token_t size = stmt->var_stmt.size->literal.token;
+		long len = strtol(size.src + size.start.index, NULL, 10);
+		if (len < 1 || len > ANALYZER_ARRAY_MAX) {
+			analyzer_error_set(size.filepath, size.src, size.start, size.end,
+				"array length must be between 1 and 16777216");
+			return;
+		}
+		type_id = st_check_type("int[]").id;
+	}
+
 	if (stmt->var_stmt.expr) {
 		analyzer_rule_expr(stmt->var_stmt.expr);
 		if (analyzer_error_check()) {
-			goto cleanup;
+			return;
 		}
 
-		if (type_id != stmt->var_stmt.expr->type_id) {
+		// without a declared type the variable takes the type of the
+		// expression; otherwise the expression may only be widened
+		int expr_type_id = stmt->var_stmt.expr->type_id;
+		if (type == NULL) {
+			type_id = expr_type_id;
+		}
+		else if (bigger_type_id(type_id, expr_type_id) != type_id) {
 			analyzer_error_set(stmt->filepath, stmt->src, stmt->start, stmt->end,
 				"variable and expression are of different type");
-			goto cleanup;
+			return;
 		}
 	}
 
-	name_t name = st_create_var(lexical, type_id);
+	name_t name = st_create_var_sym(var_token.sym_id, type_id);
 	stmt->type_id = name.type_id;
 	stmt->var_id = name.id;
+}
+
+void analyzer_rule_compound_stmt(ast_t *stmt) {
+	// nested if, while, for, switch and block statements are handled on the frame stack
+	int base = g_frames_len;
+	analyzer_push_frame(stmt);
+
+	while (g_frames_len > base) {
+		analyzer_frame_t *frame = &g_frames[g_frames_len - 1];
+		ast_t *ast = frame->ast;
+		int step = frame->step++;
+		ast_t *child = NULL;
+
+		switch (ast->type) {
+		case AST_IF_STMT:
+			child = analyzer_rule_if_stmt(ast, step);
+			break;
+		case AST_WHILE_STMT:
+			child = analyzer_rule_while_stmt(ast, step);
+			break;
+		case AST_FOR_STMT:
+			child = analyzer_rule_for_stmt(ast, step);
+			break;
+		case AST_SWITCH_STMT:
+			child = analyzer_rule_switch_stmt(ast, step);
+			break;
+		case AST_BLOCK_STMT:
+			child = analyzer_rule_block_stmt(ast, step);
+			break;
+		default:
+			analyzer_error_set(ast->filepath, ast->src, ast->start, ast->end,
+				"expected a compound statement ast");
+			break;
+		}
 
-cleanup:
-	free(lexical);
+		if (analyzer_error_check()) {
+			g_frames_len = base;
+			return;
+		}
+
+		if (child == NULL) {
+			g_frames_len--;
+		}
+		else if (ast_is_compound_stmt(child)) {
+			analyzer_push_frame(child);
+		}
+		else {
+			analyzer_rule_stmt(child);
+			if (analyzer_error_check()) {
+				g_frames_len = base;
+				return;
+			}
+		}
+	}
 }
 
-void analyzer_rule_if_stmt(ast_t *stmt) {
-	if (stmt->type != AST_IF_STMT) {
-		analyzer_error_set(stmt->filepath, stmt->src, stmt->start, stmt->end,
-			"expected AST_IF_STMT ast");
-		return;
+ast_t *analyzer_rule_if_stmt(ast_t *stmt, int step) {
+	switch (step) {
+	case 0:
+		analyzer_rule_cond(stmt, stmt->if_stmt.if_cond, "expected numerical type in if condition");
+		return stmt->if_stmt.if_block;
+	case 1:
+		return stmt->if_stmt.else_block;
+	default:
+		return NULL;
 	}
+}
 
-	analyzer_rule_expr(stmt->if_stmt.if_cond);
-	if (analyzer_error_check()) {
-		return;
+ast_t *analyzer_rule_while_stmt(ast_t *stmt, int step) {
+	if (step > 0) {
+		return NULL;
 	}
 
-	if (!is_numerical_type(stmt->if_stmt.if_cond->type_id)) {
-		analyzer_error_set(stmt->filepath, stmt->src, stmt->start, stmt->end,
-			"expected numerical type in if condition");
+	analyzer_rule_cond(stmt, stmt->while_stmt.cond, "expected numerical type in while condition");
+	return stmt->while_stmt.body;
+}
+
+ast_t *analyzer_rule_for_stmt(ast_t *stmt, int step) {
+	switch (step) {
+	case 0:
+		if (stmt->for_stmt.init) {
+			analyzer_rule_expr(stmt->for_stmt.init);
+			if (analyzer_error_check()) {
+				return NULL;
+			}
+		}
+		if (stmt->for_stmt.cond) {
+			analyzer_rule_cond(stmt, stmt->for_stmt.cond, "expected numerical type in for condition");
+		}
+		return stmt->for_stmt.body;
+	case 1:
+		// the step runs after the body, so it is analyzed after it as well
+		if (stmt->for_stmt.step) {
+			analyzer_rule_expr(stmt->for_stmt.step);
+		}
+		return NULL;
+	default:
+		return NULL;
+	}
+}
+
+ast_t *analyzer_rule_switch_stmt(ast_t *stmt, int step) {
+	if (step == 0) {
+		analyzer_rule_cond(stmt, stmt->switch_stmt.expr, "expected numerical type in switch expression");
+		if (analyzer_error_check()) {
+			return NULL;
+		}
+		if (stmt->switch_stmt.expr->type_id != st_check_type("int").id) {
+			ast_t *expr = stmt->switch_stmt.expr;
+			analyzer_error_set(expr->filepath, expr->src, expr->start, expr->end,
+				"expected int type in switch expression");
+			return NULL;
+		}
+		analyzer_rule_cases(stmt);
+	}
+
+	if (step >= stmt->switch_stmt.len) {
+		return NULL;
+	}
+	return stmt->switch_stmt.cases[step]->case_stmt.body;
+}
+
+void analyzer_rule_cases(ast_t *stmt) {
+	int len = stmt->switch_stmt.len;
+	if (len == 0) {
 		return;
 	}
 
-	analyzer_rule_stmt(stmt->if_stmt.if_block);
+	ast_t **cases = mem_malloc(MEM_ANALYZER, len * sizeof(ast_t *));
+	if (cases == NULL) {
+		perror("something went wrong with malloc in analyzer_rule_cases");
+		exit(1);
+	}
+
+	int count = 0;
+	ast_t *default_case = NULL;
+	for (int i = 0; i < len; i++) {
+		ast_t *case_stmt = stmt->switch_stmt.cases[i];
+		ast_t *value = case_stmt->case_stmt.value;
+		if (value == NULL) {
+			if (default_case) {
+				analyzer_error_set(case_stmt->filepath, case_stmt->src, case_stmt->start, case_stmt->end,
+					"switch statement has more than one default case");
+				mem_free(MEM_ANALYZER, cases);
+				return;
+			}
+			default_case = case_stmt;
+			continue;
+		}
+
+		// the value is a literal, negated when it is an unary minus
+		ast_t *literal = (value->type == AST_UNARY ? value->unary.right : value);
+		token_t token = literal->literal.token;
+		long long number = strtoll(token.src + token.start.index, NULL, 10);
+		if (value->type == AST_UNARY) number = -number;
+		if (number < INT_MIN || number > INT_MAX) {
+			analyzer_error_set(value->filepath, value->src, value->start, value->end,
+				"case value doesn't fit in an int");
+			mem_free(MEM_ANALYZER, cases);
+			return;
+		}
+
+		value->type_id = literal->type_id = st_check_type("int").id;
+		case_stmt->case_stmt.number = (int) number;
+		cases[count++] = case_stmt;
+	}
+
+	// equal values end up next to each other, the later one in the source second
+	qsort(cases, count, sizeof(ast_t *), analyzer_case_compare);
+	for (int i = 1; i < count; i++) {
+		if (cases[i-1]->case_stmt.number == cases[i]->case_stmt.number) {
+			analyzer_error_set(cases[i]->filepath, cases[i]->src, cases[i]->start, cases[i]->end,
+				"duplicate case value");
+			break;
+		}
+	}
+	mem_free(MEM_ANALYZER, cases);
+}
+
+int analyzer_case_compare(const void *a, const void *b) {
+	ast_t *left = *(ast_t **) a, *right = *(ast_t **) b;
+	if (left->case_stmt.number != right->case_stmt.number) {
+		return left->case_stmt.number < right->case_stmt.number ? -1 : 1;
+	}
+	return left->start.index - right->start.index;
+}
+
+ast_t *analyzer_rule_block_stmt(ast_t *stmt, int step) {
+	if (step >= stmt->block_stmt.len) {
+		return NULL;
+	}
+	return stmt->block_stmt.stmts[step];
+}
+
+void analyzer_rule_cond(ast_t *stmt, ast_t *cond, const char *message) {
+	analyzer_rule_expr(cond);
 	if (analyzer_error_check()) {
 		return;
 	}
 
-	if (!stmt->if_stmt.else_block) return;
-
-	analyzer_rule_stmt(stmt->if_stmt.else_block);
+	if (!is_numerical_type(cond->type_id)) {
+		analyzer_error_set(stmt->filepath, stmt->src, stmt->start, stmt->end, message);
+	}
 }
 
 void analyzer_rule_goto_stmt(ast_t *stmt) {
-	char *lexical = NULL;
-
 	if (stmt->type != AST_GOTO_STMT) {
 		analyzer_error_set(stmt->filepath, stmt->src, stmt->start, stmt->end,
 			"expected AST_GOTO_STMT ast");
-		goto cleanup;
+		return;
 	}
 
 	token_t label_token = stmt->goto_stmt.label;
-	lexical = token_lexical(label_token);
-	if (st_check_label(lexical).id == -1) {
+	name_t name = st_check_label_sym(label_token.sym_id);
+	if (name.id == -1) {
+		if (g_names_collected) {
+			analyzer_error_set(label_token.filepath, label_token.src, label_token.start, label_token.end,
+				"label not defined");
+			return;
+		}
+
+		// forward reference; the label has to be declared before analyze_end
+		name = st_create_label_sym(label_token.sym_id);
+		analyzer_label(name.id)->first_goto = label_token;
+		analyzer_label(name.id)->proc = g_proc;
+	}
+	else if (analyzer_label(name.id)->proc != g_proc) {
 		analyzer_error_set(label_token.filepath, label_token.src, label_token.start, label_token.end,
-			"label not defined");
-		goto cleanup;
+			"goto can't cross a procedure boundary");
+		return;
+	}
+	stmt->label_id = name.id;
+}
+
+void analyzer_rule_proc_stmt(ast_t *stmt) {
+	if (stmt->type != AST_PROC_STMT) {
+		analyzer_error_set(stmt->filepath, stmt->src, stmt->start, stmt->end,
+			"expected AST_PROC_STMT ast");
+		return;
+	}
+
+	// a whole program had its procedures declared by analyzer_collect_names
+	if (!g_names_collected) {
+		analyzer_declare_proc(stmt);
+		if (analyzer_error_check()) {
+			return;
+		}
+	}
+	else {
+		stmt->proc_id = st_check_proc_sym(stmt->proc_stmt.name.sym_id).id;
+	}
+
+	g_proc = stmt->proc_id;
+	analyzer_rule_compound_stmt(stmt->proc_stmt.body);
+	g_proc = 0;
+}
+
+void analyzer_rule_call_stmt(ast_t *stmt) {
+	if (stmt->type != AST_CALL_STMT) {
+		analyzer_error_set(stmt->filepath, stmt->src, stmt->start, stmt->end,
+			"expected AST_CALL_STMT ast");
+		return;
+	}
+
+	token_t name_token = stmt->call_stmt.name;
+	name_t name = st_check_proc_sym(name_token.sym_id);
+	if (name.id == -1) {
+		if (g_names_collected) {
+			analyzer_error_set(name_token.filepath, name_token.src, name_token.start, name_token.end,
+				"procedure not defined");
+			return;
+		}
+
+		// forward reference; the procedure has to be declared before analyze_end
+		name = st_create_proc_sym(name_token.sym_id);
+		analyzer_proc(name.id)->first_call = name_token;
 	}
+	stmt->proc_id = name.id;
+}
 
-cleanup:
-	free(lexical);
+void analyzer_rule_return_stmt(ast_t *stmt) {
+	if (stmt->type != AST_RETURN_STMT) {
+		analyzer_error_set(stmt->filepath, stmt->src, stmt->start, stmt->end,
+			"expected AST_RETURN_STMT ast");
+		return;
+	}
+
+	if (g_proc == 0) {
+		analyzer_error_set(stmt->filepath, stmt->src, stmt->start, stmt->end,
+			"return outside of a procedure");
+	}
 }
 
 void analyzer_rule_print_stmt(ast_t *stmt) {
@@ -263,25 +820,44 @@ void analyzer_rule_expr_stmt(ast_t *stmt) {
 }
 
 void analyzer_rule_expr(ast_t *expr) {
+	int base = g_frames_len;
+	analyzer_push_frame(expr);
+
+	while (g_frames_len > base) {
+		analyzer_frame_t *frame = &g_frames[g_frames_len - 1];
+		ast_t *child = analyzer_rule_expr_step(frame->ast, frame->step++);
+		if (analyzer_error_check()) {
+			g_frames_len = base;
+			return;
+		}
+
+		if (child) analyzer_push_frame(child);
+		else g_frames_len--;
+	}
+}
+
+ast_t *analyzer_rule_expr_step(ast_t *expr, int step) {
 	switch (expr->type) {
 	case AST_LITERAL:
 		analyzer_rule_literal(expr);
-		break;
+		return NULL;
 	case AST_IDENTIFIER:
 		analyzer_rule_identifier(expr);
-		break;
+		return NULL;
 	case AST_UNARY:
-		analyzer_rule_unary(expr);
-		break;
+		return analyzer_rule_unary(expr, step);
 	case AST_BINARY:
-		analyzer_rule_binary(expr);
-		break;
+		return analyzer_rule_binary(expr, step);
 	case AST_TERNARY:
-		analyzer_rule_ternary(expr);
-		break;
+		return analyzer_rule_ternary(expr, step);
+	case AST_INDEX:
+		return analyzer_rule_index(expr, step);
+	case AST_BUILTIN:
+		return analyzer_rule_builtin(expr, step);
 	default:
 		analyzer_error_set(expr->filepath, expr->src, expr->start, expr->end,
 			"unexpected expression");
+		return NULL;
 	}
 }
 
@@ -294,7 +870,14 @@ void analyzer_rule_literal(ast_t *expr) {
 
 	token_t token = expr->literal.token;
 	if (token.type == TT_INT_LITERAL) {
-		expr->type_id = st_check_type("int").id;
+		// literals that don't fit in an int are i64 and bigger ones are bigint
+		errno = 0;
+		long long value = strtoll(token.src + token.start.index, NULL, 10);
+		if (errno == ERANGE) {
+			expr->type_id = st_check_type("bigint").id;
+			return;
+		}
+		expr->type_id = st_check_type(value > INT_MAX ? "i64" : "int").id;
 	}
 	else {
 		analyzer_error_set(token.filepath, token.src, token.start, token.end,
@@ -304,40 +887,153 @@ void analyzer_rule_literal(ast_t *expr) {
 }
 
 void analyzer_rule_identifier(ast_t *expr) {
-	char *lexical = NULL;
-
 	if (expr->type != AST_IDENTIFIER) {
 		analyzer_error_set(expr->filepath, expr->src, expr->start, expr->end,
 			"expected AST_IDENTIFIER ast");
-		goto cleanup;
+		return;
 	}
 
 	token_t token = expr->identifier.token;
-	lexical = token_lexical(token);
 	if (token.type == TT_IDENTIFIER) {
-		name_t name = st_check_var(lexical);
+		name_t name = st_check_var_sym(token.sym_id);
 		if (name.id == -1) {
 			analyzer_error_set(expr->filepath, expr->src, expr->start, expr->end,
 				"variable undefined");
-			goto cleanup;
+			return;
+		}
+		if (is_array_type(name.type_id)) {
+			analyzer_error_set(expr->filepath, expr->src, expr->start, expr->end,
+				"array can only be indexed or passed to a builtin");
+			return;
 		}
 		expr->type_id = name.type_id;
+		expr->var_id = name.id;
 	}
 	else {
 		analyzer_error_set(token.filepath, token.src, token.start, token.end,
 			"unexpected identifier token");
-		goto cleanup;
+		return;
+	}
+}
+
+void analyzer_rule_array(ast_t *expr) {
+	if (expr->type != AST_IDENTIFIER) {
+		analyzer_error_set(expr->filepath, expr->src, expr->start, expr->end,
+			"expected an array");
+		return;
+	}
+
+	name_t name = st_check_var_sym(expr->identifier.token.sym_id);
+	if (name.id == -1) {
+		analyzer_error_set(expr->filepath, expr->src, expr->start, expr->end,
+			"variable undefined");
+		return;
+	}
+	if (!is_array_type(name.type_id)) {
+		analyzer_error_set(expr->filepath, expr->src, expr->start, expr->end,
+			"expected an array");
+		return;
+	}
+	expr->type_id = name.type_id;
+	expr->var_id = name.id;
+}
+
+ast_t *analyzer_rule_index(ast_t *expr, int step) {
+	if (expr->type != AST_INDEX) {
+		analyzer_error_set(expr->filepath, expr->src, expr->start, expr->end,
+			"expected AST_INDEX ast");
+		return NULL;
+	}
+
+	if (step == 0) {
+		analyzer_rule_array(expr->index.array);
+		if (analyzer_error_check()) {
+			return NULL;
+		}
+		return expr->index.expr;
+	}
+
+	if (expr->index.expr->type_id != st_check_type("int").id) {
+		analyzer_error_set(expr->filepath, expr->src, expr->start, expr->end,
+			"expected int type as index");
+		return NULL;
+	}
+
+	expr->type_id = st_check_type("int").id;
+	return NULL;
+}
+
+ast_t *analyzer_rule_builtin(ast_t *expr, int step) {
+	if (expr->type != AST_BUILTIN) {
+		analyzer_error_set(expr->filepath, expr->src, expr->start, expr->end,
+			"expected AST_BUILTIN ast");
+		return NULL;
+	}
+
+	if (step == 0) {
+		const analyzer_builtin_t *builtin = analyzer_builtin(expr->builtin.name);
+		if (builtin == NULL) {
+			analyzer_error_set(expr->filepath, expr->src, expr->start, expr->end,
+				"unknown builtin");
+			return NULL;
+		}
+		if ((int) strlen(builtin->args) != expr->builtin.len) {
+			analyzer_error_set(expr->filepath, expr->src, expr->start, expr->end,
+				"wrong number of arguments for builtin");
+			return NULL;
+		}
+		expr->builtin.kind = builtin->kind;
+
+		// array arguments are names, values are analyzed one per step
+		for (int i = 0; i < expr->builtin.len; i++) {
+			if (builtin->args[i] != 'a') continue;
+			analyzer_rule_array(expr->builtin.args[i]);
+			if (analyzer_error_check()) {
+				return NULL;
+			}
+		}
+	}
+	else {
+		ast_t *arg = analyzer_builtin_value_arg(expr, step - 1);
+		if (arg->type_id != st_check_type("int").id) {
+			analyzer_error_set(arg->filepath, arg->src, arg->start, arg->end,
+				"expected int argument");
+			return NULL;
+		}
+	}
+
+	ast_t *arg = analyzer_builtin_value_arg(expr, step);
+	if (arg) return arg;
+
+	expr->type_id = st_check_type("int").id;
+	return NULL;
+}
+
+const analyzer_builtin_t *analyzer_builtin(token_t name) {
+	int len = name.end.index - name.start.index;
+	for (int i = 0; i < (int) (sizeof(g_builtins) / sizeof(g_builtins[0])); i++) {
+		const char *builtin = g_builtins[i].name;
+		if (strncmp(builtin, name.src + name.start.index, len) == 0 && builtin[len] == '\0') {
+			return &g_builtins[i];
+		}
 	}
+	return NULL;
+}
 
-cleanup:
-	free(lexical);
+ast_t *analyzer_builtin_value_arg(ast_t *expr, int n) {
+	// n-th argument that is a value (null if there are fewer)
+	const char *args = g_builtins[expr->builtin.kind].args;
+	for (int i = 0; i < expr->builtin.len; i++) {
+		if (args[i] == 'v' && n-- == 0) return expr->builtin.args[i];
+	}
+	return NULL;
 }
 
-void analyzer_rule_unary(ast_t *expr) {
+ast_t *analyzer_rule_unary(ast_t *expr, int step) {
 	if (expr->type != AST_UNARY) {
 		analyzer_error_set(expr->filepath, expr->src, expr->start, expr->end,
 			"expected AST_UNARY ast");
-		return;
+		return NULL;
 	}
 
 	switch (expr->unary.op.type) {
@@ -345,45 +1041,46 @@ void analyzer_rule_unary(ast_t *expr) {
 	case TT_TILDE:
 	case TT_MINUS:
 	case TT_PLUS:
-		analyzer_rule_expr(expr->unary.right);
-		if (analyzer_error_check()) {
-			return;
-		}
+		if (step == 0) return expr->unary.right;
 
 		if (!is_numerical_type(expr->unary.right->type_id)) {
 			analyzer_error_set(expr->filepath, expr->src, expr->start, expr->end,
 				"expected numerical type in unary expression");
 		}
+		else if (expr->unary.op.type == TT_TILDE && is_bigint_type(expr->unary.right->type_id)) {
+			analyzer_error_set(expr->filepath, expr->src, expr->start, expr->end,
+				"bitwise operations aren't supported on bigint");
+		}
 
 		expr->type_id = expr->unary.right->type_id;
-		break;
+		if (expr->unary.op.type == TT_BANG) expr->type_id = st_check_type("int").id;
+		return NULL;
 	
 	case TT_MINUS_MINUS:
 	case TT_PLUS_PLUS:
-		if (!is_lhs(expr->unary.right)) {
-			analyzer_error_set(expr->filepath, expr->src, expr->start, expr->end,
-				"expected lhs");
-		}
-
-		analyzer_rule_expr(expr->unary.right);
-		if (analyzer_error_check()) {
-			return;
+		if (step == 0) {
+			if (!is_lhs(expr->unary.right)) {
+				analyzer_error_set(expr->filepath, expr->src, expr->start, expr->end,
+					"expected lhs");
+			}
+			return expr->unary.right;
 		}
 	
 		expr->type_id = expr->unary.right->type_id;
-		break;
+		return NULL;
 	
 	default:
 		analyzer_error_set(expr->filepath, expr->src, expr->start, expr->end,
 			"unexpected unary operation");
+		return NULL;
 	}
 }
 
-void analyzer_rule_binary(ast_t *expr) {
+ast_t *analyzer_rule_binary(ast_t *expr, int step) {
 	if (expr->type != AST_BINARY) {
 		analyzer_error_set(expr->filepath, expr->src, expr->start, expr->end,
 			"expected AST_BINARY ast");
-		return;
+		return NULL;
 	}
 
 	switch (expr->binary.op.type) {
@@ -406,87 +1103,171 @@ void analyzer_rule_binary(ast_t *expr) {
 	case TT_LOGICAL_AND:
 	case TT_LOGICAL_OR:
 	case TT_EQUAL:
-		if (expr->binary.op.type == TT_EQUAL && !is_lhs(expr->binary.left)) {
-			analyzer_error_set(expr->filepath, expr->src, expr->start, expr->end,
-				"expected lhs");
-			return;
+	case TT_PLUS_EQUAL:
+	case TT_MINUS_EQUAL:
+	case TT_STAR_EQUAL:
+	case TT_FSLASH_EQUAL:
+	case TT_MOD_EQUAL:
+	case TT_LSHIFT_EQUAL:
+	case TT_RSHIFT_EQUAL:
+	case TT_AMPERSAND_EQUAL:
+	case TT_PIPE_EQUAL:
+	case TT_CARET_EQUAL:
+		if (step == 0) {
+			if (is_assign_op(expr->binary.op.type) && !is_lhs(expr->binary.left)) {
+				analyzer_error_set(expr->filepath, expr->src, expr->start, expr->end,
+					"expected lhs");
+				return NULL;
+			}
+			return expr->binary.left;
 		}
 
-		analyzer_rule_expr(expr->binary.left);
-		if (analyzer_error_check()) {
-			return;
-		}
+		if (step == 1) return expr->binary.right;
 
-		analyzer_rule_expr(expr->binary.right);
-		if (analyzer_error_check()) {
-			return;
+		int ltype_id = expr->binary.left->type_id, rtype_id = expr->binary.right->type_id;
+		if (!is_compatible_type(ltype_id, rtype_id)) {
+			analyzer_error_set(expr->filepath, expr->src, expr->start, expr->end,
+				"left side of operation is uncompatible with right side");
+			return NULL;
 		}
 
-		if (!is_compatible_type(expr->binary.left->type_id, expr->binary.right->type_id)) {
+		if (is_bitwise_op(expr->binary.op.type) && (is_bigint_type(ltype_id) || is_bigint_type(rtype_id))) {
 			analyzer_error_set(expr->filepath, expr->src, expr->start, expr->end,
-				"left side of operation is uncompatible with right side");
-			return;
+				"bitwise operations aren't supported on bigint");
+			return NULL;
 		}
 
-		expr->type_id = bigger_type_id(expr->binary.left->type_id, expr->binary.right->type_id);
-		break;
+		// comparisons give an int and assignments may only widen
+		if (is_assign_op(expr->binary.op.type)) {
+			if (bigger_type_id(ltype_id, rtype_id) != ltype_id) {
+				analyzer_error_set(expr->filepath, expr->src, expr->start, expr->end,
+					"right side of assignment is wider than the left side");
+				return NULL;
+			}
+			expr->type_id = ltype_id;
+		}
+		else if (is_boolean_op(expr->binary.op.type)) {
+			expr->type_id = st_check_type("int").id;
+		}
+		else {
+			expr->type_id = bigger_type_id(ltype_id, rtype_id);
+		}
+		return NULL;
 
 	default:
 		analyzer_error_set(expr->filepath, expr->src, expr->start, expr->end,
 			"unsupported binary operation");
+		return NULL;
 	}
 }
 
-void analyzer_rule_ternary(ast_t *expr) {
+ast_t *analyzer_rule_ternary(ast_t *expr, int step) {
 	if (expr->type != AST_TERNARY) {
 		analyzer_error_set(expr->filepath, expr->src, expr->start, expr->end,
 			"expected AST_BINARY ast");
-		return;
-	}
-
-	analyzer_rule_expr(expr->ternary.left);
-	if (analyzer_error_check()) {
-		return;
-	}
-
-	if (!is_numerical_type(expr->ternary.left->type_id)) {
-		analyzer_error_set(expr->filepath, expr->src, expr->start, expr->end,
-			"expected numeric type in ternary condition");
-		return;
+		return NULL;
 	}
 
-	analyzer_rule_expr(expr->ternary.mid);
-	if (analyzer_error_check()) {
-		return;
-	}
-
-	analyzer_rule_expr(expr->ternary.right);
-	if (analyzer_error_check()) {
-		return;
+	switch (step) {
+	case 0:
+		return expr->ternary.left;
+	case 1:
+		if (!is_numerical_type(expr->ternary.left->type_id)) {
+			analyzer_error_set(expr->filepath, expr->src, expr->start, expr->end,
+				"expected numeric type in ternary condition");
+			return NULL;
+		}
+		return expr->ternary.mid;
+	case 2:
+		return expr->ternary.right;
 	}
 
 	if (!is_compatible_type(expr->ternary.mid->type_id, expr->ternary.right->type_id)) {
 		analyzer_error_set(expr->filepath, expr->src, expr->start, expr->end,
 			"uncompatible mid and right block of ternary operator");
-		return;
+		return NULL;
 	}
 
 	expr->type_id = bigger_type_id(expr->ternary.mid->type_id, expr->ternary.right->type_id);
+	return NULL;
 }
 
 int is_numerical_type(int type_id) {
-	return st_check_type("int").id == type_id;
+	return st_check_type("int").id == type_id || st_check_type("i64").id == type_id || is_bigint_type(type_id);
+}
+
+int is_bigint_type(int type_id) {
+	return st_check_type("bigint").id == type_id;
+}
+
+int is_array_type(int type_id) {
+	return st_check_type("int[]").id == type_id;
 }
 
 int is_lhs(ast_t *expr) {
-	return expr->type == AST_IDENTIFIER;
+	return expr->type == AST_IDENTIFIER || expr->type == AST_INDEX;
+}
+
+int is_assign_op(int token_type) {
+	switch (token_type) {
+	case TT_EQUAL:
+	case TT_PLUS_EQUAL:
+	case TT_MINUS_EQUAL:
+	case TT_STAR_EQUAL:
+	case TT_FSLASH_EQUAL:
+	case TT_MOD_EQUAL:
+	case TT_LSHIFT_EQUAL:
+	case TT_RSHIFT_EQUAL:
+	case TT_AMPERSAND_EQUAL:
+	case TT_PIPE_EQUAL:
+	case TT_CARET_EQUAL:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+int is_bitwise_op(int token_type) {
+	switch (token_type) {
+	case TT_LSHIFT:
+	case TT_RSHIFT:
+	case TT_AMPERSAND:
+	case TT_CARET:
+	case TT_PIPE:
+	case TT_LSHIFT_EQUAL:
+	case TT_RSHIFT_EQUAL:
+	case TT_AMPERSAND_EQUAL:
+	case TT_PIPE_EQUAL:
+	case TT_CARET_EQUAL:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+int is_boolean_op(int token_type) {
+	switch (token_type) {
+	case TT_EQUAL_EQUAL:
+	case TT_BANG_EQUAL:
+	case TT_LESSER:
+	case TT_LESSER_EQUAL:
+	case TT_GREATER:
+	case TT_GREATER_EQUAL:
+	case TT_LOGICAL_AND:
+	case TT_LOGICAL_OR:
+		return 1;
+	default:
+		return 0;
+	}
 }
 
 int bigger_type_id(int ltype_id, int rtype_id) {
-	return ltype_id;
+	int i64_type_id = st_check_type("i64").id, bigint_type_id = st_check_type("bigint").id;
+	if (ltype_id == bigint_type_id || rtype_id == bigint_type_id) return bigint_type_id;
+	return ltype_id == i64_type_id || rtype_id == i64_type_id ? i64_type_id : ltype_id;
 }
 
 int is_compatible_type(int ltype_id, int rtype_id) {
-	return ltype_id == rtype_id;
+	return ltype_id == rtype_id || (is_numerical_type(ltype_id) && is_numerical_type(rtype_id));
 }
 
@@ -1,4 +1,5 @@
 #include "ast.h"
+#include "mem.h"
 
 #include <assert.h>
 #include <stdio.h>
@@ -8,7 +9,16 @@
 // helper declaration
 // ========================================
 
+typedef struct {
+	ast_t **items;
+	int len;
+	int cap;
+} ast_stack_t;
+
+static int g_ast_count;
+
 ast_t *ast_malloc(int type, pos_t start, pos_t end, const char *filepath, const char *src);
+void ast_stack_push(ast_stack_t *stack, ast_t *ast);
 void ast_print_helper(ast_t *ast, char *last, int depth);
 void ast_print_token(token_t token);
 
@@ -19,49 +29,104 @@ void ast_print_token(token_t token);
 void ast_free(ast_t *ast) {
 	if (ast == NULL) return;
 
-	switch (ast->type) {
-	case AST_LITERAL:
-	case AST_IDENTIFIER:
-		break;
-	case AST_UNARY:
-		ast_free(ast->unary.right);
-		break;
-	case AST_BINARY:
-		ast_free(ast->binary.left);
-		ast_free(ast->binary.right);
-		break;
-	case AST_TERNARY:
-		ast_free(ast->ternary.left);
-		ast_free(ast->ternary.mid);
-		ast_free(ast->ternary.right);
-		break;
-	case AST_EXPR_STMT:
-		ast_free(ast->expr_stmt.expr);
-		break;
-	case AST_LABEL_STMT:
-		break;
-	case AST_VAR_STMT:
-		ast_free(ast->var_stmt.expr);
-		break;
-	case AST_PRINT_STMT:
-		ast_free(ast->print_stmt.expr);
-		break;
-	case AST_GOTO_STMT:
-		break;
-	case AST_IF_STMT:
-		ast_free(ast->if_stmt.if_cond);
-		ast_free(ast->if_stmt.if_block);
-		ast_free(ast->if_stmt.else_block);
-		break;
-	case AST_PROG: {
-		for (int i = 0; i < ast->prog.len; i++) {
-			ast_free(ast->prog.stmts[i]);
+	// free with an explicit stack so deeply nested trees can't overflow
+	ast_stack_t stack = {};
+	ast_stack_push(&stack, ast);
+
+	while (stack.len > 0) {
+		ast = stack.items[--stack.len];
+
+		switch (ast->type) {
+		case AST_LITERAL:
+		case AST_IDENTIFIER:
+			break;
+		case AST_UNARY:
+			ast_stack_push(&stack, ast->unary.right);
+			break;
+		case AST_BINARY:
+			ast_stack_push(&stack, ast->binary.left);
+			ast_stack_push(&stack, ast->binary.right);
+			break;
+		case AST_TERNARY:
+			ast_stack_push(&stack, ast->ternary.left);
+			ast_stack_push(&stack, ast->ternary.mid);
+			ast_stack_push(&stack, ast->ternary.right);
+			break;
+		case AST_INDEX:
+			ast_stack_push(&stack, ast->index.array);
+			ast_stack_push(&stack, ast->index.expr);
+			break;
+		case AST_BUILTIN:
+			for (int i = 0; i < ast->builtin.len; i++) {
+				ast_stack_push(&stack, ast->builtin.args[i]);
+			}
+			mem_free(MEM_AST, ast->builtin.args);
+			break;
+		case AST_EXPR_STMT:
+			ast_stack_push(&stack, ast->expr_stmt.expr);
+			break;
+		case AST_LABEL_STMT:
+			break;
+		case AST_VAR_STMT:
+			ast_stack_push(&stack, ast->var_stmt.type);
+			ast_stack_push(&stack, ast->var_stmt.size);
+			ast_stack_push(&stack, ast->var_stmt.expr);
+			break;
+		case AST_PRINT_STMT:
+			ast_stack_push(&stack, ast->print_stmt.expr);
+			break;
+		case AST_GOTO_STMT:
+			break;
+		case AST_PROC_STMT:
+			ast_stack_push(&stack, ast->proc_stmt.body);
+			break;
+		case AST_CALL_STMT:
+		case AST_RETURN_STMT:
+			break;
+		case AST_IF_STMT:
+			ast_stack_push(&stack, ast->if_stmt.if_cond);
+			ast_stack_push(&stack, ast->if_stmt.if_block);
+			ast_stack_push(&stack, ast->if_stmt.else_block);
+			break;
+		case AST_WHILE_STMT:
+			ast_stack_push(&stack, ast->while_stmt.cond);
+			ast_stack_push(&stack, ast->while_stmt.body);
+			break;
+		case AST_FOR_STMT:
+			ast_stack_push(&stack, ast->for_stmt.init);
+			ast_stack_push(&stack, ast->for_stmt.cond);
+			ast_stack_push(&stack, ast->for_stmt.step);
+			ast_stack_push(&stack, ast->for_stmt.body);
+			break;
+		case AST_SWITCH_STMT:
+			ast_stack_push(&stack, ast->switch_stmt.expr);
+			for (int i = 0; i < ast->switch_stmt.len; i++) {
+				ast_stack_push(&stack, ast->switch_stmt.cases[i]);
+			}
+			mem_free(MEM_AST, ast->switch_stmt.cases);
+			break;
+		case AST_CASE_STMT:
+			ast_stack_push(&stack, ast->case_stmt.value);
+			ast_stack_push(&stack, ast->case_stmt.body);
+			break;
+		case AST_BLOCK_STMT:
+			for (int i = 0; i < ast->block_stmt.len; i++) {
+				ast_stack_push(&stack, ast->block_stmt.stmts[i]);
+			}
+			mem_free(MEM_AST, ast->block_stmt.stmts);
+			break;
+		case AST_PROG: {
+			for (int i = 0; i < ast->prog.len; i++) {
+				ast_stack_push(&stack, ast->prog.stmts[i]);
+			}
+			mem_free(MEM_AST, ast->prog.stmts);
 		}
-		free(ast->prog.stmts);
-	}
+		}
+
+		mem_free(MEM_AST, ast);
 	}
 
-	free(ast);
+	mem_free(MEM_AST, stack.items);
 }
 
 ast_t *ast_literal(token_t token) {
@@ -99,6 +164,43 @@ ast_t *ast_identifier(token_t token) {
 	return res;
 }
 
+ast_t *ast_index(ast_t *array, ast_t *expr, token_t rbracket) {
+	ast_t *res = ast_malloc(AST_INDEX, array->start, rbracket.end, array->filepath, array->src);
+	res->index.array = array;
+	res->index.expr = expr;
+	res->index.rbracket = rbracket;
+	return res;
+}
+
+ast_t *ast_builtin(token_t name) {
+	ast_t *res = ast_malloc(AST_BUILTIN, name.start, name.end, name.filepath, name.src);
+	res->builtin.name = name;
+	res->builtin.args = NULL;
+	res->builtin.cap = res->builtin.len = 0;
+	res->builtin.kind = -1;
+	return res;
+}
+
+void ast_builtin_append(ast_t *builtin, ast_t *arg) {
+	assert(builtin->type == AST_BUILTIN);
+
+	builtin->builtin.len++;
+	if (builtin->builtin.cap <= builtin->builtin.len) {
+		builtin->builtin.cap = (builtin->builtin.cap + 1) * 2;
+		builtin->builtin.args = mem_realloc(MEM_AST, builtin->builtin.args, sizeof(ast_t *) * builtin->builtin.cap);
+		if (builtin->builtin.args == NULL) {
+			perror("Something went wrong while realloc in ast_builtin_append");
+			exit(1);
+		}
+	}
+	builtin->builtin.args[builtin->builtin.len-1] = arg;
+}
+
+void ast_builtin_close(ast_t *builtin, token_t rparen) {
+	assert(builtin->type == AST_BUILTIN);
+	builtin->end = rparen.end;
+}
+
 ast_t *ast_label_stmt(token_t label, token_t colon) {
 	ast_t *res = ast_malloc(AST_LABEL_STMT, label.start, colon.end, label.filepath, label.src);
 	res->label_stmt.label = label;
@@ -106,11 +208,13 @@ ast_t *ast_label_stmt(token_t label, token_t colon) {
 	return res;
 }
 
-ast_t *ast_var_stmt(token_t var_keyword, token_t name, ast_t *expr, token_t semicolon) {
+ast_t *ast_var_stmt(token_t var_keyword, token_t name, ast_t *type, ast_t *size, ast_t *expr, token_t semicolon) {
 	ast_t *res = ast_malloc(AST_VAR_STMT, var_keyword.start, semicolon.end, 
 		var_keyword.filepath, var_keyword.src);
 	res->var_stmt.var_keyword = var_keyword;
 	res->var_stmt.name = name;
+	res->var_stmt.type = type;
+	res->var_stmt.size = size;
 	res->var_stmt.expr = expr;
 	res->var_stmt.semicolon = semicolon;
 	return res;
@@ -132,6 +236,30 @@ ast_t *ast_goto_stmt(token_t goto_keyword, token_t label, token_t semicolon) {
 	return res;
 }
 
+ast_t *ast_proc_stmt(token_t proc_keyword, token_t name, ast_t *body) {
+	ast_t *res = ast_malloc(AST_PROC_STMT, proc_keyword.start, body->end, proc_keyword.filepath, proc_keyword.src);
+	res->proc_stmt.proc_keyword = proc_keyword;
+	res->proc_stmt.name = name;
+	res->proc_stmt.body = body;
+	return res;
+}
+
+ast_t *ast_call_stmt(token_t call_keyword, token_t name, token_t semicolon) {
+	ast_t *res = ast_malloc(AST_CALL_STMT, call_keyword.start, semicolon.end, call_keyword.filepath, call_keyword.src);
+	res->call_stmt.call_keyword = call_keyword;
+	res->call_stmt.name = name;
+	res->call_stmt.semicolon = semicolon;
+	return res;
+}
+
+ast_t *ast_return_stmt(token_t return_keyword, token_t semicolon) {
+	ast_t *res = ast_malloc(AST_RETURN_STMT, return_keyword.start, semicolon.end,
+		return_keyword.filepath, return_keyword.src);
+	res->return_stmt.return_keyword = return_keyword;
+	res->return_stmt.semicolon = semicolon;
+	return res;
+}
+
 ast_t *ast_if_stmt(token_t if_keyword, ast_t *if_cond, ast_t *if_block, ast_t *else_block) {
 	pos_t end = (else_block ? else_block->end : if_block->end);
 	ast_t *res = ast_malloc(AST_IF_STMT, if_keyword.start, end, if_keyword.filepath, if_keyword.src);
@@ -142,6 +270,92 @@ ast_t *ast_if_stmt(token_t if_keyword, ast_t *if_cond, ast_t *if_block, ast_t *e
 	return res;
 }
 
+ast_t *ast_while_stmt(token_t while_keyword, ast_t *cond, ast_t *body) {
+	ast_t *res = ast_malloc(AST_WHILE_STMT, while_keyword.start, body->end, 
+		while_keyword.filepath, while_keyword.src);
+	res->while_stmt.while_keyword = while_keyword;
+	res->while_stmt.cond = cond;
+	res->while_stmt.body = body;
+	return res;
+}
+
+ast_t *ast_for_stmt(token_t for_keyword, ast_t *init, ast_t *cond, ast_t *step, ast_t *body) {
+	ast_t *res = ast_malloc(AST_FOR_STMT, for_keyword.start, body->end, for_keyword.filepath, for_keyword.src);
+	res->for_stmt.for_keyword = for_keyword;
+	res->for_stmt.init = init;
+	res->for_stmt.cond = cond;
+	res->for_stmt.step = step;
+	res->for_stmt.body = body;
+	return res;
+}
+
+ast_t *ast_switch_stmt(token_t switch_keyword, ast_t *expr) {
+	ast_t *res = ast_malloc(AST_SWITCH_STMT, switch_keyword.start, expr->end,
+		switch_keyword.filepath, switch_keyword.src);
+	res->switch_stmt.switch_keyword = switch_keyword;
+	res->switch_stmt.expr = expr;
+	res->switch_stmt.cases = NULL;
+	res->switch_stmt.cap = res->switch_stmt.len = 0;
+	return res;
+}
+
+void ast_switch_stmt_append(ast_t *switch_stmt, ast_t *case_stmt) {
+	assert(switch_stmt->type == AST_SWITCH_STMT);
+
+	switch_stmt->switch_stmt.len++;
+	if (switch_stmt->switch_stmt.cap <= switch_stmt->switch_stmt.len) {
+		switch_stmt->switch_stmt.cap = (switch_stmt->switch_stmt.cap + 1) * 2;
+		switch_stmt->switch_stmt.cases = mem_realloc(MEM_AST, switch_stmt->switch_stmt.cases,
+			sizeof(ast_t *) * switch_stmt->switch_stmt.cap);
+		if (switch_stmt->switch_stmt.cases == NULL) {
+			perror("Something went wrong while realloc in ast_switch_stmt_append");
+			exit(1);
+		}
+	}
+	switch_stmt->switch_stmt.cases[switch_stmt->switch_stmt.len-1] = case_stmt;
+}
+
+void ast_switch_stmt_close(ast_t *switch_stmt, token_t rbrace) {
+	assert(switch_stmt->type == AST_SWITCH_STMT);
+	switch_stmt->end = rbrace.end;
+}
+
+ast_t *ast_case_stmt(token_t case_keyword, ast_t *value, token_t colon) {
+	ast_t *res = ast_malloc(AST_CASE_STMT, case_keyword.start, colon.end, case_keyword.filepath, case_keyword.src);
+	res->case_stmt.case_keyword = case_keyword;
+	res->case_stmt.value = value;
+	res->case_stmt.number = 0;
+	res->case_stmt.body = ast_block_stmt(colon);
+	return res;
+}
+
+ast_t *ast_block_stmt(token_t lbrace) {
+	ast_t *res = ast_malloc(AST_BLOCK_STMT, lbrace.start, lbrace.end, lbrace.filepath, lbrace.src);
+	res->block_stmt.stmts = NULL;
+	res->block_stmt.cap = res->block_stmt.len = 0;
+	return res;
+}
+
+void ast_block_stmt_append(ast_t *block, ast_t *stmt) {
+	assert(block->type == AST_BLOCK_STMT);
+
+	block->block_stmt.len++;
+	if (block->block_stmt.cap <= block->block_stmt.len) {
+		block->block_stmt.cap = (block->block_stmt.cap + 1) * 2;
+		block->block_stmt.stmts = mem_realloc(MEM_AST, block->block_stmt.stmts, sizeof(ast_t *) * block->block_stmt.cap);
+		if (block->block_stmt.stmts == NULL) {
+			perror("Something went wrong while realloc in ast_block_stmt_append");
+			exit(1);
+		}
+	}
+	block->block_stmt.stmts[block->block_stmt.len-1] = stmt;
+}
+
+void ast_block_stmt_close(ast_t *block, token_t rbrace) {
+	assert(block->type == AST_BLOCK_STMT);
+	block->end = rbrace.end;
+}
+
 ast_t *ast_expr_stmt(ast_t *expr, token_t semicolon) {
 	ast_t *res = ast_malloc(AST_EXPR_STMT, expr->start, semicolon.end, expr->filepath, expr->src);
 	res->expr_stmt.expr = expr;
@@ -168,7 +382,7 @@ void ast_prog_append(ast_t *prog, ast_t *stmt) {
 	prog->prog.len++;
 	if (prog->prog.cap <= prog->prog.len) {
 		prog->prog.cap = (prog->prog.cap + 1) * 2;
-		prog->prog.stmts = realloc(prog->prog.stmts, sizeof(ast_t *) * prog->prog.cap);
+		prog->prog.stmts = mem_realloc(MEM_AST, prog->prog.stmts, sizeof(ast_t *) * prog->prog.cap);
 		if (prog->prog.stmts == NULL) {
 			perror("Something went wrong while realloc in ast_prog_append");
 			exit(1);
@@ -177,6 +391,15 @@ void ast_prog_append(ast_t *prog, ast_t *stmt) {
 	prog->prog.stmts[prog->prog.len-1] = stmt;
 }
 
+int ast_is_compound_stmt(ast_t *ast) {
+	return ast->type == AST_IF_STMT || ast->type == AST_WHILE_STMT ||
+		ast->type == AST_FOR_STMT || ast->type == AST_SWITCH_STMT || ast->type == AST_BLOCK_STMT;
+}
+
+int ast_count() {
+	return g_ast_count;
+}
+
 void ast_print(ast_t *ast) {
 	char last[AST_PRINT_DEPTH] = {};
 	printf("AST\n");
@@ -188,12 +411,13 @@ void ast_print(ast_t *ast) {
 // ========================================
 
 ast_t *ast_malloc(int type, pos_t start, pos_t end, const char *filepath, const char *src) {
-	ast_t *res = malloc(sizeof(ast_t));
+	ast_t *res = mem_malloc(MEM_AST, sizeof(ast_t));
 	if (res == NULL) {
 		perror("Error on malloc in ast_malloc");
 		exit(1);
 	}
 
+	g_ast_count++;
 	res->type = type;
 	res->start = start;
 	res->end = end;
@@ -202,9 +426,24 @@ ast_t *ast_malloc(int type, pos_t start, pos_t end, const char *filepath, const
 	res->type_id = -1;
 	res->label_id = -1;
 	res->var_id = -1;
+	res->proc_id = -1;
 	return res;
 }
 
+void ast_stack_push(ast_stack_t *stack, ast_t *ast) {
+	if (ast == NULL) return;
+
+	if (stack->cap <= stack->len) {
+		stack->cap = (stack->cap + 1) * 2;
+		stack->items = mem_realloc(MEM_AST, stack->items, stack->cap * sizeof(ast_t *));
+		if (stack->items == NULL) {
+			perror("Error on realloc in ast_stack_push");
+			exit(1);
+		}
+	}
+	stack->items[stack->len++] = ast;
+}
+
 void ast_print_helper(ast_t *ast, char *last, int depth) {
 	for (int i = 0; i < depth; i++) {
 		if (last[i]) printf("|   ");
@@ -259,6 +498,27 @@ void ast_print_helper(ast_t *ast, char *last, int depth) {
 		last[depth+1] = 0;
 		break;
 
+	case AST_INDEX:
+		printf("+-- AST_INDEX\n");
+
+		ast_print_helper(ast->index.array, last, depth+1);
+
+		last[depth+1] = 0;
+		ast_print_helper(ast->index.expr, last, depth+1);
+		break;
+
+	case AST_BUILTIN:
+		printf("+-- AST_BUILTIN(");
+		ast_print_token(ast->builtin.name);
+		printf(")\n");
+
+		for (int i = 0; i < ast->builtin.len; i++) {
+			if (i == ast->builtin.len - 1) last[depth+1] = 0;
+			ast_print_helper(ast->builtin.args[i], last, depth+1);
+		}
+		last[depth+1] = 0;
+		break;
+
 	case AST_LABEL_STMT:
 		printf("+-- AST_LABEL_STMT(");
 		ast_print_token(ast->label_stmt.label);
@@ -272,6 +532,16 @@ void ast_print_helper(ast_t *ast, char *last, int depth) {
 		ast_print_token(ast->var_stmt.name);
 		printf(")\n");
 
+		last[depth+1] = !!(ast->var_stmt.size || ast->var_stmt.expr);
+		if (ast->var_stmt.type) {
+			ast_print_helper(ast->var_stmt.type, last, depth+1);
+		}
+
+		last[depth+1] = !!(ast->var_stmt.size && ast->var_stmt.expr);
+		if (ast->var_stmt.size) {
+			ast_print_helper(ast->var_stmt.size, last, depth+1);
+		}
+
 		last[depth+1] = 0;
 		if (ast->var_stmt.expr) {
 			ast_print_helper(ast->var_stmt.expr, last, depth+1);
@@ -293,6 +563,29 @@ void ast_print_helper(ast_t *ast, char *last, int depth) {
 		last[depth+1] = 0;
 		break;
 	
+	case AST_PROC_STMT:
+		printf("+-- AST_PROC_STMT(");
+		ast_print_token(ast->proc_stmt.name);
+		printf(")\n");
+
+		last[depth+1] = 0;
+		ast_print_helper(ast->proc_stmt.body, last, depth+1);
+		break;
+
+	case AST_CALL_STMT:
+		printf("+-- AST_CALL_STMT(");
+		ast_print_token(ast->call_stmt.name);
+		printf(")\n");
+
+		last[depth+1] = 0;
+		break;
+
+	case AST_RETURN_STMT:
+		printf("+-- AST_RETURN_STMT\n");
+
+		last[depth+1] = 0;
+		break;
+
 	case AST_IF_STMT:
 		printf("+-- AST_IF_STMT\n");
 
@@ -307,6 +600,64 @@ void ast_print_helper(ast_t *ast, char *last, int depth) {
 		}
 		break;
 
+	case AST_WHILE_STMT:
+		printf("+-- AST_WHILE_STMT\n");
+
+		ast_print_helper(ast->while_stmt.cond, last, depth+1);
+
+		last[depth+1] = 0;
+		ast_print_helper(ast->while_stmt.body, last, depth+1);
+		break;
+
+	case AST_FOR_STMT: {
+		printf("+-- AST_FOR_STMT\n");
+
+		// missing parts of the header are not printed
+		ast_t *parts[] = {ast->for_stmt.init, ast->for_stmt.cond, ast->for_stmt.step};
+		for (int i = 0; i < 3; i++) {
+			if (parts[i]) ast_print_helper(parts[i], last, depth+1);
+		}
+
+		last[depth+1] = 0;
+		ast_print_helper(ast->for_stmt.body, last, depth+1);
+		break;
+	}
+
+	case AST_SWITCH_STMT:
+		printf("+-- AST_SWITCH_STMT\n");
+
+		if (ast->switch_stmt.len == 0) last[depth+1] = 0;
+		ast_print_helper(ast->switch_stmt.expr, last, depth+1);
+		for (int i = 0; i < ast->switch_stmt.len; i++) {
+			if (i == ast->switch_stmt.len - 1) last[depth+1] = 0;
+			ast_print_helper(ast->switch_stmt.cases[i], last, depth+1);
+		}
+		last[depth+1] = 0;
+		break;
+
+	case AST_CASE_STMT:
+		printf("+-- AST_CASE_STMT(");
+		ast_print_token(ast->case_stmt.case_keyword);
+		printf(")\n");
+
+		if (ast->case_stmt.value) {
+			ast_print_helper(ast->case_stmt.value, last, depth+1);
+		}
+
+		last[depth+1] = 0;
+		ast_print_helper(ast->case_stmt.body, last, depth+1);
+		break;
+
+	case AST_BLOCK_STMT:
+		printf("+-- AST_BLOCK_STMT\n");
+
+		for (int i = 0; i < ast->block_stmt.len; i++) {
+			if (i == ast->block_stmt.len - 1) last[depth+1] = 0;
+			ast_print_helper(ast->block_stmt.stmts[i], last, depth+1);
+		}
+		last[depth+1] = 0;
+		break;
+
 	case AST_EXPR_STMT:
 		printf("+-- AST_EXPR_STMT\n");
 
@@ -0,0 +1,613 @@
+#include "bigint.h"
+#include "mem.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ========================================
+// helper declaration
+// ========================================
+
+#if BIGINT_LIMB_BITS == 64
+typedef unsigned __int128 bigint_dlimb_t;
+#define BIGINT_DECIMAL_BASE 10000000000000000000ull	// largest power of 10 in a limb
+#define BIGINT_DECIMAL_DIGITS 19
+#else
+typedef uint64_t bigint_dlimb_t;
+#define BIGINT_DECIMAL_BASE 1000000000u
+#define BIGINT_DECIMAL_DIGITS 9
+#endif
+
+#define BIGINT_KARATSUBA_THRESHOLD 32	// shorter operands use the schoolbook multiplication
+#define BIGINT_PRINT_THRESHOLD 32	// shorter numbers are printed by repeated division by the decimal base
+#define BIGINT_POWERS_MAX 32
+
+// BIGINT_DECIMAL_BASE^(2^k) for the divide-and-conquer printer, squared on
+// demand; vms on several threads share it, so it only grows under the lock
+static bigint_t g_powers[BIGINT_POWERS_MAX];
+static int g_powers_len;
+static pthread_mutex_t g_powers_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void bigint_reserve(bigint_t *x, int cap);
+void bigint_trim(bigint_t *x);
+void bigint_install(bigint_t *x, bigint_limb_t *limbs, int len, int cap, int negative);
+void bigint_add_signed(bigint_t *res, const bigint_t *a, const bigint_t *b, int b_negative);
+bigint_limb_t *bigint_alloc_limbs(int len);
+
+int mag_len(const bigint_limb_t *a, int len);
+int mag_cmp(const bigint_limb_t *a, int an, const bigint_limb_t *b, int bn);
+bigint_limb_t mag_add(bigint_limb_t *r, const bigint_limb_t *a, int an, const bigint_limb_t *b, int bn);
+bigint_limb_t mag_sub(bigint_limb_t *r, const bigint_limb_t *a, int an, const bigint_limb_t *b, int bn);
+bigint_limb_t mag_mul_limb_add(bigint_limb_t *r, const bigint_limb_t *a, int len, bigint_limb_t m);
+void mag_mul_basecase(bigint_limb_t *r, const bigint_limb_t *a, int an, const bigint_limb_t *b, int bn);
+void mag_mul(bigint_limb_t *r, const bigint_limb_t *a, int an, const bigint_limb_t *b, int bn);
+void mag_karatsuba(bigint_limb_t *r, const bigint_limb_t *a, int an, const bigint_limb_t *b, int bn);
+bigint_limb_t mag_divmod_limb(bigint_limb_t *q, const bigint_limb_t *a, int len, bigint_limb_t d);
+void mag_divmod(bigint_limb_t *q, bigint_limb_t *r, const bigint_limb_t *u, int un, const bigint_limb_t *v, int vn);
+
+const bigint_t *bigint_power(int k);
+char *bigint_write(const bigint_limb_t *x, int len, char *end, int pad);
+char *bigint_write_limb(bigint_limb_t value, char *end, int pad);
+
+// ========================================
+// bigint.h - definition
+// ========================================
+
+void bigint_init(bigint_t *x) {
+	x->limbs = NULL;
+	x->len = x->cap = 0;
+	x->negative = 0;
+}
+
+void bigint_free(bigint_t *x) {
+	mem_free(MEM_VM, x->limbs);
+	bigint_init(x);
+}
+
+void bigint_set(bigint_t *x, long long value) {
+	unsigned long long magnitude = value < 0 ? -(unsigned long long) value : (unsigned long long) value;
+
+	bigint_reserve(x, 64 / BIGINT_LIMB_BITS);
+	x->len = 0;
+	while (magnitude) {
+		x->limbs[x->len++] = (bigint_limb_t) magnitude;
+		magnitude = BIGINT_LIMB_BITS == 64 ? 0 : magnitude >> (BIGINT_LIMB_BITS % 64);
+	}
+	x->negative = value < 0;
+}
+
+void bigint_set_chunk(bigint_t *x, int index, unsigned int chunk) {
+	int limb = index * 32 / BIGINT_LIMB_BITS, shift = index * 32 % BIGINT_LIMB_BITS;
+
+	bigint_reserve(x, limb + 1);
+	while (x->len <= limb) x->limbs[x->len++] = 0;
+	x->limbs[limb] &= ~((bigint_limb_t) 0xffffffffu << shift);
+	x->limbs[limb] |= (bigint_limb_t) chunk << shift;
+	bigint_trim(x);
+}
+
+int bigint_chunks(const bigint_t *x) {
+	int chunks = x->len * (BIGINT_LIMB_BITS / 32);
+	while (chunks > 0 && bigint_chunk(x, chunks - 1) == 0) chunks--;
+	return chunks;
+}
+
+unsigned int bigint_chunk(const bigint_t *x, int index) {
+	int limb = index * 32 / BIGINT_LIMB_BITS, shift = index * 32 % BIGINT_LIMB_BITS;
+	if (limb >= x->len) return 0;
+	return (unsigned int) (x->limbs[limb] >> shift);
+}
+
+void bigint_parse(bigint_t *x, const char *str, int len) {
+	x->len = 0;
+	x->negative = 0;
+
+	// x = x * 10^digits + group for every group of up to BIGINT_DECIMAL_DIGITS digits
+	int i = 0;
+	while (i < len) {
+		int digits = (len - i) % BIGINT_DECIMAL_DIGITS;
+		if (digits == 0) digits = BIGINT_DECIMAL_DIGITS;
+
+		bigint_limb_t group = 0, scale = 1;
+		for (int end = i + digits; i < end; i++) {
+			group = group * 10 + (bigint_limb_t) (str[i] - '0');
+			scale *= 10;
+		}
+
+		bigint_reserve(x, x->len + 1);
+		bigint_limb_t carry = group;
+		for (int j = 0; j < x->len; j++) {
+			bigint_dlimb_t product = (bigint_dlimb_t) x->limbs[j] * scale + carry;
+			x->limbs[j] = (bigint_limb_t) product;
+			carry = (bigint_limb_t) (product >> BIGINT_LIMB_BITS);
+		}
+		if (carry) x->limbs[x->len++] = carry;
+	}
+}
+
+void bigint_copy(bigint_t *dst, const bigint_t *src) {
+	if (dst == src) return;
+
+	bigint_reserve(dst, src->len);
+	if (src->len) memcpy(dst->limbs, src->limbs, src->len * sizeof(bigint_limb_t));
+	dst->len = src->len;
+	dst->negative = src->negative;
+}
+
+void bigint_add(bigint_t *res, const bigint_t *a, const bigint_t *b) {
+	bigint_add_signed(res, a, b, b->negative);
+}
+
+void bigint_sub(bigint_t *res, const bigint_t *a, const bigint_t *b) {
+	bigint_add_signed(res, a, b, b->len ? !b->negative : 0);
+}
+
+void bigint_add_int(bigint_t *x, long long value) {
+	// the value becomes a bigint whose limbs live on the stack
+	bigint_limb_t limbs[64 / BIGINT_LIMB_BITS];
+	bigint_t addend = { limbs, 0, 64 / BIGINT_LIMB_BITS, 0 };
+	unsigned long long magnitude = value < 0 ? -(unsigned long long) value : (unsigned long long) value;
+	while (magnitude) {
+		limbs[addend.len++] = (bigint_limb_t) magnitude;
+		magnitude = BIGINT_LIMB_BITS == 64 ? 0 : magnitude >> (BIGINT_LIMB_BITS % 64);
+	}
+	addend.negative = value < 0;
+
+	bigint_add(x, x, &addend);
+}
+
+void bigint_mul(bigint_t *res, const bigint_t *a, const bigint_t *b) {
+	if (a->len == 0 || b->len == 0) {
+		res->len = 0;
+		res->negative = 0;
+		return;
+	}
+
+	int len = a->len + b->len;
+	int negative = a->negative != b->negative;
+
+	// a single limb factor scales the other operand in place
+	if (a->len == 1 || b->len == 1) {
+		const bigint_t *x = b->len == 1 ? a : b;
+		bigint_limb_t m = b->len == 1 ? b->limbs[0] : a->limbs[0];
+		int xn = x->len;
+
+		bigint_reserve(res, xn + 1);
+		bigint_limb_t carry = 0;
+		for (int i = 0; i < xn; i++) {
+			bigint_dlimb_t product = (bigint_dlimb_t) x->limbs[i] * m + carry;
+			res->limbs[i] = (bigint_limb_t) product;
+			carry = (bigint_limb_t) (product >> BIGINT_LIMB_BITS);
+		}
+		res->limbs[xn] = carry;
+		res->len = xn + 1;
+		res->negative = negative;
+		bigint_trim(res);
+		return;
+	}
+
+	// the product can go straight into res unless res is also an operand
+	if (res != a && res != b) {
+		bigint_reserve(res, len);
+		mag_mul(res->limbs, a->limbs, a->len, b->limbs, b->len);
+		res->len = len;
+		res->negative = negative;
+		bigint_trim(res);
+		return;
+	}
+
+	bigint_limb_t *limbs = bigint_alloc_limbs(len);
+	mag_mul(limbs, a->limbs, a->len, b->limbs, b->len);
+	bigint_install(res, limbs, len, len, negative);
+}
+
+int bigint_divmod(bigint_t *quot, bigint_t *rem, const bigint_t *a, const bigint_t *b) {
+	if (b->len == 0) return 0;
+
+	int an = a->len, bn = b->len;
+	int quot_negative = a->negative != b->negative, rem_negative = a->negative;
+
+	// both results are computed before either destination is touched,
+	// since they may be the operands
+	int qn = an >= bn ? an - bn + 1 : 1;
+	bigint_limb_t *q = bigint_alloc_limbs(qn);
+	bigint_limb_t *r = bigint_alloc_limbs(bn);
+
+	if (mag_cmp(a->limbs, an, b->limbs, bn) < 0) {
+		q[0] = 0;
+		memset(r, 0, bn * sizeof(bigint_limb_t));
+		if (an) memcpy(r, a->limbs, an * sizeof(bigint_limb_t));
+	}
+	else if (bn == 1) {
+		r[0] = mag_divmod_limb(q, a->limbs, an, b->limbs[0]);
+	}
+	else {
+		mag_divmod(q, r, a->limbs, an, b->limbs, bn);
+	}
+
+	if (quot) bigint_install(quot, q, qn, qn, quot_negative);
+	else mem_free(MEM_VM, q);
+	if (rem) bigint_install(rem, r, bn, bn, rem_negative);
+	else mem_free(MEM_VM, r);
+	return 1;
+}
+
+int bigint_compare(const bigint_t *a, const bigint_t *b) {
+	if (a->negative != b->negative) return a->negative ? -1 : 1;
+
+	int cmp = mag_cmp(a->limbs, a->len, b->limbs, b->len);
+	return a->negative ? -cmp : cmp;
+}
+
+char *bigint_str(const bigint_t *x) {
+	// every limb needs at most BIGINT_DECIMAL_DIGITS + 1 digits
+	int size = x->len * (BIGINT_DECIMAL_DIGITS + 1) + 3;
+	char *buffer = mem_malloc(MEM_VM, size);
+	if (buffer == NULL) {
+		perror("something went wrong with malloc in bigint_str");
+		exit(1);
+	}
+
+	char *end = buffer + size - 1;
+	char *start = x->len ? bigint_write(x->limbs, x->len, end, 0) : bigint_write_limb(0, end, 1);
+	if (x->negative) *--start = '-';
+
+	int len = (int) (end - start);
+	memmove(buffer, start, len);
+	buffer[len] = '\0';
+	return buffer;
+}
+
+// ========================================
+// helper definition
+// ========================================
+
+void bigint_reserve(bigint_t *x, int cap) {
+	if (cap <= x->cap) return;
+
+	x->cap = cap > (x->cap + 1) * 2 ? cap : (x->cap + 1) * 2;
+	x->limbs = mem_realloc(MEM_VM, x->limbs, x->cap * sizeof(bigint_limb_t));
+	if (x->limbs == NULL) {
+		perror("something went wrong with realloc in bigint_reserve");
+		exit(1);
+	}
+}
+
+void bigint_trim(bigint_t *x) {
+	x->len = mag_len(x->limbs, x->len);
+	if (x->len == 0) x->negative = 0;
+}
+
+void bigint_install(bigint_t *x, bigint_limb_t *limbs, int len, int cap, int negative) {
+	mem_free(MEM_VM, x->limbs);
+	x->limbs = limbs;
+	x->len = len;
+	x->cap = cap;
+	x->negative = negative;
+	bigint_trim(x);
+}
+
+void bigint_add_signed(bigint_t *res, const bigint_t *a, const bigint_t *b, int b_negative) {
+	// let x be the operand with the longer magnitude
+	const bigint_t *x = a, *y = b;
+	int x_negative = a->negative, y_negative = b_negative;
+	if (a->len < b->len) {
+		x = b;
+		y = a;
+		x_negative = b_negative;
+		y_negative = a->negative;
+	}
+	int xn = x->len, yn = y->len;
+
+	// reserving first keeps the limbs of x and y valid when one of them is res
+	bigint_reserve(res, xn + 1);
+
+	if (x_negative == y_negative) {
+		res->limbs[xn] = mag_add(res->limbs, x->limbs, xn, y->limbs, yn);
+		res->len = xn + 1;
+		res->negative = x_negative;
+	}
+	else if (mag_cmp(x->limbs, xn, y->limbs, yn) >= 0) {
+		mag_sub(res->limbs, x->limbs, xn, y->limbs, yn);
+		res->len = xn;
+		res->negative = x_negative;
+	}
+	else {
+		// same length, but y is bigger
+		mag_sub(res->limbs, y->limbs, yn, x->limbs, xn);
+		res->len = yn;
+		res->negative = y_negative;
+	}
+	bigint_trim(res);
+}
+
+bigint_limb_t *bigint_alloc_limbs(int len) {
+	bigint_limb_t *limbs = mem_malloc(MEM_VM, (len ? len : 1) * sizeof(bigint_limb_t));
+	if (limbs == NULL) {
+		perror("something went wrong with malloc in bigint_alloc_limbs");
+		exit(1);
+	}
+	return limbs;
+}
+
+int mag_len(const bigint_limb_t *a, int len) {
+	while (len > 0 && a[len - 1] == 0) len--;
+	return len;
+}
+
+int mag_cmp(const bigint_limb_t *a, int an, const bigint_limb_t *b, int bn) {
+	an = mag_len(a, an);
+	bn = mag_len(b, bn);
+	if (an != bn) return an < bn ? -1 : 1;
+
+	for (int i = an - 1; i >= 0; i--) {
+		if (a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
+	}
+	return 0;
+}
+
+bigint_limb_t mag_add(bigint_limb_t *r, const bigint_limb_t *a, int an, const bigint_limb_t *b, int bn) {
+	// r = a + b with an >= bn; r may be a or b, as every limb is read before it is written
+	bigint_limb_t carry = 0;
+	int i = 0;
+	for (; i < bn; i++) {
+		bigint_limb_t sum = a[i] + carry;
+		carry = sum < carry;
+		sum += b[i];
+		carry += sum < b[i];
+		r[i] = sum;
+	}
+	for (; i < an; i++) {
+		if (!carry) {
+			if (r != a) memcpy(r + i, a + i, (an - i) * sizeof(bigint_limb_t));
+			return 0;
+		}
+		r[i] = a[i] + 1;
+		carry = r[i] == 0;
+	}
+	return carry;
+}
+
+bigint_limb_t mag_sub(bigint_limb_t *r, const bigint_limb_t *a, int an, const bigint_limb_t *b, int bn) {
+	// r = a - b with an >= bn; r may be a or b like in mag_add
+	bigint_limb_t borrow = 0;
+	int i = 0;
+	for (; i < bn; i++) {
+		bigint_limb_t diff = a[i] - b[i];
+		bigint_limb_t next = a[i] < b[i];
+		next += diff < borrow;
+		r[i] = diff - borrow;
+		borrow = next;
+	}
+	for (; i < an; i++) {
+		if (!borrow) {
+			if (r != a) memcpy(r + i, a + i, (an - i) * sizeof(bigint_limb_t));
+			return 0;
+		}
+		borrow = a[i] == 0;
+		r[i] = a[i] - 1;
+	}
+	return borrow;
+}
+
+bigint_limb_t mag_mul_limb_add(bigint_limb_t *r, const bigint_limb_t *a, int len, bigint_limb_t m) {
+	// r += a * m over len limbs, returning the limb carried out
+	bigint_limb_t carry = 0;
+	for (int i = 0; i < len; i++) {
+		bigint_dlimb_t product = (bigint_dlimb_t) a[i] * m + r[i] + carry;
+		r[i] = (bigint_limb_t) product;
+		carry = (bigint_limb_t) (product >> BIGINT_LIMB_BITS);
+	}
+	return carry;
+}
+
+void mag_mul_basecase(bigint_limb_t *r, const bigint_limb_t *a, int an, const bigint_limb_t *b, int bn) {
+	memset(r, 0, (an + bn) * sizeof(bigint_limb_t));
+	for (int i = 0; i < bn; i++) {
+		r[i + an] = mag_mul_limb_add(r + i, a, an, b[i]);
+	}
+}
+
+void mag_mul(bigint_limb_t *r, const bigint_limb_t *a, int an, const bigint_limb_t *b, int bn) {
+	// r (an + bn limbs, not overlapping a or b) = a * b
+	if (an < bn) {
+		const bigint_limb_t *tmp = a;
+		a = b;
+		b = tmp;
+		int tmp_len = an;
+		an = bn;
+		bn = tmp_len;
+	}
+
+	if (bn < BIGINT_KARATSUBA_THRESHOLD) {
+		mag_mul_basecase(r, a, an, b, bn);
+		return;
+	}
+	if (an < 2 * bn) {
+		mag_karatsuba(r, a, an, b, bn);
+		return;
+	}
+
+	// a is much longer: multiply b by slices of a as long as b and add them up
+	bigint_limb_t *product = bigint_alloc_limbs(2 * bn);
+	memset(r, 0, (an + bn) * sizeof(bigint_limb_t));
+	for (int i = 0; i < an; i += bn) {
+		int len = an - i < bn ? an - i : bn;
+		mag_mul(product, a + i, len, b, bn);
+		mag_add(r + i, r + i, an + bn - i, product, len + bn);
+	}
+	mem_free(MEM_VM, product);
+}
+
+void mag_karatsuba(bigint_limb_t *r, const bigint_limb_t *a, int an, const bigint_limb_t *b, int bn) {
+	// a = a1 * B^k + a0 and b = b1 * B^k + b0 with bn <= an < 2 * bn, so b1 is never empty;
+	// a * b = z2 * B^2k + z1 * B^k + z0 where z1 = (a0 + a1)(b0 + b1) - z0 - z2
+	int k = an / 2;
+	const bigint_limb_t *a0 = a, *a1 = a + k, *b0 = b, *b1 = b + k;
+	int a1n = an - k, b1n = bn - k;
+
+	mag_mul(r, a0, k, b0, k);
+	mag_mul(r + 2 * k, a1, a1n, b1, b1n);
+
+	int san = a1n + 1;
+	int sbn = (b1n > k ? b1n : k) + 1;
+	int z1n = san + sbn;
+	bigint_limb_t *buffer = bigint_alloc_limbs(san + sbn + z1n);
+	bigint_limb_t *sa = buffer, *sb = buffer + san, *z1 = buffer + san + sbn;
+
+	sa[a1n] = mag_add(sa, a1, a1n, a0, k);
+	if (b1n >= k) sb[b1n] = mag_add(sb, b1, b1n, b0, k);
+	else sb[k] = mag_add(sb, b0, k, b1, b1n);
+
+	mag_mul(z1, sa, mag_len(sa, san), sb, mag_len(sb, sbn));
+	z1n = mag_len(z1, mag_len(sa, san) + mag_len(sb, sbn));
+	mag_sub(z1, z1, z1n, r, mag_len(r, 2 * k));
+	mag_sub(z1, z1, z1n, r + 2 * k, mag_len(r + 2 * k, an + bn - 2 * k));
+	z1n = mag_len(z1, z1n);
+
+	mag_add(r + k, r + k, an + bn - k, z1, z1n);
+	mem_free(MEM_VM, buffer);
+}
+
+bigint_limb_t mag_divmod_limb(bigint_limb_t *q, const bigint_limb_t *a, int len, bigint_limb_t d) {
+	// q = a / d, returning a % d; q may be a
+	bigint_limb_t rem = 0;
+	for (int i = len - 1; i >= 0; i--) {
+		bigint_dlimb_t cur = (bigint_dlimb_t) rem << BIGINT_LIMB_BITS | a[i];
+		q[i] = (bigint_limb_t) (cur / d);
+		rem = (bigint_limb_t) (cur % d);
+	}
+	return rem;
+}
+
+void mag_divmod(bigint_limb_t *q, bigint_limb_t *r, const bigint_limb_t *u, int un, const bigint_limb_t *v, int vn) {
+	// Knuth's algorithm D: q (un - vn + 1 limbs) = u / v and r (vn limbs) = u % v
+	// for un >= vn >= 2 and a top limb of v that is not zero
+	int shift = 0;
+	while (!((v[vn - 1] << shift) >> (BIGINT_LIMB_BITS - 1))) shift++;
+
+	// normalize so the top limb of the divisor has its high bit set
+	bigint_limb_t *buffer = bigint_alloc_limbs(vn + un + 1);
+	bigint_limb_t *nv = buffer, *nu = buffer + vn;
+	for (int i = vn - 1; i > 0; i--) {
+		nv[i] = v[i] << shift | (shift ? v[i - 1] >> (BIGINT_LIMB_BITS - shift) : 0);
+	}
+	nv[0] = v[0] << shift;
+	nu[un] = shift ? u[un - 1] >> (BIGINT_LIMB_BITS - shift) : 0;
+	for (int i = un - 1; i > 0; i--) {
+		nu[i] = u[i] << shift | (shift ? u[i - 1] >> (BIGINT_LIMB_BITS - shift) : 0);
+	}
+	nu[0] = u[0] << shift;
+
+	bigint_dlimb_t base = (bigint_dlimb_t) 1 << BIGINT_LIMB_BITS;
+	for (int j = un - vn; j >= 0; j--) {
+		// estimate the quotient limb from the top two limbs; it is at most 2 too big
+		bigint_dlimb_t num = (bigint_dlimb_t) nu[j + vn] << BIGINT_LIMB_BITS | nu[j + vn - 1];
+		bigint_dlimb_t qhat = num / nv[vn - 1];
+		bigint_dlimb_t rhat = num % nv[vn - 1];
+		while (qhat >= base || qhat * nv[vn - 2] > (rhat << BIGINT_LIMB_BITS | nu[j + vn - 2])) {
+			qhat--;
+			rhat += nv[vn - 1];
+			if (rhat >= base) break;
+		}
+
+		// nu[j..j + vn] -= qhat * nv
+		bigint_limb_t carry = 0, borrow = 0;
+		for (int i = 0; i < vn; i++) {
+			bigint_dlimb_t product = qhat * nv[i] + carry;
+			carry = (bigint_limb_t) (product >> BIGINT_LIMB_BITS);
+			bigint_limb_t low = (bigint_limb_t) product;
+			bigint_limb_t diff = nu[i + j] - low;
+			bigint_limb_t next = nu[i + j] < low;
+			next += diff < borrow;
+			nu[i + j] = diff - borrow;
+			borrow = next;
+		}
+		bigint_limb_t top = nu[j + vn];
+		bigint_limb_t diff = top - carry;
+		int negative = top < carry || diff < borrow;
+		nu[j + vn] = diff - borrow;
+
+		// the estimate was one too big: add the divisor back
+		if (negative) {
+			qhat--;
+			nu[j + vn] += mag_add(nu + j, nu + j, vn, nv, vn);
+		}
+		q[j] = (bigint_limb_t) qhat;
+	}
+
+	for (int i = 0; i < vn; i++) {
+		r[i] = nu[i] >> shift | (shift ? nu[i + 1] << (BIGINT_LIMB_BITS - shift) : 0);
+	}
+	mem_free(MEM_VM, buffer);
+}
+
+const bigint_t *bigint_power(int k) {
+	pthread_mutex_lock(&g_powers_lock);
+	while (g_powers_len <= k) {
+		bigint_t *power = &g_powers[g_powers_len];
+		bigint_init(power);
+		if (g_powers_len == 0) {
+			bigint_reserve(power, 1);
+			power->limbs[power->len++] = BIGINT_DECIMAL_BASE;
+		}
+		else {
+			bigint_mul(power, &g_powers[g_powers_len - 1], &g_powers[g_powers_len - 1]);
+		}
+		g_powers_len++;
+	}
+	pthread_mutex_unlock(&g_powers_lock);
+	return &g_powers[k];
+}
+
+char *bigint_write(const bigint_limb_t *x, int len, char *end, int pad) {
+	// write the digits of x right before end (exactly pad digits if pad is not 0)
+	// and return the first digit
+	len = mag_len(x, len);
+
+	if (len < BIGINT_PRINT_THRESHOLD) {
+		bigint_limb_t buffer[BIGINT_PRINT_THRESHOLD];
+		if (len) memcpy(buffer, x, len * sizeof(bigint_limb_t));
+
+		char *start = end;
+		do {
+			bigint_limb_t digits = mag_divmod_limb(buffer, buffer, len, BIGINT_DECIMAL_BASE);
+			len = mag_len(buffer, len);
+			start = bigint_write_limb(digits, start, len ? BIGINT_DECIMAL_DIGITS : 1);
+		} while (len);
+
+		while (end - start < pad) *--start = '0';
+		return start;
+	}
+
+	// split x by the biggest cached power with at most half its limbs:
+	// the low part is padded to the digits of the power
+	int k = 0;
+	while (bigint_power(k + 1)->len * 2 <= len + 1) k++;
+	const bigint_t *power = bigint_power(k);
+	int power_digits = BIGINT_DECIMAL_DIGITS << k;
+
+	bigint_limb_t *q = bigint_alloc_limbs(len - power->len + 1 + power->len);
+	bigint_limb_t *r = q + len - power->len + 1;
+	if (power->len == 1) r[0] = mag_divmod_limb(q, x, len, power->limbs[0]);
+	else mag_divmod(q, r, x, len, power->limbs, power->len);
+
+	char *start = bigint_write(r, power->len, end, power_digits);
+	start = bigint_write(q, len - power->len + 1, start, pad ? pad - power_digits : 0);
+	mem_free(MEM_VM, q);
+	return start;
+}
+
+char *bigint_write_limb(bigint_limb_t value, char *end, int pad) {
+	// write at least pad digits of a value below BIGINT_DECIMAL_BASE
+	char *start = end;
+	do {
+		*--start = (char) ('0' + value % 10);
+		value /= 10;
+	} while (value);
+
+	while (end - start < pad) *--start = '0';
+	return start;
+}
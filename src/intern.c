@@ -0,0 +1,172 @@
+#include "intern.h"
+#include "mem.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INTERN_CHUNK_SIZE (64 * 1024)
+
+// ========================================
+// helper declaration
+// ========================================
+
+typedef struct {
+	const char *str;
+	int len;
+	unsigned int hash;
+} intern_entry_t;
+
+typedef struct intern_chunk_t {
+	struct intern_chunk_t *next;
+	int used;
+	int cap;
+	char data[];
+} intern_chunk_t;
+
+static intern_entry_t *g_entries;
+static int g_entries_len, g_entries_cap;
+static int *g_table;		// symbol id + 1 per slot (0 means empty)
+static int g_table_cap;		// always a power of two
+static intern_chunk_t *g_chunks;
+
+unsigned int intern_hash(const char *str, int len);
+int intern_lookup(const char *str, int len, unsigned int hash, int *slot);
+void intern_grow_table();
+const char *intern_copy(const char *str, int len);
+
+// ========================================
+// intern.h - definition
+// ========================================
+
+void intern_init() {
+	g_entries = NULL;
+	g_entries_len = g_entries_cap = 0;
+	g_table = NULL;
+	g_table_cap = 0;
+	g_chunks = NULL;
+}
+
+void intern_free() {
+	while (g_chunks) {
+		intern_chunk_t *next = g_chunks->next;
+		mem_free(MEM_INTERN, g_chunks);
+		g_chunks = next;
+	}
+	mem_free(MEM_INTERN, g_entries);
+	mem_free(MEM_INTERN, g_table);
+	intern_init();
+}
+
+int intern(const char *str, int len) {
+	if (g_table_cap == 0 || (g_entries_len + 1) * 2 > g_table_cap) {
+		intern_grow_table();
+	}
+
+	unsigned int hash = intern_hash(str, len);
+	int slot;
+	int sym_id = intern_lookup(str, len, hash, &slot);
+	if (sym_id != -1) {
+		return sym_id;
+	}
+
+	if (g_entries_cap <= g_entries_len) {
+		g_entries_cap = (g_entries_cap + 1) * 2;
+		g_entries = mem_realloc(MEM_INTERN, g_entries, g_entries_cap * sizeof(intern_entry_t));
+		if (g_entries == NULL) {
+			perror("something went wrong with realloc in intern");
+			exit(1);
+		}
+	}
+
+	sym_id = g_entries_len++;
+	g_entries[sym_id] = (intern_entry_t) {.str = intern_copy(str, len), .len = len, .hash = hash};
+	g_table[slot] = sym_id + 1;
+	return sym_id;
+}
+
+int intern_find(const char *str, int len) {
+	if (g_table_cap == 0) return -1;
+
+	int slot;
+	return intern_lookup(str, len, intern_hash(str, len), &slot);
+}
+
+const char *intern_str(int sym_id) {
+	if (sym_id < 0 || sym_id >= g_entries_len) return NULL;
+	return g_entries[sym_id].str;
+}
+
+int intern_count() {
+	return g_entries_len;
+}
+
+// ========================================
+// helper definition
+// ========================================
+
+unsigned int intern_hash(const char *str, int len) {
+	// FNV-1a
+	unsigned int hash = 2166136261u;
+	for (int i = 0; i < len; i++) {
+		hash ^= (unsigned char) str[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+int intern_lookup(const char *str, int len, unsigned int hash, int *slot) {
+	int mask = g_table_cap - 1;
+	int i = hash & mask;
+	while (g_table[i]) {
+		intern_entry_t *entry = &g_entries[g_table[i] - 1];
+		if (entry->hash == hash && entry->len == len && memcmp(entry->str, str, len) == 0) {
+			*slot = i;
+			return g_table[i] - 1;
+		}
+		i = (i + 1) & mask;
+	}
+	*slot = i;
+	return -1;
+}
+
+void intern_grow_table() {
+	int cap = g_table_cap ? g_table_cap * 2 : 256;
+	int *table = mem_calloc(MEM_INTERN, cap, sizeof(int));
+	if (table == NULL) {
+		perror("something went wrong with calloc in intern_grow_table");
+		exit(1);
+	}
+
+	for (int sym_id = 0; sym_id < g_entries_len; sym_id++) {
+		int i = g_entries[sym_id].hash & (cap - 1);
+		while (table[i]) i = (i + 1) & (cap - 1);
+		table[i] = sym_id + 1;
+	}
+
+	mem_free(MEM_INTERN, g_table);
+	g_table = table;
+	g_table_cap = cap;
+}
+
+const char *intern_copy(const char *str, int len) {
+	// strings are never moved, so pointers into the pool stay valid
+	if (g_chunks == NULL || g_chunks->cap - g_chunks->used < len + 1) {
+		int cap = len + 1 > INTERN_CHUNK_SIZE ? len + 1 : INTERN_CHUNK_SIZE;
+		intern_chunk_t *chunk = mem_malloc(MEM_INTERN, sizeof(intern_chunk_t) + cap);
+		if (chunk == NULL) {
+			perror("something went wrong with malloc in intern_copy");
+			exit(1);
+		}
+		chunk->next = g_chunks;
+		chunk->used = 0;
+		chunk->cap = cap;
+		g_chunks = chunk;
+	}
+
+	char *res = g_chunks->data + g_chunks->used;
+	memcpy(res, str, len);
+	res[len] = 0;
+	g_chunks->used += len + 1;
+	return res;
+}
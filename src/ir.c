@@ -1,21 +1,110 @@
 #include "ir.h"
+#include "mem.h"
 #include "ast.h"
 #include "st.h"
+#include "bigint.h"
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 // ========================================
 // helper declaration
 // ========================================
 
-static ir_t *g_ir_list;
-static int g_ir_list_len;
-static int g_temp_len, g_label_len;
+#define IR_NAME_SIZE 1024
 
-void ir_init();
-ir_t *ir_list();
+static ir_builder_t *g_builder;
+static int g_temp_len, g_label_len;	// number of temporaries and generated labels
+static int g_vars_len, g_labels_len;	// number of variable ids and label ids
+static int g_i64_type_id, g_bigint_type_id;	// symbol table ids of the wide types (-1 if missing)
+static int g_big_consts_len;		// number of bigint constants
+
+// Widths of the integer types, ordered so the wider operand picks the opcode
+enum {
+	IR_WIDTH_INT,
+	IR_WIDTH_I64,
+	IR_WIDTH_BIG,
+};
+
+// variable id and label id of every symbol table id (-1 until first used)
+static int *g_st_vars, *g_st_labels, *g_st_procs;
+static int g_st_vars_cap, g_st_labels_cap, g_st_procs_cap;
+
+// Constants are deduplicated by value and width with open addressing
+typedef struct {
+	long long value;
+	int width;
+	int var_id;	// -1 means empty
+} ir_const_t;
+
+static ir_const_t *g_consts;
+static int g_consts_len, g_consts_cap;	// cap is always a power of two
+
+// OP_CONST* are collected here and put in front of the program by
+// ir_emit_end, so a constant first used in a loop is not dispatched on every
+// iteration
+static ir_t *g_prologue;
+static int g_prologue_len, g_prologue_cap;
+
+// Switch cases sorted by value for the dispatch
+typedef struct {
+	int value;
+	int label;	// label id of the case body
+} ir_case_t;
+
+#define IR_JUMP_TABLE_MIN 4	// fewer cases are compared one by one
+#define IR_JUMP_TABLE_DENSITY 2	// a jump table may have at most this many entries per case
+
+// A procedure is inlined when its body has at most IR_INLINE_MAX instructions
+// (or it has a single call) and it calls no other procedure
+#define IR_INLINE_MAX 16
+#define IR_INLINE_PASSES 4
+
+typedef struct {
+	int start;	// index of the OP_PROC (-1 if not inlined)
+	int len;	// instructions of the body without the final OP_RET
+	int calls;	// number of OP_CALL to the procedure
+} ir_proc_t;
+
+// Expressions and nested statements are lowered with an explicit stack,
+// so nesting depth is only limited by memory.
+typedef struct {
+	ast_t *ast;
+	int step;		// number of children lowered so far
+	int ids[3];		// variable ids of the lowered children
+	int res_id;		// variable id of the result
+	int true_label;		// loops: start of the body
+	int end_label;		// loops: the condition at the bottom
+	int done;		// compound statement is completely lowered
+} ir_frame_t;
+
+static ir_frame_t *g_frames;
+static int g_frames_len, g_frames_cap;
+
+// expression whose value is discarded (a statement of its own), so ++x and
+// x op= y in it need no copy of the result
+static ast_t *g_discarded;
+
+void ir_init(ir_builder_t *builder);
+void ir_free();
+void ir_push_frame(ast_t *ast);
 void ir_emit(int op, int res_id, int arg1_id, int arg2_id);
+void ir_emit_const(int op, int res_id, int arg1_id, int arg2_id);
+void ir_emit_end();
+void ir_set_pos(ast_t *ast);
+void ir_builder_mark(ir_builder_t *builder, pos_t start, pos_t end);
+void ir_set_name(ir_name_t **names, int *cap, int index, int kind, int id);
+int *ir_st_map(int **map, int *cap, int st_id);
+void ir_grow_consts();
+unsigned int ir_const_slot(long long value, int width);
+
+static ir_builder_t *g_print_builder;
+static FILE *g_print_fd;	// where print_ir_op writes
+
+void print_ir_op(ir_t ir);
+void print_ir_var_name(int var_id, char *buffer);
+void print_ir_label_name(int label_id, char *buffer);
 
 void print_ir_print1(const char *op_str, int res_id, const char *res_name);
 void print_ir_print2(const char *op_str, int res_id, const char *res_name, int arg1_id, const char *arg1_name);
@@ -25,210 +114,768 @@ void print_ir_op_binary(ir_t ir, const char *op_str);
 void print_ir_op_unary(ir_t ir, const char *op_str);
 void print_ir_op_label(ir_t ir);
 void print_ir_op_copy(ir_t ir);
+void print_ir_op_const(ir_t ir);
+void print_ir_op_const_wide(ir_t ir, const char *op_str);
+void print_ir_op_inc(ir_t ir, const char *op_str);
+void print_ir_op_add_imm(ir_t ir, const char *op_str);
 void print_ir_op_jmp_cond(ir_t ir, const char *op_str);
 void print_ir_op_jmp(ir_t ir);
-void print_ir_op_print(ir_t ir);
+void print_ir_op_jmp_table(ir_t ir);
+void print_ir_op_proc(ir_t ir);
+void print_ir_op_call(ir_t ir);
+void print_ir_op_print(ir_t ir, const char *op_str);
 
 void ir_rule_prog(ast_t *ast);
 void ir_rule_stmt(ast_t *ast);
 void ir_rule_label_stmt(ast_t *ast);
 void ir_rule_var_stmt(ast_t *ast);
-void ir_rule_if_stmt(ast_t *ast);
+void ir_rule_compound_stmt(ast_t *ast);
 void ir_rule_goto_stmt(ast_t *ast);
+void ir_rule_proc_stmt(ast_t *ast);
+void ir_rule_call_stmt(ast_t *ast);
 void ir_rule_print_stmt(ast_t *ast);
+ast_t *ir_rule_if_stmt_step(ir_frame_t *frame);
+ast_t *ir_rule_while_stmt_step(ir_frame_t *frame);
+ast_t *ir_rule_for_stmt_step(ir_frame_t *frame);
+ast_t *ir_rule_switch_stmt_step(ir_frame_t *frame);
+void ir_rule_switch_dispatch(ast_t *ast, int expr_id, int first_label, int end_label);
+void ir_rule_switch_search(ir_case_t *cases, int len, int expr_id, int cmp_id, int default_label);
+int ir_case_compare(const void *a, const void *b);
+ast_t *ir_rule_block_stmt_step(ir_frame_t *frame);
 int ir_rule_expr(ast_t *ast);
+void ir_rule_effect(ast_t *ast);
+int ir_snapshot(ast_t *ast, int var_id, int width);
+ast_t *ir_rule_expr_step(ir_frame_t *frame);
 int ir_rule_literal(ast_t *ast);
+int ir_rule_add_imm(ast_t *ast, int *res_id);
+int ir_literal_value(ast_t *ast);
+long long ir_literal_value64(ast_t *ast);
+int ir_compound_op(int token_type);
+int ir_binary_op(int token_type);
+int ir_width_op(int op, int width);
+int ir_width(ast_t *ast);
+int ir_widen(ast_t *ast, int id, int width);
+int ir_truth(ast_t *ast, int id);
+int ir_rule_cond(ast_t *ast);
 int ir_rule_identifier(ast_t *ast);
-int ir_rule_unary(ast_t *ast);
-int ir_rule_binary(ast_t *ast);
-int ir_rule_ternary(ast_t *ast);
+ast_t *ir_rule_index(ir_frame_t *frame);
+ast_t *ir_rule_index_update(ir_frame_t *frame);
+ast_t *ir_rule_builtin(ir_frame_t *frame);
+int ir_rule_unary(ast_t *ast, int expr_id);
+int ir_rule_binary(ast_t *ast, int left_id, int right_id);
+ast_t *ir_rule_ternary(ir_frame_t *frame);
 
+int ir_generate_var(int kind, int id);
+int ir_generate_array(int st_var_id, int len);
+int ir_generate_label_id(int kind, int id);
 int ir_generate_label();
 int ir_generate_temp();
-int ir_generate_literal(const char *literal);
+int ir_generate_width_temp(int width);
+int ir_generate_const(int value);
+int ir_generate_const_width(long long value, int width);
+int ir_generate_const_big(ast_t *literal);
+int ir_var_id(int st_var_id);
+int ir_label_id(int st_label_id);
+int ir_proc_label_id(int st_proc_id);
+
+int ir_inline_pass(ir_builder_t *builder);
+void ir_inline_emit(ir_builder_t *out, ir_t ir, ir_pos_t pos);
+int ir_inline_new_label(ir_builder_t *builder, int *labels_len);
 
 // ========================================
 // ir.h - definition
 // ========================================
 
-ir_t *generate_ir(ast_t *ast) {
-	ir_init();
+void ir_builder_init(ir_builder_t *builder) {
+	builder->list = NULL;
+	builder->positions = NULL;
+	builder->positions_len = builder->positions_cap = 0;
+	builder->len = builder->cap = 0;
+	builder->debug = 0;
+	builder->var_names = builder->label_names = NULL;
+	builder->var_names_cap = builder->label_names_cap = 0;
+}
+
+void ir_builder_reserve(ir_builder_t *builder, int count) {
+	if (builder->len + count <= builder->cap) {
+		return;
+	}
+
+	int cap = builder->cap;
+	while (cap < builder->len + count) {
+		cap = (cap + 1) * 2;
+	}
+	builder->list = mem_realloc(MEM_IR, builder->list, cap * sizeof(ir_t));
+	if (builder->list == NULL) {
+		perror("something went wrong while realloc in ir_builder_reserve");
+		exit(1);
+	}
+	builder->cap = cap;
+}
+
+void ir_builder_reset(ir_builder_t *builder) {
+	builder->len = 0;
+	builder->positions_len = 0;
+}
+
+void ir_builder_free(ir_builder_t *builder) {
+	mem_free(MEM_IR, builder->list);
+	mem_free(MEM_IR, builder->positions);
+	mem_free(MEM_IR, builder->var_names);
+	mem_free(MEM_IR, builder->label_names);
+	ir_builder_init(builder);
+}
+
+ir_pos_t ir_builder_pos(ir_builder_t *builder, int index) {
+	// last entry starting at or before the instruction
+	int low = 0, high = builder->positions_len;
+	while (low < high) {
+		int mid = (low + high) / 2;
+		if (builder->positions[mid].index <= index) low = mid + 1;
+		else high = mid;
+	}
+	if (low == 0) return (ir_pos_t) {.index = 0};
+	return builder->positions[low - 1];
+}
+
+ir_t *generate_ir(ir_builder_t *builder, ast_t *ast) {
+	ir_init(builder);
 
 	ir_rule_prog(ast);
+	ir_free();
 
-	return ir_list();
+	return builder->list;
 }
 
-void print_ir(ir_t *ir_list) {
-	ir_t *ir_ptr = ir_list;
+void ir_begin(ir_builder_t *builder) {
+	ir_init(builder);
+}
+
+void ir_stmt(ast_t *stmt) {
+	ir_rule_stmt(stmt);
+}
+
+ir_t *ir_end() {
+	ir_emit_end();
+	ir_free();
+
+	return g_builder->list;
+}
+
+ir_t *ir_inline(ir_builder_t *builder) {
+	for (int i = 0; i < IR_INLINE_PASSES && ir_inline_pass(builder) > 0; i++);
+	return builder->list;
+}
+
+void print_ir(ir_builder_t *builder) {
+	g_print_builder = builder;
+	g_print_fd = stdout;
+	ir_t *ir_ptr = builder->list;
 	do {
-		switch (ir_ptr->op) {
-		case OP_ADD:
-			print_ir_op_binary(*ir_ptr, "OP_ADD");
-			break;
-		case OP_SUB:
-			print_ir_op_binary(*ir_ptr, "OP_SUB");
-			break;
-		case OP_MUL:
-			print_ir_op_binary(*ir_ptr, "OP_MUL");
-			break;
-		case OP_DIV:
-			print_ir_op_binary(*ir_ptr, "OP_DIV");
-			break;
-		case OP_MOD:
-			print_ir_op_binary(*ir_ptr, "OP_MOD");
-			break;
-		case OP_LSHIFT:
-			print_ir_op_binary(*ir_ptr, "OP_LSHIFT");
-			break;
-		case OP_RSHIFT:
-			print_ir_op_binary(*ir_ptr, "OP_RSHIFT");
-			break;
-		case OP_EQUAL_EQUAL:
-			print_ir_op_binary(*ir_ptr, "OP_EQUAL_EQUAL");
-			break;
-		case OP_NOT_EQUAL:
-			print_ir_op_binary(*ir_ptr, "OP_NOT_EQUAL");
-			break;
-		case OP_LESSER:
-			print_ir_op_binary(*ir_ptr, "OP_LESSER");
-			break;
-		case OP_LESSER_EQUAL:
-			print_ir_op_binary(*ir_ptr, "OP_LESSER_EQUAL");
-			break;
-		case OP_GREATER:
-			print_ir_op_binary(*ir_ptr, "OP_GREATER");
-			break;
-		case OP_GREATER_EQUAL:
-			print_ir_op_binary(*ir_ptr, "OP_GREATER_EQUAL");
-			break;
-		case OP_BITWISE_AND:
-			print_ir_op_binary(*ir_ptr, "OP_BITWISE_AND");
-			break;
-		case OP_BITWISE_OR:
-			print_ir_op_binary(*ir_ptr, "OP_BITWISE_OR");
-			break;
-		case OP_BITWISE_XOR:
-			print_ir_op_binary(*ir_ptr, "OP_BITWISE_XOR");
-			break;
-		case OP_LOGICAL_AND:
-			print_ir_op_binary(*ir_ptr, "OP_LOGICAL_AND");
-			break;
-		case OP_LOGICAL_OR:
-			print_ir_op_binary(*ir_ptr, "OP_LOGICAL_OR");
-			break;
-		case OP_LOGICAL_NOT:
-			print_ir_op_unary(*ir_ptr, "OP_LOGICAL_NOT");
-			break;
-		case OP_BITWISE_NOT:
-			print_ir_op_unary(*ir_ptr, "OP_BITWISE_NOT");
-			break;
-		case OP_LABEL:
-			print_ir_op_label(*ir_ptr);
-			break;
-		case OP_COPY:
-			print_ir_op_copy(*ir_ptr);
-			break;
-		case OP_JMP_TRUE:
-			print_ir_op_jmp_cond(*ir_ptr, "OP_JMP_TRUE");
-			break;
-		case OP_JMP_FALSE:
-			print_ir_op_jmp_cond(*ir_ptr, "OP_JMP_FALSE");
-			break;
-		case OP_JMP:
-			print_ir_op_jmp(*ir_ptr);
-			break;
-		case OP_PRINT:
-			print_ir_op_print(*ir_ptr);
-			break;
-		case OP_END:
-			printf("OP_END\n");
-			break;
-		default:
-			fprintf(stderr, "T_T no idea man; what you sending\n");
-			exit(1);
-		}
+		print_ir_op(*ir_ptr);
 		ir_ptr++;
 	} while (ir_ptr->op != OP_END);
 	printf("OP_END\n");
 }
 
+const char *ir_label_name(ir_builder_t *builder, int label_id, int kind) {
+	if (!builder->debug || label_id >= builder->label_names_cap) return NULL;
+
+	ir_name_t name = builder->label_names[label_id];
+	if (name.kind != kind) return NULL;
+	if (kind == IR_NAME_PROC) return st_check_proc_by_id(name.id).name;
+	return st_check_label_by_id(name.id).name;
+}
+
+void print_ir_instruction(ir_builder_t *builder, int index, FILE *fd) {
+	g_print_builder = builder;
+	g_print_fd = fd;
+	print_ir_op(builder->list[index]);
+}
+
 // ========================================
 // helper definition
 // ========================================
 
-void ir_init() {
-	g_ir_list = NULL;
-	g_ir_list_len = 0;
+void ir_init(ir_builder_t *builder) {
+	g_builder = builder;
+	ir_builder_reset(builder);
 	g_temp_len = g_label_len = 0;
+	g_vars_len = g_labels_len = 0;
+	g_st_vars = g_st_labels = g_st_procs = NULL;
+	g_st_vars_cap = g_st_labels_cap = g_st_procs_cap = 0;
+	g_consts = NULL;
+	g_consts_len = g_consts_cap = 0;
+	g_prologue = NULL;
+	g_prologue_len = g_prologue_cap = 0;
+	g_frames = NULL;
+	g_frames_len = g_frames_cap = 0;
+	g_i64_type_id = st_check_type("i64").id;
+	g_bigint_type_id = st_check_type("bigint").id;
+	g_big_consts_len = 0;
 }
 
-ir_t *ir_list() {
-	return g_ir_list;
+void ir_free() {
+	mem_free(MEM_IR, g_st_vars);
+	mem_free(MEM_IR, g_st_labels);
+	mem_free(MEM_IR, g_st_procs);
+	g_st_vars = g_st_labels = g_st_procs = NULL;
+	g_st_vars_cap = g_st_labels_cap = g_st_procs_cap = 0;
+	mem_free(MEM_IR, g_consts);
+	g_consts = NULL;
+	g_consts_len = g_consts_cap = 0;
+	mem_free(MEM_IR, g_prologue);
+	g_prologue = NULL;
+	g_prologue_len = g_prologue_cap = 0;
+	mem_free(MEM_IR, g_frames);
+	g_frames = NULL;
+	g_frames_len = g_frames_cap = 0;
+}
+
+void ir_push_frame(ast_t *ast) {
+	if (g_frames_cap <= g_frames_len) {
+		g_frames_cap = (g_frames_cap + 1) * 2;
+		g_frames = mem_realloc(MEM_IR, g_frames, g_frames_cap * sizeof(ir_frame_t));
+		if (g_frames == NULL) {
+			perror("something went wrong while realloc in ir_push_frame");
+			exit(1);
+		}
+	}
+	g_frames[g_frames_len++] = (ir_frame_t) {.ast = ast, .step = 0};
 }
 
 void ir_emit(int op, int res_id, int arg1_id, int arg2_id) {
-	g_ir_list_len++;
-	g_ir_list = realloc(g_ir_list, g_ir_list_len * sizeof(ir_t));
-	if (g_ir_list == NULL) {
-		perror("something went wrong while realloc in ir_emit");
+	ir_builder_reserve(g_builder, 1);
+	g_builder->list[g_builder->len++] = (ir_t) {.op=op, .res_id=res_id, .arg1_id=arg1_id, .arg2_id=arg2_id};
+}
+
+void ir_emit_const(int op, int res_id, int arg1_id, int arg2_id) {
+	if (g_prologue_cap <= g_prologue_len) {
+		g_prologue_cap = (g_prologue_cap + 1) * 2;
+		g_prologue = mem_realloc(MEM_IR, g_prologue, g_prologue_cap * sizeof(ir_t));
+		if (g_prologue == NULL) {
+			perror("something went wrong while realloc in ir_emit_const");
+			exit(1);
+		}
+	}
+	g_prologue[g_prologue_len++] = (ir_t) {.op=op, .res_id=res_id, .arg1_id=arg1_id, .arg2_id=arg2_id};
+}
+
+void ir_emit_end() {
+	ir_emit(OP_END, g_vars_len, g_labels_len, 0);
+
+	// the constants go in front; they have no source position
+	int len = g_prologue_len;
+	ir_builder_reserve(g_builder, len);
+	memmove(g_builder->list + len, g_builder->list, g_builder->len * sizeof(ir_t));
+	memcpy(g_builder->list, g_prologue, len * sizeof(ir_t));
+	g_builder->len += len;
+	for (int i = 0; i < g_builder->positions_len; i++) {
+		g_builder->positions[i].index += len;
+	}
+}
+
+void ir_set_pos(ast_t *ast) {
+	ir_builder_mark(g_builder, ast->start, ast->end);
+}
+
+void ir_builder_mark(ir_builder_t *builder, pos_t start, pos_t end) {
+	// the instructions emitted from now on come from [start, end)
+	ir_pos_t *positions = builder->positions;
+	int len = builder->positions_len;
+	if (len > 0 && positions[len - 1].start.index == start.index && positions[len - 1].end.index == end.index) {
+		return;
+	}
+
+	// an entry no instruction was emitted under is replaced, and dropped when
+	// the span goes back to the one before it
+	if (len > 0 && positions[len - 1].index == builder->len) {
+		if (len > 1 && positions[len - 2].start.index == start.index && positions[len - 2].end.index == end.index) {
+			builder->positions_len--;
+			return;
+		}
+		positions[len - 1].start = start;
+		positions[len - 1].end = end;
+		return;
+	}
+
+	if (builder->positions_cap <= len) {
+		builder->positions_cap = (builder->positions_cap + 1) * 2;
+		builder->positions = mem_realloc(MEM_IR, builder->positions, builder->positions_cap * sizeof(ir_pos_t));
+		if (builder->positions == NULL) {
+			perror("something went wrong while realloc in ir_builder_mark");
+			exit(1);
+		}
+	}
+	builder->positions[builder->positions_len++] = (ir_pos_t) {.index = builder->len, .start = start, .end = end};
+}
+
+void ir_set_name(ir_name_t **names, int *cap, int index, int kind, int id) {
+	if (index >= *cap) {
+		*cap = (index + 1) * 2;
+		*names = mem_realloc(MEM_IR, *names, *cap * sizeof(ir_name_t));
+		if (*names == NULL) {
+			perror("something went wrong while realloc in ir_set_name");
+			exit(1);
+		}
+	}
+	(*names)[index] = (ir_name_t) {.kind = kind, .id = id};
+}
+
+int *ir_st_map(int **map, int *cap, int st_id) {
+	if (st_id >= *cap) {
+		int old_cap = *cap;
+		*cap = (st_id + 1) * 2;
+		*map = mem_realloc(MEM_IR, *map, *cap * sizeof(int));
+		if (*map == NULL) {
+			perror("something went wrong while realloc in ir_st_map");
+			exit(1);
+		}
+		for (int i = old_cap; i < *cap; i++) (*map)[i] = -1;
+	}
+	return &(*map)[st_id];
+}
+
+void ir_grow_consts() {
+	ir_const_t *old = g_consts;
+	int old_cap = g_consts_cap;
+
+	g_consts_cap = old_cap ? old_cap * 2 : 64;
+	g_consts = mem_malloc(MEM_IR, g_consts_cap * sizeof(ir_const_t));
+	if (g_consts == NULL) {
+		perror("something went wrong while malloc in ir_grow_consts");
+		exit(1);
+	}
+	for (int i = 0; i < g_consts_cap; i++) g_consts[i].var_id = -1;
+
+	for (int i = 0; i < old_cap; i++) {
+		if (old[i].var_id == -1) continue;
+		unsigned int slot = ir_const_slot(old[i].value, old[i].width);
+		while (g_consts[slot & (g_consts_cap - 1)].var_id != -1) slot++;
+		g_consts[slot & (g_consts_cap - 1)] = old[i];
+	}
+	mem_free(MEM_IR, old);
+}
+
+unsigned int ir_const_slot(long long value, int width) {
+	return (unsigned int) (value ^ (value >> 32) ^ width) * 2654435761u;
+}
+
+void print_ir_op(ir_t ir) {
+	switch (ir.op) {
+	case OP_ADD:
+		print_ir_op_binary(ir, "OP_ADD");
+		break;
+	case OP_SUB:
+		print_ir_op_binary(ir, "OP_SUB");
+		break;
+	case OP_MUL:
+		print_ir_op_binary(ir, "OP_MUL");
+		break;
+	case OP_DIV:
+		print_ir_op_binary(ir, "OP_DIV");
+		break;
+	case OP_MOD:
+		print_ir_op_binary(ir, "OP_MOD");
+		break;
+	case OP_LSHIFT:
+		print_ir_op_binary(ir, "OP_LSHIFT");
+		break;
+	case OP_RSHIFT:
+		print_ir_op_binary(ir, "OP_RSHIFT");
+		break;
+	case OP_EQUAL_EQUAL:
+		print_ir_op_binary(ir, "OP_EQUAL_EQUAL");
+		break;
+	case OP_NOT_EQUAL:
+		print_ir_op_binary(ir, "OP_NOT_EQUAL");
+		break;
+	case OP_LESSER:
+		print_ir_op_binary(ir, "OP_LESSER");
+		break;
+	case OP_LESSER_EQUAL:
+		print_ir_op_binary(ir, "OP_LESSER_EQUAL");
+		break;
+	case OP_GREATER:
+		print_ir_op_binary(ir, "OP_GREATER");
+		break;
+	case OP_GREATER_EQUAL:
+		print_ir_op_binary(ir, "OP_GREATER_EQUAL");
+		break;
+	case OP_BITWISE_AND:
+		print_ir_op_binary(ir, "OP_BITWISE_AND");
+		break;
+	case OP_BITWISE_OR:
+		print_ir_op_binary(ir, "OP_BITWISE_OR");
+		break;
+	case OP_BITWISE_XOR:
+		print_ir_op_binary(ir, "OP_BITWISE_XOR");
+		break;
+	case OP_LOGICAL_AND:
+		print_ir_op_binary(ir, "OP_LOGICAL_AND");
+		break;
+	case OP_LOGICAL_OR:
+		print_ir_op_binary(ir, "OP_LOGICAL_OR");
+		break;
+	case OP_LOGICAL_NOT:
+		print_ir_op_unary(ir, "OP_LOGICAL_NOT");
+		break;
+	case OP_BITWISE_NOT:
+		print_ir_op_unary(ir, "OP_BITWISE_NOT");
+		break;
+	case OP_ADD_I64:
+		print_ir_op_binary(ir, "OP_ADD_I64");
+		break;
+	case OP_SUB_I64:
+		print_ir_op_binary(ir, "OP_SUB_I64");
+		break;
+	case OP_MUL_I64:
+		print_ir_op_binary(ir, "OP_MUL_I64");
+		break;
+	case OP_DIV_I64:
+		print_ir_op_binary(ir, "OP_DIV_I64");
+		break;
+	case OP_MOD_I64:
+		print_ir_op_binary(ir, "OP_MOD_I64");
+		break;
+	case OP_LSHIFT_I64:
+		print_ir_op_binary(ir, "OP_LSHIFT_I64");
+		break;
+	case OP_RSHIFT_I64:
+		print_ir_op_binary(ir, "OP_RSHIFT_I64");
+		break;
+	case OP_EQUAL_EQUAL_I64:
+		print_ir_op_binary(ir, "OP_EQUAL_EQUAL_I64");
+		break;
+	case OP_NOT_EQUAL_I64:
+		print_ir_op_binary(ir, "OP_NOT_EQUAL_I64");
+		break;
+	case OP_LESSER_I64:
+		print_ir_op_binary(ir, "OP_LESSER_I64");
+		break;
+	case OP_LESSER_EQUAL_I64:
+		print_ir_op_binary(ir, "OP_LESSER_EQUAL_I64");
+		break;
+	case OP_GREATER_I64:
+		print_ir_op_binary(ir, "OP_GREATER_I64");
+		break;
+	case OP_GREATER_EQUAL_I64:
+		print_ir_op_binary(ir, "OP_GREATER_EQUAL_I64");
+		break;
+	case OP_BITWISE_AND_I64:
+		print_ir_op_binary(ir, "OP_BITWISE_AND_I64");
+		break;
+	case OP_BITWISE_OR_I64:
+		print_ir_op_binary(ir, "OP_BITWISE_OR_I64");
+		break;
+	case OP_BITWISE_XOR_I64:
+		print_ir_op_binary(ir, "OP_BITWISE_XOR_I64");
+		break;
+	case OP_BITWISE_NOT_I64:
+		print_ir_op_unary(ir, "OP_BITWISE_NOT_I64");
+		break;
+	case OP_ADD_BIG:
+		print_ir_op_binary(ir, "OP_ADD_BIG");
+		break;
+	case OP_SUB_BIG:
+		print_ir_op_binary(ir, "OP_SUB_BIG");
+		break;
+	case OP_MUL_BIG:
+		print_ir_op_binary(ir, "OP_MUL_BIG");
+		break;
+	case OP_DIV_BIG:
+		print_ir_op_binary(ir, "OP_DIV_BIG");
+		break;
+	case OP_MOD_BIG:
+		print_ir_op_binary(ir, "OP_MOD_BIG");
+		break;
+	case OP_EQUAL_EQUAL_BIG:
+		print_ir_op_binary(ir, "OP_EQUAL_EQUAL_BIG");
+		break;
+	case OP_NOT_EQUAL_BIG:
+		print_ir_op_binary(ir, "OP_NOT_EQUAL_BIG");
+		break;
+	case OP_LESSER_BIG:
+		print_ir_op_binary(ir, "OP_LESSER_BIG");
+		break;
+	case OP_LESSER_EQUAL_BIG:
+		print_ir_op_binary(ir, "OP_LESSER_EQUAL_BIG");
+		break;
+	case OP_GREATER_BIG:
+		print_ir_op_binary(ir, "OP_GREATER_BIG");
+		break;
+	case OP_GREATER_EQUAL_BIG:
+		print_ir_op_binary(ir, "OP_GREATER_EQUAL_BIG");
+		break;
+	case OP_LABEL:
+		print_ir_op_label(ir);
+		break;
+	case OP_COPY:
+		print_ir_op_copy(ir);
+		break;
+	case OP_CONST:
+		print_ir_op_const(ir);
+		break;
+	case OP_INC:
+		print_ir_op_inc(ir, "OP_INC");
+		break;
+	case OP_DEC:
+		print_ir_op_inc(ir, "OP_DEC");
+		break;
+	case OP_ADD_IMM:
+		print_ir_op_add_imm(ir, "OP_ADD_IMM");
+		break;
+	case OP_COPY_I64:
+		print_ir_op_unary(ir, "OP_COPY_I64");
+		break;
+	case OP_CONST_I64:
+		print_ir_op_const_wide(ir, "OP_CONST_I64");
+		break;
+	case OP_INC_I64:
+		print_ir_op_inc(ir, "OP_INC_I64");
+		break;
+	case OP_DEC_I64:
+		print_ir_op_inc(ir, "OP_DEC_I64");
+		break;
+	case OP_ADD_IMM_I64:
+		print_ir_op_add_imm(ir, "OP_ADD_IMM_I64");
+		break;
+	case OP_WIDEN:
+		print_ir_op_unary(ir, "OP_WIDEN");
+		break;
+	case OP_COPY_BIG:
+		print_ir_op_unary(ir, "OP_COPY_BIG");
+		break;
+	case OP_CONST_BIG:
+		print_ir_op_const_wide(ir, "OP_CONST_BIG");
+		break;
+	case OP_INC_BIG:
+		print_ir_op_inc(ir, "OP_INC_BIG");
+		break;
+	case OP_DEC_BIG:
+		print_ir_op_inc(ir, "OP_DEC_BIG");
+		break;
+	case OP_ADD_IMM_BIG:
+		print_ir_op_add_imm(ir, "OP_ADD_IMM_BIG");
+		break;
+	case OP_WIDEN_BIG:
+		print_ir_op_unary(ir, "OP_WIDEN_BIG");
+		break;
+	case OP_WIDEN_I64_BIG:
+		print_ir_op_unary(ir, "OP_WIDEN_I64_BIG");
+		break;
+	case OP_LOAD:
+		print_ir_op_binary(ir, "OP_LOAD");
+		break;
+	case OP_STORE:
+		print_ir_op_binary(ir, "OP_STORE");
+		break;
+	case OP_FILL:
+		print_ir_op_unary(ir, "OP_FILL");
+		break;
+	case OP_ARRAY_COPY:
+		print_ir_op_unary(ir, "OP_ARRAY_COPY");
+		break;
+	case OP_SUM:
+		print_ir_op_unary(ir, "OP_SUM");
+		break;
+	case OP_MIN:
+		print_ir_op_unary(ir, "OP_MIN");
+		break;
+	case OP_MAX:
+		print_ir_op_unary(ir, "OP_MAX");
+		break;
+	case OP_JMP_TRUE:
+		print_ir_op_jmp_cond(ir, "OP_JMP_TRUE");
+		break;
+	case OP_JMP_FALSE:
+		print_ir_op_jmp_cond(ir, "OP_JMP_FALSE");
+		break;
+	case OP_JMP:
+		print_ir_op_jmp(ir);
+		break;
+	case OP_JMP_TABLE:
+		print_ir_op_jmp_table(ir);
+		break;
+	case OP_PROC:
+		print_ir_op_proc(ir);
+		break;
+	case OP_CALL:
+		print_ir_op_call(ir);
+		break;
+	case OP_RET:
+		fprintf(g_print_fd, "OP_RET\n");
+		break;
+	case OP_PRINT:
+		print_ir_op_print(ir, "OP_PRINT");
+		break;
+	case OP_PRINT_I64:
+		print_ir_op_print(ir, "OP_PRINT_I64");
+		break;
+	case OP_PRINT_BIG:
+		print_ir_op_print(ir, "OP_PRINT_BIG");
+		break;
+	case OP_END:
+		fprintf(g_print_fd, "OP_END\n");
+		break;
+	default:
+		fprintf(stderr, "T_T no idea man; what you sending\n");
 		exit(1);
 	}
-	g_ir_list[g_ir_list_len-1] = (ir_t) {.op=op, .res_id=res_id, .arg1_id=arg1_id, .arg2_id=arg2_id};
+}
+
+void print_ir_var_name(int var_id, char *buffer) {
+	buffer[0] = '\0';
+	if (!g_print_builder->debug || var_id < 0 || var_id >= g_print_builder->var_names_cap) return;
+
+	ir_name_t name = g_print_builder->var_names[var_id];
+	switch (name.kind) {
+	case IR_NAME_VAR:
+		snprintf(buffer, IR_NAME_SIZE, "%s", st_check_var_by_id(name.id).name);
+		break;
+	case IR_NAME_TEMP:
+		snprintf(buffer, IR_NAME_SIZE, ".TEMP_%d", name.id);
+		break;
+	case IR_NAME_CONST:
+		snprintf(buffer, IR_NAME_SIZE, ".LITERAL_%d", name.id);
+		break;
+	case IR_NAME_CONST_I64: {
+		long long high = g_print_builder->var_names[var_id + 1].id;
+		snprintf(buffer, IR_NAME_SIZE, ".LITERAL_%lld", (long long) ((unsigned long long) high << 32 | (unsigned int) name.id));
+		break;
+	}
+	case IR_NAME_CONST_BIG:
+		snprintf(buffer, IR_NAME_SIZE, ".BIG_LITERAL_%d", name.id);
+		break;
+	case IR_NAME_ELEMENT:
+		snprintf(buffer, IR_NAME_SIZE, ".ELEMENT_%d", name.id);
+		break;
+	}
+}
+
+void print_ir_label_name(int label_id, char *buffer) {
+	buffer[0] = '\0';
+	if (!g_print_builder->debug || label_id < 0 || label_id >= g_print_builder->label_names_cap) return;
+
+	ir_name_t name = g_print_builder->label_names[label_id];
+	switch (name.kind) {
+	case IR_NAME_LABEL:
+		snprintf(buffer, IR_NAME_SIZE, "%s", st_check_label_by_id(name.id).name);
+		break;
+	case IR_NAME_GEN_LABEL:
+		snprintf(buffer, IR_NAME_SIZE, ".LABEL_%d", name.id);
+		break;
+	case IR_NAME_PROC:
+		snprintf(buffer, IR_NAME_SIZE, "%s", st_check_proc_by_id(name.id).name);
+		break;
+	case IR_NAME_INLINE_LABEL:
+		snprintf(buffer, IR_NAME_SIZE, ".INLINE_%d", name.id);
+		break;
+	}
 }
 
 void print_ir_print1(const char *op_str, int res_id, const char *res_name) {
-	printf("%-20s | %-5d %-10s\n", op_str, res_id, res_name);
+	fprintf(g_print_fd, "%-20s | %-5d %-10s\n", op_str, res_id, res_name);
 }
 
 void print_ir_print2(const char *op_str, int res_id, const char *res_name, int arg1_id, const char *arg1_name) {
-	printf("%-20s | %-5d %-10s | %-5d %-10s\n", op_str, res_id, res_name, arg1_id, arg1_name);
+	fprintf(g_print_fd, "%-20s | %-5d %-10s | %-5d %-10s\n", op_str, res_id, res_name, arg1_id, arg1_name);
 }
 
 void print_ir_print3(const char *op_str, int res_id, const char *res_name, int arg1_id, const char *arg1_name,
 	int arg2_id, const char *arg2_name) {
-	printf("%-20s | %-5d %-10s | %-5d %-10s | %-5d %-10s\n", op_str, res_id, res_name, arg1_id, arg1_name,
+	fprintf(g_print_fd, "%-20s | %-5d %-10s | %-5d %-10s | %-5d %-10s\n", op_str, res_id, res_name, arg1_id, arg1_name,
 		arg2_id, arg2_name);
 }
 
 void print_ir_op_binary(ir_t ir, const char *op_str) {
-	name_t res_name = st_check_var_by_id(ir.res_id);
-	name_t arg1_name = st_check_var_by_id(ir.arg1_id);
-	name_t arg2_name = st_check_var_by_id(ir.arg2_id);
-	print_ir_print3(op_str, res_name.id, res_name.name, arg1_name.id, arg1_name.name, arg2_name.id, arg2_name.name);
+	char res_name[IR_NAME_SIZE], arg1_name[IR_NAME_SIZE], arg2_name[IR_NAME_SIZE];
+	print_ir_var_name(ir.res_id, res_name);
+	print_ir_var_name(ir.arg1_id, arg1_name);
+	print_ir_var_name(ir.arg2_id, arg2_name);
+	print_ir_print3(op_str, ir.res_id, res_name, ir.arg1_id, arg1_name, ir.arg2_id, arg2_name);
 }
 
 void print_ir_op_unary(ir_t ir, const char *op_str) {
-	name_t res_name = st_check_var_by_id(ir.res_id);
-	name_t arg1_name = st_check_var_by_id(ir.arg1_id);
-	print_ir_print2(op_str, res_name.id, res_name.name, arg1_name.id, arg1_name.name);
+	char res_name[IR_NAME_SIZE], arg1_name[IR_NAME_SIZE];
+	print_ir_var_name(ir.res_id, res_name);
+	print_ir_var_name(ir.arg1_id, arg1_name);
+	print_ir_print2(op_str, ir.res_id, res_name, ir.arg1_id, arg1_name);
 }
 
 void print_ir_op_label(ir_t ir) {
-	name_t res_name = st_check_label_by_id(ir.res_id);
-	print_ir_print1("OP_LABEL", res_name.id, res_name.name);
+	char res_name[IR_NAME_SIZE];
+	print_ir_label_name(ir.res_id, res_name);
+	print_ir_print1("OP_LABEL", ir.res_id, res_name);
 }
 
 void print_ir_op_copy(ir_t ir) {
-	name_t res_name = st_check_var_by_id(ir.res_id);
-	name_t arg1_name = st_check_var_by_id(ir.arg1_id);
-	print_ir_print2("OP_COPY", res_name.id, res_name.name, arg1_name.id, arg1_name.name);
+	char res_name[IR_NAME_SIZE], arg1_name[IR_NAME_SIZE];
+	print_ir_var_name(ir.res_id, res_name);
+	print_ir_var_name(ir.arg1_id, arg1_name);
+	print_ir_print2("OP_COPY", ir.res_id, res_name, ir.arg1_id, arg1_name);
+}
+
+void print_ir_op_const(ir_t ir) {
+	char res_name[IR_NAME_SIZE];
+	print_ir_var_name(ir.res_id, res_name);
+	print_ir_print2("OP_CONST", ir.res_id, res_name, ir.arg1_id, "");
+}
+
+void print_ir_op_const_wide(ir_t ir, const char *op_str) {
+	char res_name[IR_NAME_SIZE];
+	print_ir_var_name(ir.res_id, res_name);
+	print_ir_print3(op_str, ir.res_id, res_name, ir.arg1_id, "", ir.arg2_id, "");
+}
+
+void print_ir_op_inc(ir_t ir, const char *op_str) {
+	char res_name[IR_NAME_SIZE];
+	print_ir_var_name(ir.res_id, res_name);
+	print_ir_print1(op_str, ir.res_id, res_name);
+}
+
+void print_ir_op_add_imm(ir_t ir, const char *op_str) {
+	char res_name[IR_NAME_SIZE];
+	print_ir_var_name(ir.res_id, res_name);
+	print_ir_print2(op_str, ir.res_id, res_name, ir.arg1_id, "");
 }
 
 void print_ir_op_jmp_cond(ir_t ir, const char *op_str) {
-	name_t res_name = st_check_label_by_id(ir.res_id);
-	name_t arg1_name = st_check_var_by_id(ir.arg1_id);
-	print_ir_print2(op_str, res_name.id, res_name.name, arg1_name.id, arg1_name.name);
+	char res_name[IR_NAME_SIZE], arg1_name[IR_NAME_SIZE];
+	print_ir_label_name(ir.res_id, res_name);
+	print_ir_var_name(ir.arg1_id, arg1_name);
+	print_ir_print2(op_str, ir.res_id, res_name, ir.arg1_id, arg1_name);
 }
 
 void print_ir_op_jmp(ir_t ir) {
-	name_t res_name = st_check_label_by_id(ir.res_id);
-	print_ir_print1("OP_JMP", res_name.id, res_name.name);
+	char res_name[IR_NAME_SIZE];
+	print_ir_label_name(ir.res_id, res_name);
+	print_ir_print1("OP_JMP", ir.res_id, res_name);
+}
+
+void print_ir_op_jmp_table(ir_t ir) {
+	char res_name[IR_NAME_SIZE];
+	print_ir_var_name(ir.res_id, res_name);
+	print_ir_print3("OP_JMP_TABLE", ir.res_id, res_name, ir.arg1_id, "", ir.arg2_id, "");
+}
+
+void print_ir_op_proc(ir_t ir) {
+	char res_name[IR_NAME_SIZE], arg1_name[IR_NAME_SIZE];
+	print_ir_label_name(ir.res_id, res_name);
+	print_ir_label_name(ir.arg1_id, arg1_name);
+	print_ir_print2("OP_PROC", ir.res_id, res_name, ir.arg1_id, arg1_name);
 }
 
-void print_ir_op_print(ir_t ir) {
-	name_t res_name = st_check_var_by_id(ir.res_id);
-	print_ir_print1("OP_PRINT", res_name.id, res_name.name);
+void print_ir_op_call(ir_t ir) {
+	char res_name[IR_NAME_SIZE];
+	print_ir_label_name(ir.res_id, res_name);
+	print_ir_print1("OP_CALL", ir.res_id, res_name);
+}
+
+void print_ir_op_print(ir_t ir, const char *op_str) {
+	char res_name[IR_NAME_SIZE];
+	print_ir_var_name(ir.res_id, res_name);
+	print_ir_print1(op_str, ir.res_id, res_name);
 }
 
 void ir_rule_prog(ast_t *ast) {
@@ -236,10 +883,11 @@ void ir_rule_prog(ast_t *ast) {
 		ir_rule_stmt(ast->prog.stmts[i]);
 	}
 
-	ir_emit(OP_END, 0, 0, 0);
+	ir_emit_end();
 }
 
 void ir_rule_stmt(ast_t *ast) {
+	ir_set_pos(ast);
 	switch (ast->type) {
 	case AST_LABEL_STMT:
 		ir_rule_label_stmt(ast);
@@ -248,16 +896,29 @@ void ir_rule_stmt(ast_t *ast) {
 		ir_rule_var_stmt(ast);
 		break;
 	case AST_IF_STMT:
-		ir_rule_if_stmt(ast);
+	case AST_WHILE_STMT:
+	case AST_FOR_STMT:
+	case AST_SWITCH_STMT:
+	case AST_BLOCK_STMT:
+		ir_rule_compound_stmt(ast);
 		break;
 	case AST_GOTO_STMT:
 		ir_rule_goto_stmt(ast);
 		break;
+	case AST_PROC_STMT:
+		ir_rule_proc_stmt(ast);
+		break;
+	case AST_CALL_STMT:
+		ir_rule_call_stmt(ast);
+		break;
+	case AST_RETURN_STMT:
+		ir_emit(OP_RET, 0, 0, 0);
+		break;
 	case AST_PRINT_STMT:
 		ir_rule_print_stmt(ast);
 		break;
 	case AST_EXPR_STMT:
-		ir_rule_expr(ast->expr_stmt.expr);
+		ir_rule_effect(ast->expr_stmt.expr);
 		break;
 	default:
 		fprintf(stderr, "bruhhh, you shouldn't be here!\n");
@@ -266,70 +927,390 @@ void ir_rule_stmt(ast_t *ast) {
 }
 
 void ir_rule_label_stmt(ast_t *ast) {
-	char *lexical = token_lexical(ast->label_stmt.label);
-	name_t n = st_check_label(lexical);
-	ir_emit(OP_LABEL, n.id, 0, 0);
-	free(lexical);
+	ir_emit(OP_LABEL, ir_label_id(ast->label_id), 0, 0);
 }
 
 void ir_rule_var_stmt(ast_t *ast) {
-	char *lexical = token_lexical(ast->var_stmt.name);
-
-	name_t n = st_check_var(lexical);
+	if (ast->var_stmt.size) {
+		*ir_st_map(&g_st_vars, &g_st_vars_cap, ast->var_id) =
+			ir_generate_array(ast->var_id, ir_literal_value(ast->var_stmt.size));
+	}
 	if (ast->var_stmt.expr) {
 		int arg_id = ir_rule_expr(ast->var_stmt.expr);
-		ir_emit(OP_COPY, n.id, arg_id, 0);
+		int width = ir_width(ast);
+		ir_emit(ir_width_op(OP_COPY, width), ir_var_id(ast->var_id), ir_widen(ast->var_stmt.expr, arg_id, width), 0);
 	}
-
-	free(lexical);
 }
 
-void ir_rule_if_stmt(ast_t *ast) {
-	int cond_id = ir_rule_expr(ast->if_stmt.if_cond);
-
-	int true_label = ir_generate_label();
-	int false_label = ir_generate_label();
-	int end_label = ir_generate_label();
-
-	// condition part
-	ir_emit(OP_JMP_TRUE, true_label, cond_id, 0);
-	
-	// else stmt
-	if (ast->if_stmt.else_block) {
-		ir_rule_stmt(ast->if_stmt.else_block);
-	}
-	ir_emit(OP_JMP, end_label, 0, 0);
-
-	ir_emit(OP_LABEL, true_label, 0, 0);
-	ir_rule_stmt(ast->if_stmt.if_block);
-
-	ir_emit(OP_LABEL, end_label, 0, 0);
-}
+void ir_rule_compound_stmt(ast_t *ast) {
+	// nested if, while, for and block statements are handled on the frame stack
+	int base = g_frames_len;
+	ir_push_frame(ast);
+
+	while (g_frames_len > base) {
+		int index = g_frames_len - 1;
+		ir_frame_t *frame = &g_frames[index];
+		ast_t *child = NULL;
+		ir_set_pos(frame->ast);
+		switch (frame->ast->type) {
+		case AST_IF_STMT:
+			child = ir_rule_if_stmt_step(frame);
+			break;
+		case AST_WHILE_STMT:
+			child = ir_rule_while_stmt_step(frame);
+			break;
+		case AST_FOR_STMT:
+			child = ir_rule_for_stmt_step(frame);
+			break;
+		case AST_SWITCH_STMT:
+			child = ir_rule_switch_stmt_step(frame);
+			break;
+		case AST_BLOCK_STMT:
+			child = ir_rule_block_stmt_step(frame);
+			break;
+		default:
+			fprintf(stderr, "bruhhh, you shouldn't be here!\n");
+			exit(1);
+		}
+
+		if (g_frames[index].done) {
+			g_frames_len--;
+		}
+		else if (child && ast_is_compound_stmt(child)) {
+			ir_push_frame(child);
+		}
+		else if (child) {
+			ir_rule_stmt(child);
+		}
+	}
+}
+
+ast_t *ir_rule_if_stmt_step(ir_frame_t *frame) {
+	ast_t *ast = frame->ast;
+
+	switch (frame->step++) {
+	case 0: {
+		// lowering the condition can grow g_frames and move the frame
+		int index = frame - g_frames;
+		ir_set_pos(ast->if_stmt.if_cond);
+		int cond_id = ir_rule_cond(ast->if_stmt.if_cond);
+		frame = &g_frames[index];
+
+		// 'if (cond) goto label;' jumps straight to the label
+		ast_t *if_block = ast->if_stmt.if_block;
+		if (if_block->type == AST_GOTO_STMT) {
+			frame->end_label = -1;
+			ir_emit(OP_JMP_TRUE, ir_label_id(if_block->label_id), cond_id, 0);
+			return ast->if_stmt.else_block;
+		}
+
+		frame->true_label = ir_generate_label();
+		frame->end_label = ir_generate_label();
+
+		// condition part
+		ir_emit(OP_JMP_TRUE, frame->true_label, cond_id, 0);
+
+		// else stmt
+		return ast->if_stmt.else_block;
+	}
+	case 1:
+		if (frame->end_label == -1) {
+			frame->done = 1;
+			return NULL;
+		}
+
+		ir_emit(OP_JMP, frame->end_label, 0, 0);
+
+		ir_emit(OP_LABEL, frame->true_label, 0, 0);
+		return ast->if_stmt.if_block;
+	default:
+		ir_emit(OP_LABEL, frame->end_label, 0, 0);
+		frame->done = 1;
+		return NULL;
+	}
+}
+
+ast_t *ir_rule_while_stmt_step(ir_frame_t *frame) {
+	ast_t *ast = frame->ast;
+
+	// Rotated loop: the condition sits below the body, so every iteration
+	// takes a single conditional jump back to the top.
+	switch (frame->step++) {
+	case 0:
+		frame->true_label = ir_generate_label();
+		frame->end_label = ir_generate_label();
+
+		ir_emit(OP_JMP, frame->end_label, 0, 0);
+		ir_emit(OP_LABEL, frame->true_label, 0, 0);
+		return ast->while_stmt.body;
+	default: {
+		ir_set_pos(ast->while_stmt.cond);
+		ir_emit(OP_LABEL, frame->end_label, 0, 0);
+
+		// lowering the condition can grow g_frames and move the frame
+		int index = frame - g_frames;
+		int cond_id = ir_rule_cond(ast->while_stmt.cond);
+		frame = &g_frames[index];
+
+		ir_emit(OP_JMP_TRUE, frame->true_label, cond_id, 0);
+		frame->done = 1;
+		return NULL;
+	}
+	}
+}
+
+ast_t *ir_rule_for_stmt_step(ir_frame_t *frame) {
+	ast_t *ast = frame->ast;
+	int index = frame - g_frames;
+
+	// rotated like the while loop; without a condition it loops forever
+	switch (frame->step++) {
+	case 0:
+		if (ast->for_stmt.init) {
+			ir_set_pos(ast->for_stmt.init);
+			ir_rule_effect(ast->for_stmt.init);
+			frame = &g_frames[index];
+		}
+
+		frame->true_label = ir_generate_label();
+		if (ast->for_stmt.cond) {
+			frame->end_label = ir_generate_label();
+			ir_emit(OP_JMP, frame->end_label, 0, 0);
+		}
+		ir_emit(OP_LABEL, frame->true_label, 0, 0);
+		return ast->for_stmt.body;
+	default:
+		if (ast->for_stmt.step) {
+			ir_set_pos(ast->for_stmt.step);
+			ir_rule_effect(ast->for_stmt.step);
+			frame = &g_frames[index];
+		}
+
+		if (ast->for_stmt.cond) {
+			ir_set_pos(ast->for_stmt.cond);
+			ir_emit(OP_LABEL, frame->end_label, 0, 0);
+			int cond_id = ir_rule_cond(ast->for_stmt.cond);
+			frame = &g_frames[index];
+			ir_emit(OP_JMP_TRUE, frame->true_label, cond_id, 0);
+		}
+		else {
+			ir_emit(OP_JMP, frame->true_label, 0, 0);
+		}
+		frame->done = 1;
+		return NULL;
+	}
+}
+
+ast_t *ir_rule_switch_stmt_step(ir_frame_t *frame) {
+	ast_t *ast = frame->ast;
+	int len = ast->switch_stmt.len;
+	int step = frame->step++;
+
+	// Every case body ends with a jump past the switch (there is no fall
+	// through), except the last one which is already there.
+	if (step == 0) {
+		// lowering the expression can grow g_frames and move the frame
+		int index = frame - g_frames;
+		ir_set_pos(ast->switch_stmt.expr);
+		int expr_id = ir_rule_expr(ast->switch_stmt.expr);
+		frame = &g_frames[index];
+
+		// case i starts at label true_label + i
+		frame->true_label = g_labels_len;
+		for (int i = 0; i < len; i++) ir_generate_label();
+		frame->end_label = ir_generate_label();
+
+		ir_rule_switch_dispatch(ast, expr_id, frame->true_label, frame->end_label);
+	}
+	else if (step < len) {
+		ir_emit(OP_JMP, frame->end_label, 0, 0);
+	}
+
+	if (step < len) {
+		ir_emit(OP_LABEL, frame->true_label + step, 0, 0);
+		return ast->switch_stmt.cases[step]->case_stmt.body;
+	}
+
+	ir_emit(OP_LABEL, frame->end_label, 0, 0);
+	frame->done = 1;
+	return NULL;
+}
+
+void ir_rule_switch_dispatch(ast_t *ast, int expr_id, int first_label, int end_label) {
+	int len = ast->switch_stmt.len;
+	ir_case_t *cases = mem_malloc(MEM_IR, (len + 1) * sizeof(ir_case_t));
+	if (cases == NULL) {
+		perror("something went wrong with malloc in ir_rule_switch_dispatch");
+		exit(1);
+	}
+
+	// case labels written back to back share the body of the last one
+	int count = 0;
+	int default_label = end_label;
+	int body_label = end_label;
+	for (int i = len - 1; i >= 0; i--) {
+		ast_t *case_stmt = ast->switch_stmt.cases[i];
+		if (case_stmt->case_stmt.body->block_stmt.len > 0) {
+			body_label = first_label + i;
+		}
+		if (case_stmt->case_stmt.value == NULL) {
+			default_label = body_label;
+			continue;
+		}
+		cases[count++] = (ir_case_t) {.value = case_stmt->case_stmt.number, .label = body_label};
+	}
+	qsort(cases, count, sizeof(ir_case_t), ir_case_compare);
+
+	int cmp_id = (count > 0 ? ir_generate_temp() : -1);
+	ir_rule_switch_search(cases, count, expr_id, cmp_id, default_label);
+	mem_free(MEM_IR, cases);
+}
+
+void ir_rule_switch_search(ir_case_t *cases, int len, int expr_id, int cmp_id, int default_label) {
+	// Dense runs of values become a jump table, a few values are compared one
+	// by one and anything else is split in half on the middle value. Each
+	// split halves len, so the recursion is at most log2 of the cases deep.
+	long long range = (len > 0 ? (long long) cases[len-1].value - cases[0].value + 1 : 0);
+	if (len >= IR_JUMP_TABLE_MIN && range <= (long long) len * IR_JUMP_TABLE_DENSITY) {
+		ir_emit(OP_JMP_TABLE, expr_id, cases[0].value, (int) range);
+		long long value = cases[0].value;
+		for (int i = 0; i < len; value++) {
+			if (cases[i].value == value) ir_emit(OP_JMP, cases[i++].label, 0, 0);
+			else ir_emit(OP_JMP, default_label, 0, 0);
+		}
+		ir_emit(OP_JMP, default_label, 0, 0);
+		return;
+	}
+
+	if (len < IR_JUMP_TABLE_MIN) {
+		for (int i = 0; i < len; i++) {
+			ir_emit(OP_EQUAL_EQUAL, cmp_id, expr_id, ir_generate_const(cases[i].value));
+			ir_emit(OP_JMP_TRUE, cases[i].label, cmp_id, 0);
+		}
+		ir_emit(OP_JMP, default_label, 0, 0);
+		return;
+	}
+
+	int mid = len / 2;
+	int lower_label = ir_generate_label();
+	ir_emit(OP_LESSER, cmp_id, expr_id, ir_generate_const(cases[mid].value));
+	ir_emit(OP_JMP_TRUE, lower_label, cmp_id, 0);
+	ir_rule_switch_search(cases + mid, len - mid, expr_id, cmp_id, default_label);
+	ir_emit(OP_LABEL, lower_label, 0, 0);
+	ir_rule_switch_search(cases, mid, expr_id, cmp_id, default_label);
+}
+
+int ir_case_compare(const void *a, const void *b) {
+	const ir_case_t *left = a, *right = b;
+	if (left->value != right->value) {
+		return left->value < right->value ? -1 : 1;
+	}
+	return 0;
+}
+
+ast_t *ir_rule_block_stmt_step(ir_frame_t *frame) {
+	ast_t *ast = frame->ast;
+	if (frame->step >= ast->block_stmt.len) {
+		frame->done = 1;
+		return NULL;
+	}
+	return ast->block_stmt.stmts[frame->step++];
+}
 
 void ir_rule_goto_stmt(ast_t *ast) {
-	char *lexical = token_lexical(ast->goto_stmt.label);
-	name_t n = st_check_label(lexical);
-	ir_emit(OP_JMP, n.id, 0, 0);
-	free(lexical);
+	ir_emit(OP_JMP, ir_label_id(ast->label_id), 0, 0);
+}
+
+void ir_rule_proc_stmt(ast_t *ast) {
+	// the body sits where it is declared; OP_PROC jumps over it
+	int end_label = ir_generate_label();
+	ir_emit(OP_PROC, ir_proc_label_id(ast->proc_id), end_label, 0);
+	ir_rule_compound_stmt(ast->proc_stmt.body);
+	ir_emit(OP_RET, 0, 0, 0);
+	ir_emit(OP_LABEL, end_label, 0, 0);
+}
+
+void ir_rule_call_stmt(ast_t *ast) {
+	ir_emit(OP_CALL, ir_proc_label_id(ast->proc_id), 0, 0);
 }
 
 void ir_rule_print_stmt(ast_t *ast) {
 	int res_id = ir_rule_expr(ast->print_stmt.expr);
-	ir_emit(OP_PRINT, res_id, 0, 0);
+	ir_emit(ir_width_op(OP_PRINT, ir_width(ast->print_stmt.expr)), res_id, 0, 0);
 }
 
 int ir_rule_expr(ast_t *ast) {
+	int base = g_frames_len;
+	ir_push_frame(ast);
+
+	for (;;) {
+		ir_frame_t *frame = &g_frames[g_frames_len - 1];
+		ast_t *child = ir_rule_expr_step(frame);
+		if (child) {
+			ir_push_frame(child);
+			continue;
+		}
+
+		int res_id = frame->res_id;
+		g_frames_len--;
+		if (g_frames_len == base) {
+			return res_id;
+		}
+
+		frame = &g_frames[g_frames_len - 1];
+		frame->ids[frame->step++] = res_id;
+	}
+}
+
+void ir_rule_effect(ast_t *ast) {
+	g_discarded = ast;
+	ir_rule_expr(ast);
+	g_discarded = NULL;
+}
+
+int ir_snapshot(ast_t *ast, int var_id, int width) {
+	// a later write in the same expression must not change the value
+	if (ast == g_discarded) return var_id;
+
+	int res_id = ir_generate_width_temp(width);
+	ir_emit(ir_width_op(OP_COPY, width), res_id, var_id, 0);
+	return res_id;
+}
+
+ast_t *ir_rule_expr_step(ir_frame_t *frame) {
+	ast_t *ast = frame->ast;
+
 	switch (ast->type) {
 	case AST_LITERAL:
-		return ir_rule_literal(ast);
+		frame->res_id = ir_rule_literal(ast);
+		return NULL;
 	case AST_IDENTIFIER:
-		return ir_rule_identifier(ast);
+		frame->res_id = ir_rule_identifier(ast);
+		return NULL;
+	case AST_INDEX:
+		return ir_rule_index(frame);
+	case AST_BUILTIN:
+		return ir_rule_builtin(frame);
 	case AST_UNARY:
-		return ir_rule_unary(ast);
+		if (ast->unary.right->type == AST_INDEX && 
+			(ast->unary.op.type == TT_PLUS_PLUS || ast->unary.op.type == TT_MINUS_MINUS)) {
+			return ir_rule_index_update(frame);
+		}
+		if (frame->step == 0) return ast->unary.right;
+		frame->res_id = ir_rule_unary(ast, frame->ids[0]);
+		return NULL;
 	case AST_BINARY:
-		return ir_rule_binary(ast);
+		if (ast->binary.left->type == AST_INDEX && 
+			(ast->binary.op.type == TT_EQUAL || ir_compound_op(ast->binary.op.type) != -1)) {
+			return ir_rule_index_update(frame);
+		}
+		if (frame->step == 0 && ir_rule_add_imm(ast, &frame->res_id)) return NULL;
+		if (frame->step == 0) return ast->binary.left;
+		if (frame->step == 1) return ast->binary.right;
+		frame->res_id = ir_rule_binary(ast, frame->ids[0], frame->ids[1]);
+		return NULL;
 	case AST_TERNARY:
-		return ir_rule_ternary(ast);
+		return ir_rule_ternary(frame);
 	default:
 		fprintf(stderr, "yooo, how you here?\n");
 		exit(1);
@@ -337,216 +1318,620 @@ int ir_rule_expr(ast_t *ast) {
 }
 
 int ir_rule_literal(ast_t *ast) {
-	char *lexical = token_lexical(ast->literal.token);
-	int id = ir_generate_literal(lexical);
-	free(lexical);
-	return id;
-}
-
-int ir_rule_identifier(ast_t *ast) {
-	char *lexical = token_lexical(ast->identifier.token);
-	int id = st_check_var(lexical).id;
-	free(lexical);
-	return id;
+	switch (ir_width(ast)) {
+	case IR_WIDTH_BIG:
+		return ir_generate_const_big(ast);
+	case IR_WIDTH_I64:
+		return ir_generate_const_width(ir_literal_value64(ast), IR_WIDTH_I64);
+	default:
+		return ir_generate_const(ir_literal_value(ast));
+	}
 }
 
-int ir_rule_unary(ast_t *ast) {
-	int expr_id = ir_rule_expr(ast->unary.right);
+int ir_rule_add_imm(ast_t *ast, int *res_id) {
+	// x += lit, x -= lit, x = x + lit, x = lit + x and x = x - lit update x in place
+	ast_t *left = ast->binary.left, *right = ast->binary.right;
+	if (left->type != AST_IDENTIFIER) return 0;
 
-	switch (ast->unary.op.type) {
-	case TT_PLUS:
-		return expr_id;
-	case TT_MINUS: {
-		int res_id = ir_generate_temp();
-		int zero_literal = ir_generate_literal("0");
-		ir_emit(OP_SUB, res_id, zero_literal, expr_id);
-		return res_id;
+	// the immediate is an int, so an i64 literal takes the generic path
+	unsigned int imm;
+	int op = ast->binary.op.type;
+	if ((op == TT_PLUS_EQUAL || op == TT_MINUS_EQUAL) && right->type == AST_LITERAL && ir_width(right) == IR_WIDTH_INT) {
+		imm = (unsigned int) ir_literal_value(right);
+		if (op == TT_MINUS_EQUAL) imm = -imm;
 	}
-	case TT_PLUS_PLUS: {
-		int res_id = ir_generate_temp();
-		int one_literal = ir_generate_literal("1");
-		ir_emit(OP_ADD, res_id, expr_id, one_literal);
-		ir_emit(OP_COPY, expr_id, res_id, 0);
-		return res_id;
+	else if (op == TT_EQUAL && right->type == AST_BINARY) {
+		int inner = right->binary.op.type;
+		ast_t *a = right->binary.left, *b = right->binary.right;
+		if (inner == TT_PLUS && a->type == AST_LITERAL) {
+			ast_t *tmp = a;
+			a = b;
+			b = tmp;
+		}
+		if (inner != TT_PLUS && inner != TT_MINUS) return 0;
+		if (a->type != AST_IDENTIFIER || a->var_id != left->var_id || b->type != AST_LITERAL) return 0;
+		if (ir_width(b) != IR_WIDTH_INT) return 0;
+		imm = (unsigned int) ir_literal_value(b);
+		if (inner == TT_MINUS) imm = -imm;
 	}
-	case TT_MINUS_MINUS: {
-		int res_id = ir_generate_temp();
-		int one_literal = ir_generate_literal("1");
-		ir_emit(OP_SUB, res_id, expr_id, one_literal);
-		ir_emit(OP_COPY, expr_id, res_id, 0);
-		return res_id;
+	else {
+		return 0;
 	}
-	case TT_BANG: {
-		int res_id = ir_generate_temp();
-		ir_emit(OP_LOGICAL_NOT, res_id, expr_id, 0);
-		return res_id;
+
+	int var_id = ir_var_id(left->var_id);
+	int width = ir_width(left);
+	if (imm == 1) ir_emit(ir_width_op(OP_INC, width), var_id, 0, 0);
+	else if (imm == (unsigned int) -1) ir_emit(ir_width_op(OP_DEC, width), var_id, 0, 0);
+	else if (imm != 0) ir_emit(ir_width_op(OP_ADD_IMM, width), var_id, (int) imm, 0);
+
+	// like any assignment, x = x + lit gives x itself
+	*res_id = op == TT_EQUAL ? var_id : ir_snapshot(ast, var_id, width);
+	return 1;
+}
+
+int ir_literal_value(ast_t *ast) {
+	// the literal is followed by a non digit, so strtol stops at its end
+	token_t token = ast->literal.token;
+	return (int) strtol(token.src + token.start.index, NULL, 10);
+}
+
+long long ir_literal_value64(ast_t *ast) {
+	token_t token = ast->literal.token;
+	return strtoll(token.src + token.start.index, NULL, 10);
+}
+
+int ir_compound_op(int token_type) {
+	switch (token_type) {
+	case TT_PLUS_EQUAL: return OP_ADD;
+	case TT_MINUS_EQUAL: return OP_SUB;
+	case TT_STAR_EQUAL: return OP_MUL;
+	case TT_FSLASH_EQUAL: return OP_DIV;
+	case TT_MOD_EQUAL: return OP_MOD;
+	case TT_LSHIFT_EQUAL: return OP_LSHIFT;
+	case TT_RSHIFT_EQUAL: return OP_RSHIFT;
+	case TT_AMPERSAND_EQUAL: return OP_BITWISE_AND;
+	case TT_PIPE_EQUAL: return OP_BITWISE_OR;
+	case TT_CARET_EQUAL: return OP_BITWISE_XOR;
+	default: return -1;
 	}
-	case TT_TILDE: {
-		int res_id = ir_generate_temp();
-		ir_emit(OP_BITWISE_NOT, res_id, expr_id, 0);
-		return res_id;
+}
+
+int ir_binary_op(int token_type) {
+	switch (token_type) {
+	case TT_STAR: return OP_MUL;
+	case TT_FSLASH: return OP_DIV;
+	case TT_MOD: return OP_MOD;
+	case TT_PLUS: return OP_ADD;
+	case TT_MINUS: return OP_SUB;
+	case TT_LSHIFT: return OP_LSHIFT;
+	case TT_RSHIFT: return OP_RSHIFT;
+	case TT_EQUAL_EQUAL: return OP_EQUAL_EQUAL;
+	case TT_BANG_EQUAL: return OP_NOT_EQUAL;
+	case TT_LESSER: return OP_LESSER;
+	case TT_LESSER_EQUAL: return OP_LESSER_EQUAL;
+	case TT_GREATER: return OP_GREATER;
+	case TT_GREATER_EQUAL: return OP_GREATER_EQUAL;
+	case TT_AMPERSAND: return OP_BITWISE_AND;
+	case TT_CARET: return OP_BITWISE_XOR;
+	case TT_PIPE: return OP_BITWISE_OR;
+	default: return -1;
 	}
-	default:
-		fprintf(stderr, ">_<; don't sniff around!\n");
+}
+
+int ir_width_op(int op, int width) {
+	if (width == IR_WIDTH_INT) return op;
+
+	// bigints have no bitwise operations; the analyzer rejects them
+	int i64 = width == IR_WIDTH_I64;
+	int res = -1;
+	switch (op) {
+	case OP_ADD: res = i64 ? OP_ADD_I64 : OP_ADD_BIG; break;
+	case OP_SUB: res = i64 ? OP_SUB_I64 : OP_SUB_BIG; break;
+	case OP_MUL: res = i64 ? OP_MUL_I64 : OP_MUL_BIG; break;
+	case OP_DIV: res = i64 ? OP_DIV_I64 : OP_DIV_BIG; break;
+	case OP_MOD: res = i64 ? OP_MOD_I64 : OP_MOD_BIG; break;
+	case OP_LSHIFT: res = i64 ? OP_LSHIFT_I64 : -1; break;
+	case OP_RSHIFT: res = i64 ? OP_RSHIFT_I64 : -1; break;
+	case OP_EQUAL_EQUAL: res = i64 ? OP_EQUAL_EQUAL_I64 : OP_EQUAL_EQUAL_BIG; break;
+	case OP_NOT_EQUAL: res = i64 ? OP_NOT_EQUAL_I64 : OP_NOT_EQUAL_BIG; break;
+	case OP_LESSER: res = i64 ? OP_LESSER_I64 : OP_LESSER_BIG; break;
+	case OP_LESSER_EQUAL: res = i64 ? OP_LESSER_EQUAL_I64 : OP_LESSER_EQUAL_BIG; break;
+	case OP_GREATER: res = i64 ? OP_GREATER_I64 : OP_GREATER_BIG; break;
+	case OP_GREATER_EQUAL: res = i64 ? OP_GREATER_EQUAL_I64 : OP_GREATER_EQUAL_BIG; break;
+	case OP_BITWISE_AND: res = i64 ? OP_BITWISE_AND_I64 : -1; break;
+	case OP_BITWISE_OR: res = i64 ? OP_BITWISE_OR_I64 : -1; break;
+	case OP_BITWISE_XOR: res = i64 ? OP_BITWISE_XOR_I64 : -1; break;
+	case OP_BITWISE_NOT: res = i64 ? OP_BITWISE_NOT_I64 : -1; break;
+	case OP_COPY: res = i64 ? OP_COPY_I64 : OP_COPY_BIG; break;
+	case OP_INC: res = i64 ? OP_INC_I64 : OP_INC_BIG; break;
+	case OP_DEC: res = i64 ? OP_DEC_I64 : OP_DEC_BIG; break;
+	case OP_ADD_IMM: res = i64 ? OP_ADD_IMM_I64 : OP_ADD_IMM_BIG; break;
+	case OP_PRINT: res = i64 ? OP_PRINT_I64 : OP_PRINT_BIG; break;
+	}
+	if (res == -1) {
+		fprintf(stderr, "no %s twin for op %d -_-\n", i64 ? "i64" : "bigint", op);
 		exit(1);
 	}
+	return res;
 }
 
-int ir_rule_binary(ast_t *ast) {
-	int left_id = ir_rule_expr(ast->binary.left);
-	int right_id = ir_rule_expr(ast->binary.right);
-	switch (ast->binary.op.type) {
-	case TT_STAR: {
-		int res_id = ir_generate_temp();
-		ir_emit(OP_MUL, res_id, left_id, right_id);
-		return res_id;
+int ir_width(ast_t *ast) {
+	if (ast->type_id == -1) return IR_WIDTH_INT;
+	if (ast->type_id == g_i64_type_id) return IR_WIDTH_I64;
+	if (ast->type_id == g_bigint_type_id) return IR_WIDTH_BIG;
+	return IR_WIDTH_INT;
+}
+
+int ir_widen(ast_t *ast, int id, int width) {
+	int from = ir_width(ast);
+	if (from == width) return id;
+
+	// literals are widened at compile time
+	if (ast->type == AST_LITERAL) return ir_generate_const_width(ir_literal_value64(ast), width);
+
+	int res_id = ir_generate_width_temp(width);
+	int op = width == IR_WIDTH_I64 ? OP_WIDEN : from == IR_WIDTH_INT ? OP_WIDEN_BIG : OP_WIDEN_I64_BIG;
+	ir_emit(op, res_id, id, 0);
+	return res_id;
+}
+
+int ir_truth(ast_t *ast, int id) {
+	// conditional jumps test an int, so wider values are compared with 0 first
+	int width = ir_width(ast);
+	if (width == IR_WIDTH_INT) return id;
+
+	int res_id = ir_generate_temp();
+	ir_emit(ir_width_op(OP_NOT_EQUAL, width), res_id, id, ir_generate_const_width(0, width));
+	return res_id;
+}
+
+int ir_rule_cond(ast_t *ast) {
+	return ir_truth(ast, ir_rule_expr(ast));
+}
+
+int ir_rule_identifier(ast_t *ast) {
+	return ir_var_id(ast->var_id);
+}
+
+ast_t *ir_rule_index(ir_frame_t *frame) {
+	ast_t *ast = frame->ast;
+	if (frame->step == 0) return ast->index.expr;
+
+	frame->res_id = ir_generate_temp();
+	ir_emit(OP_LOAD, frame->res_id, ir_var_id(ast->index.array->var_id), frame->ids[0]);
+	return NULL;
+}
+
+ast_t *ir_rule_index_update(ir_frame_t *frame) {
+	// assignment, compound assignment, ++ and -- of an element; the index is
+	// lowered once and the element is written back with OP_STORE
+	ast_t *ast = frame->ast;
+	ast_t *index = ast->type == AST_UNARY ? ast->unary.right : ast->binary.left;
+	if (frame->step == 0) return index->index.expr;
+	if (frame->step == 1 && ast->type == AST_BINARY) return ast->binary.right;
+
+	int array_id = ir_var_id(index->index.array->var_id);
+	int index_id = frame->ids[0];
+	if (ast->type == AST_BINARY && ast->binary.op.type == TT_EQUAL) {
+		ir_emit(OP_STORE, array_id, index_id, frame->ids[1]);
+		frame->res_id = frame->ids[1];
+		return NULL;
 	}
-	case TT_FSLASH: {
-		int res_id = ir_generate_temp();
-		ir_emit(OP_DIV, res_id, left_id, right_id);
-		return res_id;
+
+	frame->res_id = ir_generate_temp();
+	ir_emit(OP_LOAD, frame->res_id, array_id, index_id);
+	if (ast->type == AST_BINARY) {
+		ir_emit(ir_compound_op(ast->binary.op.type), frame->res_id, frame->res_id, frame->ids[1]);
 	}
-	case TT_MOD: {
-		int res_id = ir_generate_temp();
-		ir_emit(OP_MOD, res_id, left_id, right_id);
-		return res_id;
+	else {
+		ir_emit(ast->unary.op.type == TT_PLUS_PLUS ? OP_INC : OP_DEC, frame->res_id, 0, 0);
 	}
-	case TT_PLUS: {
-		int res_id = ir_generate_temp();
-		ir_emit(OP_ADD, res_id, left_id, right_id);
-		return res_id;
+	ir_emit(OP_STORE, array_id, index_id, frame->res_id);
+	return NULL;
+}
+
+ast_t *ir_rule_builtin(ir_frame_t *frame) {
+	ast_t *ast = frame->ast;
+	ast_t **args = ast->builtin.args;
+	if (frame->step == 0 && ast->builtin.kind == BUILTIN_FILL) return args[1];
+
+	// the array id holds the length, so len, fill and copy evaluate to it
+	int array_id = ir_var_id(args[0]->var_id);
+	switch (ast->builtin.kind) {
+	case BUILTIN_LEN:
+		frame->res_id = array_id;
+		return NULL;
+	case BUILTIN_FILL:
+		ir_emit(OP_FILL, array_id, frame->ids[0], 0);
+		frame->res_id = array_id;
+		return NULL;
+	case BUILTIN_COPY:
+		ir_emit(OP_ARRAY_COPY, array_id, ir_var_id(args[1]->var_id), 0);
+		frame->res_id = array_id;
+		return NULL;
+	case BUILTIN_SUM:
+		frame->res_id = ir_generate_temp();
+		ir_emit(OP_SUM, frame->res_id, array_id, 0);
+		return NULL;
+	case BUILTIN_MIN:
+		frame->res_id = ir_generate_temp();
+		ir_emit(OP_MIN, frame->res_id, array_id, 0);
+		return NULL;
+	case BUILTIN_MAX:
+		frame->res_id = ir_generate_temp();
+		ir_emit(OP_MAX, frame->res_id, array_id, 0);
+		return NULL;
+	default:
+		fprintf(stderr, "unknown builtin; the analyzer should have caught it\n");
+		exit(1);
 	}
+}
+
+int ir_rule_unary(ast_t *ast, int expr_id) {
+	int width = ir_width(ast->unary.right);
+	switch (ast->unary.op.type) {
+	case TT_PLUS:
+		return expr_id;
 	case TT_MINUS: {
-		int res_id = ir_generate_temp();
-		ir_emit(OP_SUB, res_id, left_id, right_id);
+		int res_id = ir_generate_width_temp(width);
+		int zero_literal = ir_generate_const_width(0, width);
+		ir_emit(ir_width_op(OP_SUB, width), res_id, zero_literal, expr_id);
 		return res_id;
 	}
-	case TT_LSHIFT: {
-		int res_id = ir_generate_temp();
-		ir_emit(OP_LSHIFT, res_id, left_id, right_id);
-		return res_id;
-	}
-	case TT_RSHIFT: {
-		int res_id = ir_generate_temp();
-		ir_emit(OP_RSHIFT, res_id, left_id, right_id);
-		return res_id;
-	}
-	case TT_EQUAL_EQUAL: {
+	case TT_PLUS_PLUS:
+		ir_emit(ir_width_op(OP_INC, width), expr_id, 0, 0);
+		return ir_snapshot(ast, expr_id, width);
+	case TT_MINUS_MINUS:
+		ir_emit(ir_width_op(OP_DEC, width), expr_id, 0, 0);
+		return ir_snapshot(ast, expr_id, width);
+	case TT_BANG: {
 		int res_id = ir_generate_temp();
-		ir_emit(OP_EQUAL_EQUAL, res_id, left_id, right_id);
+		if (width == IR_WIDTH_INT) ir_emit(OP_LOGICAL_NOT, res_id, expr_id, 0);
+		else ir_emit(ir_width_op(OP_EQUAL_EQUAL, width), res_id, expr_id, ir_generate_const_width(0, width));
 		return res_id;
 	}
-	case TT_BANG_EQUAL: {
-		int res_id = ir_generate_temp();
-		ir_emit(OP_NOT_EQUAL, res_id, left_id, right_id);
+	case TT_TILDE: {
+		int res_id = ir_generate_width_temp(width);
+		ir_emit(ir_width_op(OP_BITWISE_NOT, width), res_id, expr_id, 0);
 		return res_id;
 	}
-	case TT_LESSER: {
-		int res_id = ir_generate_temp();
-		ir_emit(OP_LESSER, res_id, left_id, right_id);
-		return res_id;
+	default:
+		fprintf(stderr, ">_<; don't sniff around!\n");
+		exit(1);
 	}
-	case TT_LESSER_EQUAL: {
+}
+
+int ir_rule_binary(ast_t *ast, int left_id, int right_id) {
+	ast_t *left = ast->binary.left, *right = ast->binary.right;
+	int token_type = ast->binary.op.type;
+
+	// && and || work on truth values, so i64 operands are compared with 0
+	if (token_type == TT_LOGICAL_AND || token_type == TT_LOGICAL_OR) {
+		left_id = ir_truth(left, left_id);
+		right_id = ir_truth(right, right_id);
+
 		int res_id = ir_generate_temp();
-		ir_emit(OP_LESSER_EQUAL, res_id, left_id, right_id);
+		ir_emit(token_type == TT_LOGICAL_AND ? OP_LOGICAL_AND : OP_LOGICAL_OR, res_id, left_id, right_id);
 		return res_id;
 	}
-	case TT_GREATER: {
-		int res_id = ir_generate_temp();
-		ir_emit(OP_GREATER, res_id, left_id, right_id);
-		return res_id;
+
+	// the narrower operand is widened and the opcode of the wider one is used
+	int width = ir_width(left) > ir_width(right) ? ir_width(left) : ir_width(right);
+	left_id = ir_widen(left, left_id, width);
+	right_id = ir_widen(right, right_id, width);
+
+	if (token_type == TT_EQUAL) {
+		ir_emit(ir_width_op(OP_COPY, width), left_id, right_id, 0);
+		return left_id;
 	}
-	case TT_GREATER_EQUAL: {
-		int res_id = ir_generate_temp();
-		ir_emit(OP_GREATER_EQUAL, res_id, left_id, right_id);
-		return res_id;
+
+	// x op= y is x = x op y with x as its own destination
+	int op = ir_compound_op(token_type);
+	if (op != -1) {
+		ir_emit(ir_width_op(op, width), left_id, left_id, right_id);
+		return ir_snapshot(ast, left_id, width);
 	}
-	case TT_AMPERSAND: {
-		int res_id = ir_generate_temp();
-		ir_emit(OP_BITWISE_AND, res_id, left_id, right_id);
-		return res_id;
+
+	op = ir_binary_op(token_type);
+	if (op == -1) {
+		fprintf(stderr, "invalidated ~.~\n");
+		exit(1);
 	}
-	case TT_CARET: {
-		int res_id = ir_generate_temp();
-		ir_emit(OP_BITWISE_XOR, res_id, left_id, right_id);
-		return res_id;
+
+	// comparisons give an int even for wider operands
+	int res_id = ir_generate_width_temp(ir_width(ast));
+	ir_emit(ir_width_op(op, width), res_id, left_id, right_id);
+	return res_id;
+}
+
+ast_t *ir_rule_ternary(ir_frame_t *frame) {
+	ast_t *ast = frame->ast;
+
+	switch (frame->step) {
+	case 0:
+		return ast->ternary.left;
+	case 1: {
+		int cond_id = ir_truth(ast->ternary.left, frame->ids[0]);
+
+		frame->res_id = ir_generate_width_temp(ir_width(ast));
+		frame->true_label = ir_generate_label();
+		frame->end_label = ir_generate_label();
+
+		ir_emit(OP_JMP_TRUE, frame->true_label, cond_id, 0);
+
+		// false case
+		return ast->ternary.right;
 	}
-	case TT_PIPE: {
-		int res_id = ir_generate_temp();
-		ir_emit(OP_BITWISE_OR, res_id, left_id, right_id);
-		return res_id;
+	case 2:
+		ir_emit(ir_width_op(OP_COPY, ir_width(ast)), frame->res_id,
+			ir_widen(ast->ternary.right, frame->ids[1], ir_width(ast)), 0);
+		ir_emit(OP_JMP, frame->end_label, 0, 0);
+
+		// true case
+		ir_emit(OP_LABEL, frame->true_label, 0, 0);
+		return ast->ternary.mid;
+	default:
+		ir_emit(ir_width_op(OP_COPY, ir_width(ast)), frame->res_id,
+			ir_widen(ast->ternary.mid, frame->ids[2], ir_width(ast)), 0);
+
+		// end case
+		ir_emit(OP_LABEL, frame->end_label, 0, 0);
+		return NULL;
 	}
-	case TT_LOGICAL_AND: {
-		int res_id = ir_generate_temp();
-		ir_emit(OP_LOGICAL_AND, res_id, left_id, right_id);
-		return res_id;
+}
+
+int ir_generate_var(int kind, int id) {
+	if (g_builder->debug) {
+		ir_set_name(&g_builder->var_names, &g_builder->var_names_cap, g_vars_len, kind, id);
 	}
-	case TT_LOGICAL_OR: {
-		int res_id = ir_generate_temp();
-		ir_emit(OP_LOGICAL_OR, res_id, left_id, right_id);
-		return res_id;
+	return g_vars_len++;
+}
+
+int ir_generate_array(int st_var_id, int len) {
+	// the length lives in the array id itself, the elements follow it
+	int array_id = ir_generate_var(IR_NAME_VAR, st_var_id);
+	if (g_builder->debug) {
+		for (int i = 0; i < len; i++) ir_generate_var(IR_NAME_ELEMENT, i);
 	}
-	case TT_EQUAL: {
-		ir_emit(OP_COPY, left_id, right_id, 0);
-		return left_id;
+	else {
+		g_vars_len += len;
 	}
-	default:
-		fprintf(stderr, "invalidated ~.~\n");
-		exit(1);
+	ir_emit_const(OP_CONST, array_id, len, 0);
+	return array_id;
+}
+
+int ir_generate_label_id(int kind, int id) {
+	if (g_builder->debug) {
+		ir_set_name(&g_builder->label_names, &g_builder->label_names_cap, g_labels_len, kind, id);
 	}
+	return g_labels_len++;
 }
 
-int ir_rule_ternary(ast_t *ast) {
-	int cond_id = ir_rule_expr(ast->ternary.left);
+int ir_generate_label() {
+	return ir_generate_label_id(IR_NAME_GEN_LABEL, ++g_label_len);
+}
+
+int ir_generate_temp() {
+	return ir_generate_var(IR_NAME_TEMP, ++g_temp_len);
+}
 
+int ir_generate_width_temp(int width) {
 	int res_id = ir_generate_temp();
-	int true_label = ir_generate_label();
-	int false_label = ir_generate_label();
-	int end_label = ir_generate_label();
 
-	ir_emit(OP_JMP_TRUE, true_label, cond_id, 0);
+	// the high half of an i64 is never named on its own
+	if (width == IR_WIDTH_I64) ir_generate_var(IR_NAME_TEMP, g_temp_len);
+	return res_id;
+}
 
-	// false case
-	ir_emit(OP_COPY, res_id, ir_rule_expr(ast->ternary.right), 0);
-	ir_emit(OP_JMP, end_label, 0, 0);
+int ir_generate_const(int value) {
+	return ir_generate_const_width(value, IR_WIDTH_INT);
+}
 
-	// true case
-	ir_emit(OP_LABEL, true_label, 0, 0);
-	ir_emit(OP_COPY, res_id, ir_rule_expr(ast->ternary.mid), 0);
+int ir_generate_const_width(long long value, int width) {
+	if (g_consts_len * 2 >= g_consts_cap) {
+		ir_grow_consts();
+	}
 
-	// end case
-	ir_emit(OP_LABEL, end_label, 0, 0);
+	unsigned int slot = ir_const_slot(value, width);
+	for (;; slot++) {
+		ir_const_t *entry = &g_consts[slot & (g_consts_cap - 1)];
+		if (entry->var_id == -1) {
+			entry->value = value;
+			entry->width = width;
+			g_consts_len++;
 
-	return res_id;
+			int low = (int) (unsigned int) value;
+			int high = (int) (unsigned int) ((unsigned long long) value >> 32);
+			switch (width) {
+			case IR_WIDTH_INT:
+				entry->var_id = ir_generate_var(IR_NAME_CONST, low);
+				ir_emit_const(OP_CONST, entry->var_id, low, 0);
+				break;
+			case IR_WIDTH_I64:
+				entry->var_id = ir_generate_var(IR_NAME_CONST_I64, low);
+				ir_generate_var(IR_NAME_CONST_I64, high);
+				ir_emit_const(OP_CONST_I64, entry->var_id, low, high);
+				break;
+			default:
+				// only literals are widened to bigint, so the value is never negative
+				entry->var_id = ir_generate_var(IR_NAME_CONST_BIG, ++g_big_consts_len);
+				ir_emit_const(OP_CONST_BIG, entry->var_id, low, 0);
+				if (high) ir_emit_const(OP_CONST_BIG, entry->var_id, high, 1);
+				break;
+			}
+			return entry->var_id;
+		}
+		if (entry->value == value && entry->width == width) {
+			return entry->var_id;
+		}
+	}
 }
 
-int ir_generate_label() {
-	char buffer[1024];
-	sprintf(buffer, ".LABEL_%d", ++g_label_len);
-	return st_create_label(buffer).id;
+int ir_generate_const_big(ast_t *literal) {
+	// literals too big for an i64 are rare, so they are not deduplicated
+	token_t token = literal->literal.token;
+	bigint_t value;
+	bigint_init(&value);
+	bigint_parse(&value, token.src + token.start.index, token.end.index - token.start.index);
+
+	int var_id = ir_generate_var(IR_NAME_CONST_BIG, ++g_big_consts_len);
+	for (int i = 0; i < bigint_chunks(&value); i++) {
+		unsigned int chunk = bigint_chunk(&value, i);
+		if (chunk) ir_emit_const(OP_CONST_BIG, var_id, (int) chunk, i);
+	}
+	bigint_free(&value);
+	return var_id;
 }
 
-int ir_generate_temp() {
-	char buffer[1024];
-	sprintf(buffer, ".TEMP_%d", ++g_temp_len);
-	return st_create_var(buffer, st_check_type("int").id).id;
+int ir_var_id(int st_var_id) {
+	int *id = ir_st_map(&g_st_vars, &g_st_vars_cap, st_var_id);
+	if (*id == -1) {
+		*id = ir_generate_var(IR_NAME_VAR, st_var_id);
+
+		// an i64 variable also owns the next id for its high half
+		if (g_i64_type_id != -1 && st_check_var_by_id(st_var_id).type_id == g_i64_type_id) {
+			ir_generate_var(IR_NAME_VAR, st_var_id);
+		}
+	}
+	return *id;
+}
+
+int ir_label_id(int st_label_id) {
+	int *id = ir_st_map(&g_st_labels, &g_st_labels_cap, st_label_id);
+	if (*id == -1) *id = ir_generate_label_id(IR_NAME_LABEL, st_label_id);
+	return *id;
+}
+
+int ir_proc_label_id(int st_proc_id) {
+	int *id = ir_st_map(&g_st_procs, &g_st_procs_cap, st_proc_id);
+	if (*id == -1) *id = ir_generate_label_id(IR_NAME_PROC, st_proc_id);
+	return *id;
 }
 
-int ir_generate_literal(const char *lexical) {
-	const char *format = ".LITERAL_%s";
+int ir_inline_pass(ir_builder_t *builder) {
+	ir_t *list = builder->list;
+	int len = builder->len - 1;	// without OP_END
+	int labels_len = list[len].arg1_id;
+
+	ir_proc_t *procs = mem_malloc(MEM_IR, labels_len * sizeof(ir_proc_t));
+	int *label_map = mem_malloc(MEM_IR, labels_len * sizeof(int));
+	if (labels_len > 0 && (procs == NULL || label_map == NULL)) {
+		perror("something went wrong with malloc in ir_inline_pass");
+		exit(1);
+	}
+	for (int i = 0; i < labels_len; i++) {
+		procs[i] = (ir_proc_t) {.start = -1, .len = 0, .calls = 0};
+		label_map[i] = -1;
+	}
+
+	// a body runs from its OP_PROC to the OP_RET right before the end label
+	int inlinable = 0;
+	for (int i = 0; i < len; i++) {
+		if (list[i].op == OP_CALL) procs[list[i].res_id].calls++;
+	}
+	for (int i = 0; i < len; i++) {
+		if (list[i].op != OP_PROC) continue;
+
+		int leaf = 1;
+		int end = i + 1;
+		while (list[end].op != OP_LABEL || list[end].res_id != list[i].arg1_id) {
+			if (list[end].op == OP_CALL || list[end].op == OP_PROC) leaf = 0;
+			end++;
+		}
+
+		ir_proc_t *proc = &procs[list[i].res_id];
+		proc->len = end - i - 2;
+		if (leaf && (proc->len <= IR_INLINE_MAX || proc->calls == 1)) {
+			proc->start = i;
+			inlinable = 1;
+		}
+		i = end;
+	}
+	if (!inlinable) {
+		mem_free(MEM_IR, procs);
+		mem_free(MEM_IR, label_map);
+		return 0;
+	}
+
+	ir_builder_t out;
+	ir_builder_init(&out);
+	ir_builder_reserve(&out, builder->len);
+
+	int inlined = 0;
+	for (int i = 0; i < len; i++) {
+		ir_t ir = list[i];
+		if (ir.op == OP_PROC && procs[ir.res_id].start != -1) {
+			// every call is inlined, so the procedure itself is dropped
+			i += procs[ir.res_id].len + 2;
+			continue;
+		}
+		if (ir.op != OP_CALL || procs[ir.res_id].start == -1) {
+			ir_inline_emit(&out, ir, ir_builder_pos(builder, i));
+			continue;
+		}
+
+		// labels of the body get fresh ids for every copy
+		ir_proc_t proc = procs[ir.res_id];
+		ir_t *body = list + proc.start + 1;
+		for (int j = 0; j < proc.len; j++) {
+			if (body[j].op == OP_LABEL) {
+				label_map[body[j].res_id] = ir_inline_new_label(builder, &labels_len);
+			}
+		}
 
-	int length = snprintf(NULL, 0, format, lexical);
-	char *postfix_lexical = malloc((length + 1) * sizeof(char));
-	sprintf(postfix_lexical, format, lexical);
+		int after_label = -1;
+		for (int j = 0; j < proc.len; j++) {
+			ir_t copy = body[j];
+			switch (copy.op) {
+			case OP_LABEL:
+			case OP_JMP:
+			case OP_JMP_TRUE:
+			case OP_JMP_FALSE:
+				if (label_map[copy.res_id] != -1) copy.res_id = label_map[copy.res_id];
+				break;
+			case OP_RET:
+				// an early return leaves the copy
+				if (after_label == -1) after_label = ir_inline_new_label(builder, &labels_len);
+				copy = (ir_t) {.op = OP_JMP, .res_id = after_label};
+				break;
+			}
+			ir_inline_emit(&out, copy, ir_builder_pos(builder, proc.start + 1 + j));
+		}
+		if (after_label != -1) {
+			ir_inline_emit(&out, (ir_t) {.op = OP_LABEL, .res_id = after_label}, ir_builder_pos(builder, i));
+		}
 
-	if (st_check_var(postfix_lexical).id == -1) {
-		int type_id = st_check_type("int").id;
-		st_create_var(postfix_lexical, type_id);
+		for (int j = 0; j < proc.len; j++) {
+			if (body[j].op == OP_LABEL) label_map[body[j].res_id] = -1;
+		}
+		inlined++;
 	}
-	int id = st_check_var(postfix_lexical).id;
+	ir_inline_emit(&out, (ir_t) {.op = OP_END, .res_id = list[len].res_id, .arg1_id = labels_len},
+		ir_builder_pos(builder, len));
 
-	free(postfix_lexical);
+	mem_free(MEM_IR, procs);
+	mem_free(MEM_IR, label_map);
+	mem_free(MEM_IR, builder->list);
+	mem_free(MEM_IR, builder->positions);
+	builder->list = out.list;
+	builder->len = out.len;
+	builder->cap = out.cap;
+	builder->positions = out.positions;
+	builder->positions_len = out.positions_len;
+	builder->positions_cap = out.positions_cap;
+	return inlined;
+}
 
-	return id;
+void ir_inline_emit(ir_builder_t *out, ir_t ir, ir_pos_t pos) {
+	ir_builder_mark(out, pos.start, pos.end);
+	ir_builder_reserve(out, 1);
+	out->list[out->len++] = ir;
 }
 
+int ir_inline_new_label(ir_builder_t *builder, int *labels_len) {
+	if (builder->debug) {
+		ir_set_name(&builder->label_names, &builder->label_names_cap, *labels_len,
+			IR_NAME_INLINE_LABEL, *labels_len);
+	}
+	return (*labels_len)++;
+}
@@ -1,4 +1,6 @@
 #include "lexer.h"
+#include "mem.h"
+#include "intern.h"
 #include "pos.h"
 #include "token.h"
 #include "error.h"
@@ -18,17 +20,43 @@ static int g_src_len;
 static pos_t g_start, g_end;
 static token_t *g_tokens;
 static int g_tokens_cap, g_tokens_len;
+static int g_token_count;	// tokens handed out by lexer_stream_next
+static token_t g_token;
+static int g_has_token;
+static int g_sym_id;
 static int g_has_error;
 static const char *g_error_message;
 
-void lexer_init(const char *filepath, const char *src);
+void lexer_init(const char *filepath, const char *src, int src_len);
 char lexer_eof();
 char lexer_current();
 void lexer_next();
 int lexer_get_token();
 int lexer_add_token(int token_type);
+void lexer_append_token(token_t token);
 int lexer_keyword_type();
 
+static struct {
+	const char *name;
+	int type;
+	int sym_id;
+} g_keywords[] = {
+	{"var", TT_VAR_KEYWORD, -1},
+	{"if", TT_IF_KEYWORD, -1},
+	{"else", TT_ELSE_KEYWORD, -1},
+	{"goto", TT_GOTO_KEYWORD, -1},
+	{"print", TT_PRINT_KEYWORD, -1},
+	{"while", TT_WHILE_KEYWORD, -1},
+	{"for", TT_FOR_KEYWORD, -1},
+	{"switch", TT_SWITCH_KEYWORD, -1},
+	{"case", TT_CASE_KEYWORD, -1},
+	{"default", TT_DEFAULT_KEYWORD, -1},
+	{"proc", TT_PROC_KEYWORD, -1},
+	{"call", TT_CALL_KEYWORD, -1},
+	{"return", TT_RETURN_KEYWORD, -1},
+};
+static const int g_keywords_len = sizeof(g_keywords) / sizeof(g_keywords[0]);
+
 int lexer_error_check();
 void lexer_error_set(const char *message);
 void lexer_error_print();
@@ -38,47 +66,86 @@ void lexer_error_clear();
 // lexer.h - definition
 // ========================================
 
-token_t *tokenize(const char *filepath, const char *src) {
-	lexer_init(filepath, src);
+token_t *tokenize(const char *filepath, const char *src, int src_len) {
+	lexer_stream_init(filepath, src, src_len);
+
+	for (;;) {
+		token_t token = lexer_stream_next();
+		lexer_append_token(token);
+		if (token.type == TT_EOF) break;
+	}
+
+	if (lexer_error_check()) {
+		lexer_error_print();
+		lexer_error_clear();
+		mem_free(MEM_LEXER, g_tokens);
+		return NULL;
+	}
+
+	return g_tokens;
+}
+
+void lexer_stream_init(const char *filepath, const char *src, int src_len) {
+	lexer_init(filepath, src, src_len);
+}
 
-	int has_error = 0;
-	while (!lexer_eof()) {
+token_t lexer_stream_next() {
+	while (!lexer_eof() && !lexer_error_check()) {
+		g_has_token = 0;
+		g_sym_id = -1;
 		lexer_get_token();
 
-		if (lexer_error_check()) {
-			lexer_error_print();
-			lexer_error_clear();
-			has_error = 1;
-			break;
+		if (g_has_token && !lexer_error_check()) {
+			g_token_count++;
+			return g_token;
 		}
 	}
+
+	// on error the EOF token covers the offending characters
+	if (!lexer_error_check()) g_start = g_end;
+	g_sym_id = -1;
 	lexer_add_token(TT_EOF);
+	g_token_count++;
+	return g_token;
+}
 
-	if (has_error) {
-		free(g_tokens);
-		return NULL;
-	}
+const char *lexer_stream_error() {
+	if (!lexer_error_check()) return NULL;
+	return g_error_message;
+}
 
-	return g_tokens;
+int lexer_token_count() {
+	return g_token_count;
+}
+
+void lexer_free_tokens(token_t *tokens) {
+	mem_free(MEM_LEXER, tokens);
 }
 
 // ========================================
 // helper definition
 // ========================================
 
-void lexer_init(const char *filepath, const char *src) {
+void lexer_init(const char *filepath, const char *src, int src_len) {
 	g_filepath = filepath;
 	g_src = src;
-	g_src_len = strlen(src);
+	g_src_len = src_len;
 	g_start = g_end = (pos_t) {.line = 1, .column = 1, .index = 0};
 	g_tokens = NULL;
 	g_tokens_cap = g_tokens_len = 0;
+	g_token_count = 0;
+	g_has_token = 0;
+	g_sym_id = -1;
 	g_has_error = 0;
 	g_error_message = NULL;
+
+	for (int i = 0; i < g_keywords_len; i++) {
+		g_keywords[i].sym_id = intern(g_keywords[i].name, strlen(g_keywords[i].name));
+	}
 }
 
 char lexer_eof() {
-	return lexer_current() == 0;
+	return g_end.index >= g_src_len;
 }
 
 char lexer_current() {
@@ -121,6 +188,9 @@ int lexer_get_token() {
 	else if (ch == ';') {
 		return lexer_add_token(TT_SEMICOLON);
 	}
+	else if (ch == ',') {
+		return lexer_add_token(TT_COMMA);
+	}
 	else if (ch == '?') {
 		return lexer_add_token(TT_QUESTION);
 	}
@@ -130,6 +200,18 @@ int lexer_get_token() {
 	else if (ch == ')') {
 		return lexer_add_token(TT_RPAREN);
 	}
+	else if (ch == '{') {
+		return lexer_add_token(TT_LBRACE);
+	}
+	else if (ch == '}') {
+		return lexer_add_token(TT_RBRACE);
+	}
+	else if (ch == '[') {
+		return lexer_add_token(TT_LBRACKET);
+	}
+	else if (ch == ']') {
+		return lexer_add_token(TT_RBRACKET);
+	}
 	else if (ch == '=') {
 		int token_type = TT_EQUAL;
 		if (lexer_match('=')) token_type = TT_EQUAL_EQUAL;
@@ -138,15 +220,19 @@ int lexer_get_token() {
 	else if (ch == '|') {
 		int token_type = TT_PIPE;
 		if (lexer_match('|')) token_type = TT_LOGICAL_OR;
+		else if (lexer_match('=')) token_type = TT_PIPE_EQUAL;
 		return lexer_add_token(token_type);
 	}
 	else if (ch == '&') {
 		int token_type = TT_AMPERSAND;
 		if (lexer_match('&')) token_type = TT_LOGICAL_AND;
+		else if (lexer_match('=')) token_type = TT_AMPERSAND_EQUAL;
 		return lexer_add_token(token_type);
 	}
 	else if (ch == '^') {
-		return lexer_add_token(TT_CARET);
+		int token_type = TT_CARET;
+		if (lexer_match('=')) token_type = TT_CARET_EQUAL;
+		return lexer_add_token(token_type);
 	}
 	else if (ch == '!') {
 		int token_type = TT_BANG;
@@ -156,33 +242,41 @@ int lexer_get_token() {
 	else if (ch == '<') {
 		int token_type = TT_LESSER;
 		if (lexer_match('=')) token_type = TT_LESSER_EQUAL;
-		else if (lexer_match('<')) token_type = TT_LSHIFT;
+		else if (lexer_match('<')) token_type = lexer_match('=') ? TT_LSHIFT_EQUAL : TT_LSHIFT;
 		return lexer_add_token(token_type);
 	}
 	else if (ch == '>') {
 		int token_type = TT_GREATER;
 		if (lexer_match('=')) token_type = TT_GREATER_EQUAL;
-		else if (lexer_match('>')) token_type = TT_RSHIFT;
+		else if (lexer_match('>')) token_type = lexer_match('=') ? TT_RSHIFT_EQUAL : TT_RSHIFT;
 		return lexer_add_token(token_type);
 	}
 	else if (ch == '+') {
 		int token_type = TT_PLUS;
 		if (lexer_match('+')) token_type = TT_PLUS_PLUS;
+		else if (lexer_match('=')) token_type = TT_PLUS_EQUAL;
 		return lexer_add_token(token_type);
 	}
 	else if (ch == '-') {
 		int token_type = TT_MINUS;
 		if (lexer_match('-')) token_type = TT_MINUS_MINUS;
+		else if (lexer_match('=')) token_type = TT_MINUS_EQUAL;
 		return lexer_add_token(token_type);
 	}
 	else if (ch == '*') {
-		return lexer_add_token(TT_STAR);
+		int token_type = TT_STAR;
+		if (lexer_match('=')) token_type = TT_STAR_EQUAL;
+		return lexer_add_token(token_type);
 	}
 	else if (ch == '/') {
-		return lexer_add_token(TT_FSLASH);
+		int token_type = TT_FSLASH;
+		if (lexer_match('=')) token_type = TT_FSLASH_EQUAL;
+		return lexer_add_token(token_type);
 	}
 	else if (ch == '%') {
-		return lexer_add_token(TT_MOD);
+		int token_type = TT_MOD;
+		if (lexer_match('=')) token_type = TT_MOD_EQUAL;
+		return lexer_add_token(token_type);
 	}
 	else if (ch == '~') {
 		return lexer_add_token(TT_TILDE);
@@ -209,34 +303,42 @@ int lexer_get_token() {
 }
 
 int lexer_add_token(int token_type) {
-	if (g_tokens_cap <= g_tokens_len) {
-		g_tokens_cap = (g_tokens_cap + 1) * 2;
-		g_tokens = realloc(g_tokens, g_tokens_cap * sizeof(token_t));
-		if (g_tokens == NULL) {
-			perror("Error while realloc in lexer_add_token");
-			exit(1);
-		}
-	}
-	g_tokens[g_tokens_len] = (token_t) {
+	g_token = (token_t) {
 		.type = token_type,
 		.start = g_start,
 		.end = g_end,
 		.filepath = g_filepath,
 		.src = g_src,
+		.sym_id = g_sym_id,
 	};
-	g_tokens_len++;
+	g_has_token = 1;
 	return token_type;
 }
 
+void lexer_append_token(token_t token) {
+	if (g_tokens_cap <= g_tokens_len) {
+		g_tokens_cap = (g_tokens_cap + 1) * 2;
+		g_tokens = mem_realloc(MEM_LEXER, g_tokens, g_tokens_cap * sizeof(token_t));
+		if (g_tokens == NULL) {
+			perror("Error while realloc in lexer_append_token");
+			exit(1);
+		}
+	}
+	g_tokens[g_tokens_len] = token;
+	g_tokens_len++;
+}
+
 int lexer_keyword_type() {
 	const char *start = g_src + g_start.index;
 	int len = g_end.index - g_start.index;
 
-	if (strlen("var") == len && strncmp(start, "var", len) == 0) return TT_VAR_KEYWORD;
-	if (strlen("if") == len && strncmp(start, "if", len) == 0) return TT_IF_KEYWORD;
-	if (strlen("else") == len && strncmp(start, "else", len) == 0) return TT_ELSE_KEYWORD;
-	if (strlen("goto") == len && strncmp(start, "goto", len) == 0) return TT_GOTO_KEYWORD;
-	if (strlen("print") == len && strncmp(start, "print", len) == 0) return TT_PRINT_KEYWORD;
+	g_sym_id = intern(start, len);
+	for (int i = 0; i < g_keywords_len; i++) {
+		if (g_keywords[i].sym_id == g_sym_id) {
+			g_sym_id = -1;
+			return g_keywords[i].type;
+		}
+	}
 
 	return TT_IDENTIFIER;
 }
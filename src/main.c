@@ -1,20 +1,43 @@
+#include <fcntl.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include "intern.h"
 #include "lexer.h"
+#include "mem.h"
 #include "parser.h"
 #include "analyzer.h"
 #include "ir.h"
+#include "profile.h"
+#include "sample.h"
+#include "sched.h"
 #include "st.h"
+#include "stats.h"
 #include "vm.h"
 
 // ========================================
 // helper declaration
 // ========================================
 
+typedef struct {
+	char *data;
+	int len;
+	int mapped;	// data is a memory mapping of the file instead of a malloc buffer
+} file_t;
+
 void usage(FILE *fd);
-char *read_file(const char *filepath);
+file_t read_file(const char *filepath);
+int map_file(const char *filepath, file_t *file);
+void close_file(file_t file);
+ir_t *compile_stream(ir_builder_t *builder, const char *filepath, const char *src, int src_len);
+void print_mem_stats();
+int run_scheduled(const char **filepaths, int len, int workers, long long slice, long long max_steps,
+	int inline_flag, int stats_flag);
 
 // ========================================
 // main definition
@@ -25,6 +48,16 @@ int main(int argc, const char **argv) {
 	int usage_flag = 0;
 	const char *output_file = "a.out";
 	int lexer_flag = 0, parser_flag = 0, ir_flag = 0;
+	int pipeline_flag = 0;
+	int inline_flag = 1;
+	int stats_flag = 0, stats_json_flag = 0;
+	int profile_flag = 0;
+	int mem_stats_flag = 0;
+	const char *sample_file = NULL;
+	int sample_period = SAMPLE_PERIOD;
+	long long max_steps = VM_UNLIMITED;
+	int workers = 0;
+	long long slice = SCHED_SLICE;
 	while (index < argc) {
 		if (strcmp("--help", argv[index]) == 0 ||
 			strcmp("-h", argv[index]) == 0) {
@@ -48,6 +81,65 @@ int main(int argc, const char **argv) {
 		else if (strcmp("--only-ir", argv[index]) == 0) {
 			ir_flag = 1;
 		}
+		else if (strcmp("--pipeline", argv[index]) == 0) {
+			pipeline_flag = 1;
+		}
+		else if (strcmp("--no-inline", argv[index]) == 0) {
+			inline_flag = 0;
+		}
+		else if (strcmp("--stats", argv[index]) == 0) {
+			stats_flag = 1;
+		}
+		else if (strcmp("--stats-json", argv[index]) == 0) {
+			stats_json_flag = 1;
+		}
+		else if (strcmp("--mem-stats", argv[index]) == 0) {
+			mem_stats_flag = 1;
+		}
+		else if (strcmp("--profile", argv[index]) == 0) {
+			profile_flag = 1;
+		}
+		else if (strcmp("--sample", argv[index]) == 0) {
+			index++;
+			if (index >= argc) {
+				fprintf(stderr, "ERROR: Expected filepath after --sample flag\n");
+				usage(stderr);
+				return 1;
+			}
+			sample_file = argv[index];
+		}
+		else if (strcmp("--sample-period", argv[index]) == 0) {
+			index++;
+			if (index >= argc || (sample_period = atoi(argv[index])) <= 0) {
+				fprintf(stderr, "ERROR: Expected a positive number after --sample-period flag\n");
+				usage(stderr);
+				return 1;
+			}
+		}
+		else if (strcmp("--max-steps", argv[index]) == 0) {
+			index++;
+			if (index >= argc || (max_steps = atoll(argv[index])) <= 0) {
+				fprintf(stderr, "ERROR: Expected a positive number after --max-steps flag\n");
+				usage(stderr);
+				return 1;
+			}
+		}
+		else if (strcmp("--workers", argv[index]) == 0) {
+			index++;
+			if (index >= argc || (workers = atoi(argv[index])) <= 0) {
+				fprintf(stderr, "ERROR: Expected a positive number after --workers flag\n");
+				usage(stderr);
+				return 1;
+			}
+		}
+		else if (strcmp("--slice", argv[index]) == 0) {
+			index++;
+			if (index >= argc || (slice = atoll(argv[index])) <= 0) {
+				fprintf(stderr, "ERROR: Expected a positive number after --slice flag\n");
+				usage(stderr);
+				return 1;
+			}
+		}
 		else break;
 		index++;
 	}
@@ -63,15 +155,61 @@ int main(int argc, const char **argv) {
 		return 1;
 	}
 
-	const char *filepath = argv[index];
-	char *src = read_file(filepath);
+	if (profile_flag && sample_file) {
+		fprintf(stderr, "ERROR: --profile and --sample can't be used together\n");
+		usage(stderr);
+		return 1;
+	}
 
-	token_t *tokens = tokenize(filepath, src);
-	if (tokens == NULL) {
-		exit(1);
+	// inlined procedures lose their OP_PROC and their labels are renamed, so
+	// the profile would drop them from the per-label report and the samples
+	// from the stacks; both tools run the program with inlining turned off
+	if (profile_flag || sample_file) {
+		inline_flag = 0;
+	}
+
+	if (workers && (lexer_flag || parser_flag || ir_flag || pipeline_flag || profile_flag || sample_file ||
+		stats_json_flag)) {
+		fprintf(stderr, "ERROR: --workers can't be used with --only-*, --pipeline, --profile, --sample "
+			"or --stats-json\n");
+		usage(stderr);
+		return 1;
+	}
+
+	if (mem_stats_flag && !mem_tracking()) {
+		fprintf(stderr, "ERROR: --mem-stats needs a build with SMOL_MEMSTATS (make memstats)\n");
+		return 1;
+	}
+
+	if (stats_flag || stats_json_flag) {
+		stats_enable();
 	}
 
+	// printed on every exit, so a run stopped by an error still reports
+	if (mem_stats_flag) {
+		atexit(print_mem_stats);
+	}
+
+	if (workers) {
+		return run_scheduled(argv + index, argc - index, workers, slice, max_steps, inline_flag, stats_flag);
+	}
+
+	const char *filepath = argv[index];
+	double start = stats_now();
+	file_t file = read_file(filepath);
+	stats_add_time(STATS_READ_FILE, start);
+	stats_set(STATS_BYTES, file.len);
+	const char *src = file.data;
+
+	// identifiers are interned while lexing
+	intern_init();
+
 	if (lexer_flag) {
+		token_t *tokens = tokenize(filepath, src, file.len);
+		if (tokens == NULL) {
+			exit(1);
+		}
+
 		for (token_t *cur = tokens; cur->type != TT_EOF; cur++) {
 			printf("%s | '%.*s'\n", token_type_str(*cur), 
 				cur->end.index - cur->start.index, cur->src + cur->start.index);
@@ -79,43 +217,153 @@ int main(int argc, const char **argv) {
 		return 0;
 	}
 
-	ast_t *ast = parse(tokens);
-	if (ast == NULL) {
-		exit(1);
-	}
-	if (parser_flag) {
-		ast_print(ast);
-		return 0;
+	ir_builder_t builder;
+	ir_builder_init(&builder);
+	builder.debug = ir_flag || profile_flag || sample_file;	// names for print_ir, --profile and --sample
+
+	ir_t *ir_list = NULL;
+	if (pipeline_flag && !parser_flag) {
+		// initialize the symbol table
+		st_init();
+		st_create_type("int");
+		st_create_type("int[]");
+		st_create_type("i64");
+		st_create_type("bigint");
+
+		ir_list = compile_stream(&builder, filepath, src, file.len);
+		if (ir_list == NULL) {
+			exit(1);
+		}
 	}
+	else {
+		ast_t *ast = NULL;
+		if (stats_flag || stats_json_flag) {
+			// the lexer runs as its own pass so its time can be told apart from the parser
+			start = stats_now();
+			token_t *tokens = tokenize(filepath, src, file.len);
+			stats_add_time(STATS_TOKENIZE, start);
+			if (tokens == NULL) {
+				exit(1);
+			}
+
+			start = stats_now();
+			ast = parse(tokens);
+			stats_add_time(STATS_PARSE, start);
+			lexer_free_tokens(tokens);
+		}
+		else {
+			ast = parse_stream(filepath, src, file.len);
+		}
+		if (ast == NULL) {
+			exit(1);
+		}
+		if (parser_flag) {
+			ast_print(ast);
+			return 0;
+		}
 
-	// initialize the symbol table
-	st_init();
-	st_create_type("int");
+		// initialize the symbol table
+		st_init();
+		st_create_type("int");
+		st_create_type("int[]");
+		st_create_type("i64");
+		st_create_type("bigint");
 
-	int error = analyze(ast);
-	if (error) {
-		exit(1);
+		start = stats_now();
+		int error = analyze(ast);
+		stats_add_time(STATS_ANALYZE, start);
+		if (error) {
+			exit(1);
+		}
+
+		start = stats_now();
+		ir_list = generate_ir(&builder, ast);
+		stats_add_time(STATS_GENERATE_IR, start);
+		if (ir_list == NULL) {
+			exit(1);
+		}
+
+		// the ir does not point into the ast
+		ast_free(ast);
 	}
 
-	ir_t *ir_list = generate_ir(ast);
-	if (ir_list == NULL) {
-		exit(1);
+	if (inline_flag) {
+		start = stats_now();
+		ir_list = ir_inline(&builder);
+		stats_add_time(STATS_GENERATE_IR, start);
 	}
+
 	if (ir_flag) {
-		print_ir(ir_list);
+		print_ir(&builder);
 		return 0;
 	}
 
-	vm_run(ir_list);
+	long long *hits = NULL, *taken = NULL;
+	if (profile_flag) {
+		hits = calloc(builder.len, sizeof(long long));
+		taken = calloc(builder.len, sizeof(long long));
+		if (hits == NULL || taken == NULL) {
+			perror("something went wrong with calloc in main");
+			exit(1);
+		}
+		vm_profile(hits, taken);
+	}
+	if (sample_file) {
+		sample_init(&builder);
+		vm_sample(sample_period);
+	}
 
-	free(ir_list);
+	vm_t vm;
+	vm_init(&vm, ir_list);
+	vm_set_source(&vm, &builder, filepath, src);
+	start = stats_now();
+	if (vm_exec(&vm, max_steps) == VM_PAUSED) {
+		fflush(stdout);
+		vm_step_limit(&vm, max_steps);
+	}
+	stats_add_time(STATS_VM_RUN, start);
+	vm_free(&vm);
+
+	stats_set(STATS_TOKENS, lexer_token_count());
+	stats_set(STATS_AST_NODES, ast_count());
+	stats_set(STATS_SYMBOLS, st_count());
+	stats_set(STATS_IR_INSTRUCTIONS, builder.len);
+	stats_set(STATS_EXECUTED, vm.executed);
+	// keep the output of the program ahead of the stats
+	fflush(stdout);
+	if (stats_flag) {
+		stats_print(stderr);
+	}
+	if (stats_json_flag) {
+		stats_print_json(stderr);
+	}
+	if (profile_flag) {
+		profile_print(stderr, &builder, hits, taken, src, file.len);
+		vm_profile(NULL, NULL);
+		free(hits);
+		free(taken);
+	}
+	if (sample_file) {
+		FILE *fd = fopen(sample_file, "w");
+		if (fd == NULL) {
+			char buffer[1024] = {};
+			snprintf(buffer, 1024, "Error opening '%s'", sample_file);
+			perror(buffer);
+			exit(1);
+		}
+		sample_print(fd);
+		fclose(fd);
+		vm_sample(0);
+		sample_free();
+	}
+
+	ir_builder_free(&builder);
 
 	st_free();
 
-	ast_free(ast);
+	close_file(file);
 
-	free(src);
-	free(tokens);
+	intern_free();
 
 	return 0;
 }
@@ -133,13 +381,36 @@ void usage(FILE *fd) {
 	fprintf(fd, "        --only-lexer               Print only the output of lexer\n");
 	fprintf(fd, "        --only-parser              Print only the output of parser\n");
 	fprintf(fd, "        --only-ir                  Print only the output of ir generator\n");
+	fprintf(fd, "        --pipeline                 Parse, analyze and generate ir one statement at a time\n");
+	fprintf(fd, "        --no-inline                Keep every procedure call instead of inlining small ones\n");
+	fprintf(fd, "        --stats                    Print the time of every phase and some counters to stderr\n");
+	fprintf(fd, "        --stats-json               Print the same stats as one JSON object to stderr\n");
+	fprintf(fd, "        --mem-stats                Print the memory used by every subsystem to stderr at exit\n");
+	fprintf(fd, "                                   (needs a build with SMOL_MEMSTATS)\n");
+	fprintf(fd, "        --max-steps <n>            Stop with an error once about n instructions have run\n");
+	fprintf(fd, "        --workers <n>              Run every given file on n threads, time-sliced\n");
+	fprintf(fd, "        --slice <n>                Instructions a program runs per turn with --workers (default %d)\n",
+		SCHED_SLICE);
+	fprintf(fd, "        --profile                  Count every executed instruction and print the hottest\n");
+	fprintf(fd, "                                   lines, instructions, labels and jumps to stderr\n");
+	fprintf(fd, "                                   (turns inlining off, like --no-inline)\n");
+	fprintf(fd, "        --sample <filename>        Write folded stacks of the run for flame graph tools\n");
+	fprintf(fd, "                                   (turns inlining off, like --no-inline)\n");
+	fprintf(fd, "        --sample-period <n>        Instructions between two samples (default %d)\n", SAMPLE_PERIOD);
 	fprintf(fd, "\n");
 	fprintf(fd, "MORE INFO:\n");
 	fprintf(fd, "        - To read from stdin run as follows './smol -'\n");
+	fprintf(fd, "        - With --workers the output of every file is printed in order once all are done,\n");
+	fprintf(fd, "          and --stats prints the throughput and latency of the scheduler\n");
 	fprintf(fd, "\n");
 }
 
-char *read_file(const char *filepath) {
+file_t read_file(const char *filepath) {
+	file_t file = {};
+	if (strcmp(filepath, "-") != 0 && map_file(filepath, &file)) {
+		return file;
+	}
+
 	FILE *fd = stdin;
 	if (strcmp(filepath, "-") != 0) fd = fopen(filepath, "r");
 	if (fd == NULL) {
@@ -157,7 +428,7 @@ char *read_file(const char *filepath) {
 	}
 
 	for (;;) {
-		int n = fread(buffer, 1, cap - len, fd);
+		int n = fread(buffer + len, 1, cap - len, fd);
 		if (n == 0) {
 			break;
 		}
@@ -173,14 +444,175 @@ char *read_file(const char *filepath) {
 		}
 	}
 
-	buffer = realloc(buffer, len + 1);
-	if (buffer == NULL) {
-		perror("Error with realloc in read_file");
-		exit(1);
-	}
+	// len < cap always holds here, so there is room for the NUL
 	buffer[len] = '\0';
 
 	if (strcmp(filepath, "-") != 0) fclose(fd);
-	return buffer;
+
+	file.data = buffer;
+	file.len = len;
+	file.mapped = 0;
+	return file;
+}
+
+int map_file(const char *filepath, file_t *file) {
+	int fd = open(filepath, O_RDONLY);
+	if (fd < 0) {
+		return 0;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0 || st.st_size >= INT_MAX) {
+		close(fd);
+		return 0;
+	}
+	size_t len = st.st_size;
+
+	// Reserve one extra zero byte behind the file. The lexer only needs the
+	// length, but error_print scans for the NUL at the end of the source.
+	// Anonymous pages are zero filled, and so is the tail of the last page
+	// of a file mapping.
+	char *data = mmap(NULL, len + 1, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (data == MAP_FAILED) {
+		close(fd);
+		return 0;
+	}
+	if (mmap(data, len, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+		munmap(data, len + 1);
+		close(fd);
+		return 0;
+	}
+	madvise(data, len, MADV_SEQUENTIAL);
+	close(fd);
+
+	file->data = data;
+	file->len = len;
+	file->mapped = 1;
+	return 1;
 }
 
+void close_file(file_t file) {
+	if (file.mapped) munmap(file.data, file.len + 1);
+	else free(file.data);
+}
+
+ir_t *compile_stream(ir_builder_t *builder, const char *filepath, const char *src, int src_len) {
+	// only one statement's ast is alive at a time
+	parse_stream_begin(filepath, src, src_len);
+	analyze_begin();
+	ir_begin(builder);
+
+	// the lexer is driven by the parser, so its time is part of the parse
+	stats_skip(STATS_TOKENIZE);
+
+	int error = 0;
+	for (;;) {
+		ast_t *stmt = NULL;
+		double start = stats_now();
+		error = parse_stream_stmt(&stmt);
+		stats_add_time(STATS_PARSE, start);
+		if (error || stmt == NULL) {
+			break;
+		}
+
+		start = stats_now();
+		error = analyze_stmt(stmt);
+		stats_add_time(STATS_ANALYZE, start);
+		if (!error) {
+			start = stats_now();
+			ir_stmt(stmt);
+			stats_add_time(STATS_GENERATE_IR, start);
+		}
+		ast_free(stmt);
+		if (error) {
+			break;
+		}
+	}
+
+	double start = stats_now();
+	ir_t *ir_list = ir_end();
+	stats_add_time(STATS_GENERATE_IR, start);
+	if (analyze_end()) {
+		error = 1;
+	}
+	parse_stream_end();
+
+	if (error) {
+		return NULL;
+	}
+	return ir_list;
+}
+
+void print_mem_stats() {
+	// keep the output of the program ahead of the report
+	fflush(stdout);
+	mem_print(stderr);
+}
+
+int run_scheduled(const char **filepaths, int len, int workers, long long slice, long long max_steps,
+	int inline_flag, int stats_flag) {
+	file_t *files = malloc(len * sizeof(file_t));
+	ir_builder_t *builders = malloc(len * sizeof(ir_builder_t));
+	if (files == NULL || builders == NULL) {
+		perror("something went wrong with malloc in run_scheduled");
+		exit(1);
+	}
+
+	// every program is compiled up front, the compiler state is not shared between threads
+	sched_init(workers, slice, max_steps);
+	for (int i = 0; i < len; i++) {
+		files[i] = read_file(filepaths[i]);
+		intern_init();
+		ast_t *ast = parse_stream(filepaths[i], files[i].data, files[i].len);
+		if (ast == NULL) {
+			exit(1);
+		}
+
+		st_init();
+		st_create_type("int");
+		st_create_type("int[]");
+		st_create_type("i64");
+		st_create_type("bigint");
+		if (analyze(ast)) {
+			exit(1);
+		}
+
+		ir_builder_init(&builders[i]);
+		if (generate_ir(&builders[i], ast) == NULL) {
+			exit(1);
+		}
+		ast_free(ast);
+		if (inline_flag) {
+			ir_inline(&builders[i]);
+		}
+		st_free();
+		intern_free();
+
+		sched_add(&builders[i], filepaths[i], files[i].data);
+	}
+
+	sched_run();
+
+	int failed = 0;
+	for (int i = 0; i < len; i++) {
+		sched_write_output(i, stdout);
+		if (sched_status(i) == SCHED_FAILED) {
+			fflush(stdout);
+			fprintf(stderr, "%s\n", sched_error(i));
+			failed = 1;
+		}
+	}
+	fflush(stdout);
+	if (stats_flag) {
+		sched_print(stderr);
+	}
+
+	sched_free();
+	for (int i = 0; i < len; i++) {
+		ir_builder_free(&builders[i]);
+		close_file(files[i]);
+	}
+	free(builders);
+	free(files);
+	return failed;
+}
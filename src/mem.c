@@ -0,0 +1,124 @@
+#include "mem.h"
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// ========================================
+// helper declaration
+// ========================================
+
+typedef struct {
+	long long allocs;	// successful malloc, calloc and realloc calls
+	long long frees;
+	long long allocated;	// bytes requested over the whole run
+	long long live;
+	long long peak;		// most bytes live at the same time
+} mem_counter_t;
+
+// every block starts with its size, padded so the memory after it stays aligned
+typedef union {
+	size_t size;
+	max_align_t align;
+} mem_header_t;
+
+static mem_counter_t g_counters[MEM_SUBSYSTEMS];
+static long long g_live, g_peak;	// all subsystems together
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;	// vms on several threads share the counters
+
+static const char *g_subsystem_names[MEM_SUBSYSTEMS] = {
+	"lexer",
+	"intern",
+	"parser",
+	"ast",
+	"analyzer",
+	"st",
+	"ir",
+	"vm",
+};
+
+void *mem_track(int subsystem, mem_header_t *header, size_t old_size, size_t size);
+
+// ========================================
+// mem.h - definition
+// ========================================
+
+#ifdef SMOL_MEMSTATS
+
+void *mem_malloc(int subsystem, size_t size) {
+	return mem_track(subsystem, malloc(sizeof(mem_header_t) + size), 0, size);
+}
+
+void *mem_calloc(int subsystem, size_t count, size_t size) {
+	return mem_track(subsystem, calloc(1, sizeof(mem_header_t) + count * size), 0, count * size);
+}
+
+void *mem_realloc(int subsystem, void *ptr, size_t size) {
+	if (ptr == NULL) return mem_malloc(subsystem, size);
+
+	mem_header_t *header = (mem_header_t *) ptr - 1;
+	size_t old_size = header->size;
+	header = realloc(header, sizeof(mem_header_t) + size);
+	if (header == NULL) return NULL;
+	return mem_track(subsystem, header, old_size, size);
+}
+
+void mem_free(int subsystem, void *ptr) {
+	if (ptr == NULL) return;
+
+	mem_header_t *header = (mem_header_t *) ptr - 1;
+	pthread_mutex_lock(&g_lock);
+	g_counters[subsystem].frees++;
+	g_counters[subsystem].live -= header->size;
+	g_live -= header->size;
+	pthread_mutex_unlock(&g_lock);
+	free(header);
+}
+
+#endif // SMOL_MEMSTATS
+
+int mem_tracking() {
+#ifdef SMOL_MEMSTATS
+	return 1;
+#else
+	return 0;
+#endif
+}
+
+void mem_print(FILE *fd) {
+	mem_counter_t total = {};
+	fprintf(fd, "%-8s %12s %12s %14s %14s %14s\n", "memory", "allocs", "frees", "allocated", "peak", "live");
+	for (int i = 0; i < MEM_SUBSYSTEMS; i++) {
+		mem_counter_t counter = g_counters[i];
+		fprintf(fd, "%-8s %12lld %12lld %14lld %14lld %14lld\n", g_subsystem_names[i], counter.allocs,
+			counter.frees, counter.allocated, counter.peak, counter.live);
+		total.allocs += counter.allocs;
+		total.frees += counter.frees;
+		total.allocated += counter.allocated;
+	}
+
+	// the subsystems peak at different times, so the total has its own peak
+	fprintf(fd, "%-8s %12lld %12lld %14lld %14lld %14lld\n", "total", total.allocs, total.frees,
+		total.allocated, g_peak, g_live);
+}
+
+// ========================================
+// helper definition
+// ========================================
+
+void *mem_track(int subsystem, mem_header_t *header, size_t old_size, size_t size) {
+	if (header == NULL) return NULL;
+
+	mem_counter_t *counter = &g_counters[subsystem];
+	header->size = size;
+	pthread_mutex_lock(&g_lock);
+	counter->allocs++;
+	counter->allocated += size;
+	counter->live += (long long) size - (long long) old_size;
+	if (counter->live > counter->peak) counter->peak = counter->live;
+	g_live += (long long) size - (long long) old_size;
+	if (g_live > g_peak) g_peak = g_live;
+	pthread_mutex_unlock(&g_lock);
+	return header + 1;
+}
@@ -1,4 +1,6 @@
 #include "parser.h"
+#include "mem.h"
+#include "lexer.h"
 #include "ast.h"
 #include "token.h"
 #include "pos.h"
@@ -12,8 +14,60 @@
 // helper declaration
 // ========================================
 
-static token_t *g_tokens;
+#define PARSER_RING_SIZE 4	// power of two; parser looks at most one token ahead
+
+static token_t *g_tokens;	// NULL when tokens are pulled from the lexer
 static int g_index;
+static token_t g_ring[PARSER_RING_SIZE];
+static int g_ring_head, g_ring_len;
+
+// Nested constructs are parsed with explicit stacks instead of recursion,
+// so nesting depth is only limited by memory.
+enum {
+	PARSER_FRAME_BINARY,	// operands and infix operators at or above min_prec
+	PARSER_FRAME_UNARY,	// prefix operator waiting for its operand
+	PARSER_FRAME_GROUP,	// '(' waiting for the expression and ')'
+	PARSER_FRAME_INDEX,	// '[' after an array waiting for the index and ']'
+	PARSER_FRAME_CALL,	// '(' after a builtin waiting for the arguments and ')'
+};
+
+enum {
+	PARSER_WAIT_OPERAND,
+	PARSER_WAIT_RIGHT,
+	PARSER_WAIT_MID,
+	PARSER_WAIT_TERNARY_RIGHT,
+};
+
+typedef struct {
+	int kind;
+	int state;	// PARSER_WAIT_* for binary frames
+	int min_prec;
+	token_t token;	// operator, '(' or '['
+	ast_t *left;	// left operand (condition for the ternary operator, array or builtin call)
+	ast_t *mid;
+} parser_frame_t;
+
+enum {
+	PARSER_STMT_IF,		// header parsed, waiting for the if block and else block
+	PARSER_STMT_WHILE,	// header parsed, waiting for the body
+	PARSER_STMT_FOR,	// header parsed, waiting for the body
+	PARSER_STMT_SWITCH,	// header and '{' parsed, waiting for cases, statements and '}'
+	PARSER_STMT_BLOCK,	// '{' waiting for statements and '}'
+};
+
+typedef struct {
+	int kind;
+	token_t token;	// keyword or '{'
+	ast_t *cond;
+	ast_t *init;	// for loops only
+	ast_t *step;	// for loops only
+	ast_t *block;	// if block (NULL while it is being parsed), the switch stmt or the block stmt
+} parser_stmt_frame_t;
+
+static parser_frame_t *g_frames;
+static int g_frames_len, g_frames_cap;
+static parser_stmt_frame_t *g_stmt_frames;
+static int g_stmt_frames_len, g_stmt_frames_cap;
 static int g_has_error;
 static const char *g_error_filepath;
 static const char *g_error_src;
@@ -21,10 +75,20 @@ static pos_t g_error_start, g_error_end;
 static const char *g_error_message;
 
 void parser_init(token_t *token);
+ast_t *parser_run();
+void parser_free();
+token_t parser_pull_token();
+token_t parser_peek_token(int offset);
 token_t parser_current_token();
+int parser_current_type();
 token_t parser_next_token();
 void parser_next();
 
+void parser_push_frame(int kind, int min_prec, token_t token);
+void parser_push_stmt_frame(parser_stmt_frame_t frame);
+void parser_unwind_frames(int base);
+void parser_unwind_stmt_frames(int base);
+
 char parser_error_check();
 void parser_error_print();
 void parser_error_clear();
@@ -36,33 +100,126 @@ ast_t *parser_rule_label_stmt();
 ast_t *parser_rule_var_stmt();
 ast_t *parser_rule_print_stmt();
 ast_t *parser_rule_goto_stmt();
-ast_t *parser_rule_if_stmt();
+ast_t *parser_rule_proc_stmt();
+ast_t *parser_rule_call_stmt();
+ast_t *parser_rule_return_stmt();
+ast_t *parser_rule_compound_stmt();
+int parser_rule_compound_header();
+void parser_rule_case(ast_t *switch_stmt);
+ast_t *parser_rule_paren_cond(token_t keyword, const char *lparen_message, const char *rparen_message);
+ast_t *parser_rule_for_part(int end_type, token_t start, const char *message);
 ast_t *parser_rule_expr_stmt();
 ast_t *parser_rule_expr();
-ast_t *parser_rule_assign();
-ast_t *parser_rule_ternary();
-ast_t *parser_rule_logical_or();
-ast_t *parser_rule_logical_and();
-ast_t *parser_rule_bitwise_or();
-ast_t *parser_rule_bitwise_xor();
-ast_t *parser_rule_bitwise_and();
-ast_t *parser_rule_equality();
-ast_t *parser_rule_relation();
-ast_t *parser_rule_shift();
-ast_t *parser_rule_add();
-ast_t *parser_rule_term();
-ast_t *parser_rule_unary();
-ast_t *parser_rule_group();
 ast_t *parser_rule_primary();
 
+// Binding power of the infix operators, lowest first (see grammar)
+enum {
+	PREC_NONE = 0,
+	PREC_ASSIGN,		// right associative
+	PREC_TERNARY,		// right associative
+	PREC_LOGICAL_OR,
+	PREC_LOGICAL_AND,
+	PREC_BITWISE_OR,
+	PREC_BITWISE_XOR,
+	PREC_BITWISE_AND,
+	PREC_EQUALITY,
+	PREC_RELATION,
+	PREC_SHIFT,
+	PREC_ADD,
+	PREC_TERM,
+};
+
+static const char g_infix_prec[TOTAL_TOKENS] = {
+	[TT_EQUAL] = PREC_ASSIGN,
+	[TT_PLUS_EQUAL] = PREC_ASSIGN,
+	[TT_MINUS_EQUAL] = PREC_ASSIGN,
+	[TT_STAR_EQUAL] = PREC_ASSIGN,
+	[TT_FSLASH_EQUAL] = PREC_ASSIGN,
+	[TT_MOD_EQUAL] = PREC_ASSIGN,
+	[TT_LSHIFT_EQUAL] = PREC_ASSIGN,
+	[TT_RSHIFT_EQUAL] = PREC_ASSIGN,
+	[TT_AMPERSAND_EQUAL] = PREC_ASSIGN,
+	[TT_PIPE_EQUAL] = PREC_ASSIGN,
+	[TT_CARET_EQUAL] = PREC_ASSIGN,
+	[TT_QUESTION] = PREC_TERNARY,
+	[TT_LOGICAL_OR] = PREC_LOGICAL_OR,
+	[TT_LOGICAL_AND] = PREC_LOGICAL_AND,
+	[TT_PIPE] = PREC_BITWISE_OR,
+	[TT_CARET] = PREC_BITWISE_XOR,
+	[TT_AMPERSAND] = PREC_BITWISE_AND,
+	[TT_EQUAL_EQUAL] = PREC_EQUALITY,
+	[TT_BANG_EQUAL] = PREC_EQUALITY,
+	[TT_LESSER] = PREC_RELATION,
+	[TT_LESSER_EQUAL] = PREC_RELATION,
+	[TT_GREATER] = PREC_RELATION,
+	[TT_GREATER_EQUAL] = PREC_RELATION,
+	[TT_LSHIFT] = PREC_SHIFT,
+	[TT_RSHIFT] = PREC_SHIFT,
+	[TT_PLUS] = PREC_ADD,
+	[TT_MINUS] = PREC_ADD,
+	[TT_STAR] = PREC_TERM,
+	[TT_FSLASH] = PREC_TERM,
+	[TT_MOD] = PREC_TERM,
+};
+
+static const char g_prefix_op[TOTAL_TOKENS] = {
+	[TT_BANG] = 1,
+	[TT_TILDE] = 1,
+	[TT_MINUS] = 1,
+	[TT_PLUS] = 1,
+	[TT_MINUS_MINUS] = 1,
+	[TT_PLUS_PLUS] = 1,
+};
+
 // ========================================
 // parser.h - definition
 // ========================================
 
 ast_t *parse(token_t *tokens) {
 	parser_init(tokens);
+	return parser_run();
+}
+
+ast_t *parse_stream(const char *filepath, const char *src, int src_len) {
+	lexer_stream_init(filepath, src, src_len);
+	parser_init(NULL);
+	return parser_run();
+}
+
+void parse_stream_begin(const char *filepath, const char *src, int src_len) {
+	lexer_stream_init(filepath, src, src_len);
+	parser_init(NULL);
+}
+
+int parse_stream_stmt(ast_t **stmt) {
+	*stmt = NULL;
+
+	// a lexer error is reported on the token it was found at, which may be EOF
+	if (parser_current_type() != TT_EOF && !parser_error_check()) {
+		*stmt = parser_rule_stmt();
+	}
+
+	if (parser_error_check()) {
+		parser_error_print();
+		parser_error_clear();
+		return 1;
+	}
 
+	return 0;
+}
+
+void parse_stream_end() {
+	parser_free();
+}
+
+// ========================================
+// helper definition
+// ========================================
+
+ast_t *parser_run() {
 	ast_t *res = parser_rule_prog();
+	parser_free();
+
 	if (parser_error_check()) {
 		parser_error_print();
 		parser_error_clear();
@@ -81,13 +238,19 @@ ast_t *parse(token_t *tokens) {
 	return res;
 }
 
-// ========================================
-// helper definition
-// ========================================
+void parser_free() {
+	mem_free(MEM_PARSER, g_frames);
+	g_frames = NULL;
+	g_frames_len = g_frames_cap = 0;
+	mem_free(MEM_PARSER, g_stmt_frames);
+	g_stmt_frames = NULL;
+	g_stmt_frames_len = g_stmt_frames_cap = 0;
+}
 
 void parser_init(token_t *tokens) {
 	g_tokens = tokens;
 	g_index = 0;
+	g_ring_head = g_ring_len = 0;
 	g_has_error = 0;
 	g_error_filepath = NULL;
 	g_error_src = NULL;
@@ -95,19 +258,98 @@ void parser_init(token_t *tokens) {
 	g_error_message = NULL;
 }
 
+token_t parser_pull_token() {
+	if (g_tokens) {
+		token_t token = g_tokens[g_index];
+		if (token.type != TT_EOF) g_index++;
+		return token;
+	}
+
+	token_t token = lexer_stream_next();
+	const char *message = lexer_stream_error();
+	if (message) {
+		parser_error_set(token.filepath, token.src, token.start, token.end, message);
+	}
+	return token;
+}
+
+token_t parser_peek_token(int offset) {
+	assert(offset < PARSER_RING_SIZE);
+	while (g_ring_len <= offset) {
+		g_ring[(g_ring_head + g_ring_len) & (PARSER_RING_SIZE - 1)] = parser_pull_token();
+		g_ring_len++;
+	}
+	return g_ring[(g_ring_head + offset) & (PARSER_RING_SIZE - 1)];
+}
+
 token_t parser_current_token() {
-	return g_tokens[g_index];
+	return parser_peek_token(0);
+}
+
+int parser_current_type() {
+	if (g_ring_len == 0) parser_peek_token(0);
+	return g_ring[g_ring_head].type;
 }
 
 token_t parser_next_token() {
 	assert(parser_current_token().type != TT_EOF);
-	return g_tokens[g_index+1];
+	return parser_peek_token(1);
 }
 
 void parser_next() {
 	token_t cur = parser_current_token();
 	if (cur.type != TT_EOF) {
-		g_index++;
+		g_ring_head = (g_ring_head + 1) & (PARSER_RING_SIZE - 1);
+		g_ring_len--;
+	}
+}
+
+void parser_push_frame(int kind, int min_prec, token_t token) {
+	if (g_frames_cap <= g_frames_len) {
+		g_frames_cap = (g_frames_cap + 1) * 2;
+		g_frames = mem_realloc(MEM_PARSER, g_frames, g_frames_cap * sizeof(parser_frame_t));
+		if (g_frames == NULL) {
+			perror("something went wrong with realloc in parser_push_frame");
+			exit(1);
+		}
+	}
+	g_frames[g_frames_len++] = (parser_frame_t) {
+		.kind = kind,
+		.state = PARSER_WAIT_OPERAND,
+		.min_prec = min_prec,
+		.token = token,
+		.left = NULL,
+		.mid = NULL,
+	};
+}
+
+void parser_push_stmt_frame(parser_stmt_frame_t frame) {
+	if (g_stmt_frames_cap <= g_stmt_frames_len) {
+		g_stmt_frames_cap = (g_stmt_frames_cap + 1) * 2;
+		g_stmt_frames = mem_realloc(MEM_PARSER, g_stmt_frames, g_stmt_frames_cap * sizeof(parser_stmt_frame_t));
+		if (g_stmt_frames == NULL) {
+			perror("something went wrong with realloc in parser_push_stmt_frame");
+			exit(1);
+		}
+	}
+	g_stmt_frames[g_stmt_frames_len++] = frame;
+}
+
+void parser_unwind_frames(int base) {
+	while (g_frames_len > base) {
+		parser_frame_t *frame = &g_frames[--g_frames_len];
+		ast_free(frame->left);
+		ast_free(frame->mid);
+	}
+}
+
+void parser_unwind_stmt_frames(int base) {
+	while (g_stmt_frames_len > base) {
+		parser_stmt_frame_t *frame = &g_stmt_frames[--g_stmt_frames_len];
+		ast_free(frame->cond);
+		ast_free(frame->init);
+		ast_free(frame->step);
+		ast_free(frame->block);
 	}
 }
 
@@ -124,6 +366,9 @@ void parser_error_clear() {
 }
 
 void parser_error_set(const char *filepath, const char *src, pos_t start, pos_t end, const char *message) {
+	// keep the first error; later ones are usually a consequence of it
+	if (g_has_error) return;
+
 	g_has_error = 1;
 	g_error_filepath = filepath;
 	g_error_src = src;
@@ -159,8 +404,21 @@ ast_t *parser_rule_stmt() {
 		stmt = parser_rule_print_stmt();
 	else if (parser_current_token().type == TT_GOTO_KEYWORD)
 		stmt = parser_rule_goto_stmt();
-	else if (parser_current_token().type == TT_IF_KEYWORD)
-		stmt = parser_rule_if_stmt();
+	else if (parser_current_type() == TT_PROC_KEYWORD)
+		stmt = parser_rule_proc_stmt();
+	else if (parser_current_type() == TT_CALL_KEYWORD)
+		stmt = parser_rule_call_stmt();
+	else if (parser_current_type() == TT_RETURN_KEYWORD)
+		stmt = parser_rule_return_stmt();
+	else if (parser_current_type() == TT_IF_KEYWORD || parser_current_type() == TT_WHILE_KEYWORD ||
+		parser_current_type() == TT_FOR_KEYWORD || parser_current_type() == TT_SWITCH_KEYWORD ||
+		parser_current_type() == TT_LBRACE)
+		stmt = parser_rule_compound_stmt();
+	else if (parser_current_type() == TT_CASE_KEYWORD || parser_current_type() == TT_DEFAULT_KEYWORD) {
+		token_t token = parser_current_token();
+		parser_error_set(token.filepath, token.src, token.start, token.end,
+			"case label outside of a switch statement");
+	}
 	else
 		stmt = parser_rule_expr_stmt();
 
@@ -194,8 +452,47 @@ ast_t *parser_rule_var_stmt() {
 	}
 	parser_next();
 
+	// arrays have a literal length and no initializer; other variables may
+	// name their type and otherwise take the type of the initializer
+	ast_t *type = NULL;
+	ast_t *size = NULL;
 	ast_t *expr = NULL;
-	if (parser_current_token().type == TT_EQUAL) {
+	if (parser_current_token().type == TT_COLON) {
+		parser_next(); // pass ':'
+
+		token_t type_name = parser_current_token();
+		if (type_name.type != TT_IDENTIFIER) {
+			parser_error_set(var_keyword.filepath, var_keyword.src, var_keyword.start, type_name.end,
+				"Expected a type name after ':'");
+			return NULL;
+		}
+		parser_next();
+
+		type = ast_identifier(type_name);
+	}
+
+	if (type == NULL && parser_current_token().type == TT_LBRACKET) {
+		parser_next(); // pass '['
+
+		token_t literal = parser_current_token();
+		if (literal.type != TT_INT_LITERAL) {
+			parser_error_set(var_keyword.filepath, var_keyword.src, var_keyword.start, literal.end,
+				"Expected an integer literal as the array length");
+			return NULL;
+		}
+		parser_next();
+
+		token_t rbracket = parser_current_token();
+		if (rbracket.type != TT_RBRACKET) {
+			parser_error_set(var_keyword.filepath, var_keyword.src, var_keyword.start, rbracket.end,
+				"Expected ']' after the array length");
+			return NULL;
+		}
+		parser_next();
+
+		size = ast_literal(literal);
+	}
+	else if (parser_current_token().type == TT_EQUAL) {
 		parser_next(); // pass next '='
 		
 		expr = parser_rule_expr();
@@ -206,6 +503,8 @@ ast_t *parser_rule_var_stmt() {
 
 	token_t semicolon = parser_current_token();
 	if (semicolon.type != TT_SEMICOLON) {
+		ast_free(type);
+		ast_free(size);
 		ast_free(expr);
 		parser_error_set(var_keyword.filepath, var_keyword.src, var_keyword.start, 
 			semicolon.end, "Expected ';' at the end of 'var' statement");
@@ -213,7 +512,7 @@ ast_t *parser_rule_var_stmt() {
 	}
 	parser_next();
 
-	return ast_var_stmt(var_keyword, name, expr, semicolon);
+	return ast_var_stmt(var_keyword, name, type, size, expr, semicolon);
 }
 
 ast_t *parser_rule_print_stmt() {
@@ -260,407 +559,555 @@ ast_t *parser_rule_goto_stmt() {
 	return ast_goto_stmt(goto_keyword, label, semicolon);
 }
 
-ast_t *parser_rule_if_stmt() {
-	token_t if_keyword = parser_current_token();
-	parser_next();
+ast_t *parser_rule_proc_stmt() {
+	token_t proc_keyword = parser_current_token();
 
-	token_t lparen = parser_current_token();
-	if (lparen.type != TT_LPAREN) {
-		parser_error_set(lparen.filepath, lparen.src, if_keyword.start, lparen.end,
-			"expected '(' after 'if' keyword");
+	// only top level statements are parsed without a statement frame
+	if (g_stmt_frames_len > 0) {
+		parser_error_set(proc_keyword.filepath, proc_keyword.src, proc_keyword.start, proc_keyword.end,
+			"procedures can only be declared at the top level");
 		return NULL;
 	}
 	parser_next();
 
-	ast_t *if_cond = parser_rule_expr();
-	if (parser_error_check()) {
+	token_t name = parser_current_token();
+	if (name.type != TT_IDENTIFIER) {
+		parser_error_set(proc_keyword.filepath, proc_keyword.src, proc_keyword.start, name.end,
+			"Expected an identifier after 'proc' keyword");
 		return NULL;
 	}
+	parser_next();
 
-	token_t rparen = parser_current_token();
-	if (rparen.type != TT_RPAREN) {
-		ast_free(if_cond);
-		parser_error_set(rparen.filepath, lparen.src, if_keyword.start, rparen.end,
-			"expected ')' after if condition");
+	token_t lbrace = parser_current_token();
+	if (lbrace.type != TT_LBRACE) {
+		parser_error_set(lbrace.filepath, lbrace.src, proc_keyword.start, lbrace.end,
+			"expected '{' after procedure name");
 		return NULL;
 	}
-	parser_next();
 
-	ast_t *if_block = parser_rule_stmt();
+	ast_t *body = parser_rule_compound_stmt();
 	if (parser_error_check()) {
-		ast_free(if_cond);
 		return NULL;
 	}
 
-	ast_t *else_block = NULL;
-	token_t else_keyword = parser_current_token();
-	if (else_keyword.type == TT_ELSE_KEYWORD) {
-		parser_next();
-
-		else_block = parser_rule_stmt();
-		if (parser_error_check()) {
-			ast_free(if_cond);
-			return NULL;
-		}
-	}
-
-	return ast_if_stmt(if_keyword, if_cond, if_block, else_block);
+	return ast_proc_stmt(proc_keyword, name, body);
 }
 
-ast_t *parser_rule_expr_stmt() {
-	ast_t *expr = parser_rule_expr();
-	if (expr == NULL) {
+ast_t *parser_rule_call_stmt() {
+	token_t call_keyword = parser_current_token();
+	parser_next();
+
+	token_t name = parser_current_token();
+	if (name.type != TT_IDENTIFIER) {
+		parser_error_set(call_keyword.filepath, call_keyword.src, call_keyword.start,
+			name.end, "Expected identifier after 'call' keyword");
 		return NULL;
 	}
+	parser_next();
 
 	token_t semicolon = parser_current_token();
 	if (semicolon.type != TT_SEMICOLON) {
-		parser_error_set(expr->filepath, expr->src, expr->start, semicolon.end, 
-			"Expected ';' after expression");
-		ast_free(expr);
+		parser_error_set(call_keyword.filepath, call_keyword.src, call_keyword.start,
+			semicolon.end, "expected ';' at the end of 'call' statement");
 		return NULL;
 	}
 	parser_next();
 
-	return ast_expr_stmt(expr, semicolon);
-}
-
-ast_t *parser_rule_expr() {
-	return parser_rule_assign();
+	return ast_call_stmt(call_keyword, name, semicolon);
 }
 
-ast_t *parser_rule_assign() {
-	ast_t *left = parser_rule_ternary();
-	if (left == NULL) {
-		return left;
-	}
-
-	if (parser_current_token().type == TT_EQUAL) {
-		token_t op = parser_current_token();
-		parser_next();
-
-		ast_t *right = parser_rule_assign();
-		if (right == NULL) {
-			ast_free(left);
-			return NULL;
-		}
-
-		left = ast_binary(left, op, right);
-	}
-
-	return left;
-}
+ast_t *parser_rule_return_stmt() {
+	token_t return_keyword = parser_current_token();
+	parser_next();
 
-ast_t *parser_rule_ternary() {
-	ast_t *left = parser_rule_logical_or();
-	if (left == NULL) {
+	token_t semicolon = parser_current_token();
+	if (semicolon.type != TT_SEMICOLON) {
+		parser_error_set(return_keyword.filepath, return_keyword.src, return_keyword.start,
+			semicolon.end, "expected ';' at the end of 'return' statement");
 		return NULL;
 	}
+	parser_next();
 
-	if (parser_current_token().type == TT_QUESTION) {
-		parser_next();
+	return ast_return_stmt(return_keyword, semicolon);
+}
 
-		ast_t *mid = parser_rule_ternary();
-		if (mid == NULL) {
-			ast_free(left);
-			return NULL;
+ast_t *parser_rule_compound_stmt() {
+	// Statements holding other statements (if, while, for, switch and blocks) are
+	// kept on g_stmt_frames; every other statement is parsed by
+	// parser_rule_stmt, which never sees one of them here.
+	int base = g_stmt_frames_len;
+
+	for (;;) {
+		while (parser_rule_compound_header()) {
+			if (parser_error_check()) {
+				parser_unwind_stmt_frames(base);
+				return NULL;
+			}
 		}
 
-		token_t colon = parser_current_token();
-		if (colon.type != TT_COLON) {
-			parser_error_set(colon.filepath, colon.src, left->start, colon.end, 
-				"Expected ':' for ternary operator");
-			ast_free(left);
-			ast_free(mid);
+		// an empty block or case has no statement to hand to its frame
+		ast_t *stmt = NULL;
+		parser_stmt_frame_t *top = &g_stmt_frames[g_stmt_frames_len - 1];
+		if (top->kind == PARSER_STMT_SWITCH && top->block->switch_stmt.len == 0 &&
+			parser_current_type() != TT_RBRACE) {
+			token_t token = parser_current_token();
+			parser_error_set(token.filepath, token.src, top->token.start, token.end,
+				"expected 'case' or 'default' in switch statement");
+			parser_unwind_stmt_frames(base);
 			return NULL;
 		}
-		parser_next();
+		if ((top->kind != PARSER_STMT_BLOCK && top->kind != PARSER_STMT_SWITCH) ||
+			parser_current_type() != TT_RBRACE) {
+			stmt = parser_rule_stmt();
+			if (parser_error_check()) {
+				ast_free(stmt);
+				parser_unwind_stmt_frames(base);
+				return NULL;
+			}
+		}
 
-		ast_t *right = parser_rule_ternary();
-		if (right == NULL) {
-			ast_free(left);
-			ast_free(mid);
-			return NULL;
+		// close every statement that is complete
+		while (g_stmt_frames_len > base) {
+			parser_stmt_frame_t *frame = &g_stmt_frames[g_stmt_frames_len - 1];
+			if (frame->kind == PARSER_STMT_IF) {
+				if (frame->block == NULL) {
+					frame->block = stmt;
+					if (parser_current_type() == TT_ELSE_KEYWORD) {
+						parser_next();
+						break;
+					}
+					stmt = ast_if_stmt(frame->token, frame->cond, frame->block, NULL);
+				}
+				else {
+					stmt = ast_if_stmt(frame->token, frame->cond, frame->block, stmt);
+				}
+			}
+			else if (frame->kind == PARSER_STMT_WHILE) {
+				stmt = ast_while_stmt(frame->token, frame->cond, stmt);
+			}
+			else if (frame->kind == PARSER_STMT_FOR) {
+				stmt = ast_for_stmt(frame->token, frame->init, frame->cond, frame->step, stmt);
+			}
+			else if (frame->kind == PARSER_STMT_SWITCH) {
+				// statements belong to the latest case
+				ast_t *switch_stmt = frame->block;
+				if (stmt) {
+					ast_t *case_stmt = switch_stmt->switch_stmt.cases[switch_stmt->switch_stmt.len - 1];
+					ast_block_stmt_append(case_stmt->case_stmt.body, stmt);
+				}
+				stmt = NULL;
+
+				token_t rbrace = parser_current_token();
+				if (rbrace.type == TT_EOF) {
+					parser_error_set(frame->token.filepath, frame->token.src, frame->token.start,
+						frame->token.end, "expected '}' to close the switch");
+					parser_unwind_stmt_frames(base);
+					return NULL;
+				}
+				if (rbrace.type != TT_RBRACE) {
+					break;
+				}
+				parser_next();
+
+				ast_switch_stmt_close(switch_stmt, rbrace);
+				stmt = switch_stmt;
+			}
+			else {
+				if (stmt) ast_block_stmt_append(frame->block, stmt);
+				stmt = NULL;
+
+				token_t rbrace = parser_current_token();
+				if (rbrace.type == TT_EOF) {
+					parser_error_set(frame->token.filepath, frame->token.src, frame->token.start,
+						frame->token.end, "expected '}' to close the block");
+					parser_unwind_stmt_frames(base);
+					return NULL;
+				}
+				if (rbrace.type != TT_RBRACE) {
+					break;
+				}
+				parser_next();
+
+				ast_block_stmt_close(frame->block, rbrace);
+				stmt = frame->block;
+			}
+			g_stmt_frames_len--;
 		}
 
-		left = ast_ternary(left, mid, right);
+		if (g_stmt_frames_len == base) {
+			return stmt;
+		}
 	}
-
-	return left;
 }
 
-ast_t *parser_rule_logical_or() {
-	ast_t *left = parser_rule_logical_and();
-	if (left == NULL) {
-		return NULL;
-	}
+int parser_rule_compound_header() {
+	token_t token = parser_current_token();
+	parser_stmt_frame_t frame = {.token = token};
 
-	while (parser_current_token().type == TT_LOGICAL_OR) {
-		token_t op = parser_current_token();
+	switch (token.type) {
+	case TT_IF_KEYWORD:
+		parser_next();
+		frame.kind = PARSER_STMT_IF;
+		frame.cond = parser_rule_paren_cond(token, "expected '(' after 'if' keyword",
+			"expected ')' after if condition");
+		break;
+	case TT_WHILE_KEYWORD:
+		parser_next();
+		frame.kind = PARSER_STMT_WHILE;
+		frame.cond = parser_rule_paren_cond(token, "expected '(' after 'while' keyword",
+			"expected ')' after while condition");
+		break;
+	case TT_FOR_KEYWORD: {
 		parser_next();
+		frame.kind = PARSER_STMT_FOR;
 
-		ast_t *right = parser_rule_logical_and();
-		if (right == NULL) {
-			free(left);
-			return NULL;
+		token_t lparen = parser_current_token();
+		if (lparen.type != TT_LPAREN) {
+			parser_error_set(lparen.filepath, lparen.src, token.start, lparen.end,
+				"expected '(' after 'for' keyword");
+			return 1;
 		}
-
-		left = ast_binary(left, op, right);
-	}
-
-	return left;
-}
-
-ast_t *parser_rule_logical_and() {
-	ast_t *left = parser_rule_bitwise_or();
-	if (left == NULL) {
-		return NULL;
-	}
-
-	while (parser_current_token().type == TT_LOGICAL_AND) {
-		token_t op = parser_current_token();
 		parser_next();
 
-		ast_t *right = parser_rule_bitwise_or();
-		if (right == NULL) {
-			free(left);
-			return NULL;
+		frame.init = parser_rule_for_part(TT_SEMICOLON, token, "expected ';' after for initializer");
+		if (!parser_error_check()) {
+			frame.cond = parser_rule_for_part(TT_SEMICOLON, token, "expected ';' after for condition");
 		}
-
-		left = ast_binary(left, op, right);
-	}
-
-	return left;
-}
-
-ast_t *parser_rule_bitwise_or() {
-	ast_t *left = parser_rule_bitwise_xor();
-	if (left == NULL) {
-		return NULL;
+		if (!parser_error_check()) {
+			frame.step = parser_rule_for_part(TT_RPAREN, token, "expected ')' after for step");
+		}
+		if (parser_error_check()) {
+			ast_free(frame.init);
+			ast_free(frame.cond);
+			return 1;
+		}
+		break;
 	}
-
-	while (parser_current_token().type == TT_PIPE) {
-		token_t op = parser_current_token();
+	case TT_SWITCH_KEYWORD: {
 		parser_next();
+		frame.kind = PARSER_STMT_SWITCH;
 
-		ast_t *right = parser_rule_bitwise_xor();
-		if (right == NULL) {
-			free(left);
-			return NULL;
+		ast_t *expr = parser_rule_paren_cond(token, "expected '(' after 'switch' keyword",
+			"expected ')' after switch expression");
+		if (parser_error_check()) {
+			return 1;
 		}
 
-		left = ast_binary(left, op, right);
-	}
-
-	return left;
-}
-
-ast_t *parser_rule_bitwise_xor() {
-	ast_t *left = parser_rule_bitwise_and();
-	if (left == NULL) {
-		return NULL;
-	}
-
-	while (parser_current_token().type == TT_CARET) {
-		token_t op = parser_current_token();
-		parser_next();
-
-		ast_t *right = parser_rule_bitwise_and();
-		if (right == NULL) {
-			free(left);
-			return NULL;
+		token_t lbrace = parser_current_token();
+		if (lbrace.type != TT_LBRACE) {
+			ast_free(expr);
+			parser_error_set(lbrace.filepath, lbrace.src, token.start, lbrace.end,
+				"expected '{' after switch expression");
+			return 1;
 		}
+		parser_next();
 
-		left = ast_binary(left, op, right);
+		frame.block = ast_switch_stmt(token, expr);
+		break;
 	}
-
-	return left;
-}
-
-ast_t *parser_rule_bitwise_and() {
-	ast_t *left = parser_rule_equality();
-	if (left == NULL) {
-		return NULL;
+	case TT_CASE_KEYWORD:
+	case TT_DEFAULT_KEYWORD: {
+		// a case only opens directly inside a switch; elsewhere it is a stray statement
+		parser_stmt_frame_t *top = &g_stmt_frames[g_stmt_frames_len - 1];
+		if (top->kind != PARSER_STMT_SWITCH) {
+			return 0;
+		}
+		parser_rule_case(top->block);
+		return 1;
 	}
-
-	while (parser_current_token().type == TT_AMPERSAND) {
-		token_t op = parser_current_token();
+	case TT_LBRACE:
 		parser_next();
-
-		ast_t *right = parser_rule_equality();
-		if (right == NULL) {
-			free(left);
-			return NULL;
-		}
-
-		left = ast_binary(left, op, right);
+		frame.kind = PARSER_STMT_BLOCK;
+		frame.block = ast_block_stmt(token);
+		break;
+	default:
+		return 0;
 	}
 
-	return left;
+	if (parser_error_check()) {
+		return 1;
+	}
+	parser_push_stmt_frame(frame);
+	return 1;
 }
 
-ast_t *parser_rule_equality() {
-	ast_t *left = parser_rule_relation();
-	if (left == NULL) {
-		return NULL;
-	}
+void parser_rule_case(ast_t *switch_stmt) {
+	token_t case_keyword = parser_current_token();
+	parser_next();
 
-	while (parser_current_token().type == TT_EQUAL_EQUAL || 
-		parser_current_token().type == TT_BANG_EQUAL) {
-		token_t op = parser_current_token();
+	// case values are integer literals, optionally negated
+	ast_t *value = NULL;
+	if (case_keyword.type == TT_CASE_KEYWORD) {
+		token_t minus = parser_current_token();
+		if (minus.type == TT_MINUS) parser_next();
+
+		token_t literal = parser_current_token();
+		if (literal.type != TT_INT_LITERAL) {
+			parser_error_set(literal.filepath, literal.src, case_keyword.start, literal.end,
+				"expected an integer literal after 'case' keyword");
+			return;
+		}
 		parser_next();
 
-		ast_t *right = parser_rule_relation();
-		if (right == NULL) {
-			free(left);
-			return NULL;
-		}
+		value = ast_literal(literal);
+		if (minus.type == TT_MINUS) value = ast_unary(minus, value);
+	}
 
-		left = ast_binary(left, op, right);
+	token_t colon = parser_current_token();
+	if (colon.type != TT_COLON) {
+		ast_free(value);
+		parser_error_set(colon.filepath, colon.src, case_keyword.start, colon.end,
+			"expected ':' after case label");
+		return;
 	}
+	parser_next();
 
-	return left;
+	ast_switch_stmt_append(switch_stmt, ast_case_stmt(case_keyword, value, colon));
 }
 
-ast_t *parser_rule_relation() {
-	ast_t *left = parser_rule_shift();
-	if (left == NULL) {
+ast_t *parser_rule_paren_cond(token_t keyword, const char *lparen_message, const char *rparen_message) {
+	token_t lparen = parser_current_token();
+	if (lparen.type != TT_LPAREN) {
+		parser_error_set(lparen.filepath, lparen.src, keyword.start, lparen.end, lparen_message);
 		return NULL;
 	}
+	parser_next();
 
-	while (parser_current_token().type == TT_LESSER ||
-		parser_current_token().type == TT_LESSER_EQUAL ||
-		parser_current_token().type == TT_GREATER ||
-		parser_current_token().type == TT_GREATER_EQUAL) {
-		token_t op = parser_current_token();
-		parser_next();
-
-		ast_t *right = parser_rule_shift();
-		if (right == NULL) {
-			free(left);
-			return NULL;
-		}
-
-		left = ast_binary(left, op, right);
+	ast_t *cond = parser_rule_expr();
+	if (parser_error_check()) {
+		ast_free(cond);
+		return NULL;
 	}
 
-	return left;
-}
-
-ast_t *parser_rule_shift() {
-	ast_t *left = parser_rule_add();
-	if (left == NULL) {
+	token_t rparen = parser_current_token();
+	if (rparen.type != TT_RPAREN) {
+		ast_free(cond);
+		parser_error_set(rparen.filepath, lparen.src, keyword.start, rparen.end, rparen_message);
 		return NULL;
 	}
+	parser_next();
 
-	while (parser_current_token().type == TT_LSHIFT ||
-		parser_current_token().type == TT_RSHIFT) {
-		token_t op = parser_current_token();
-		parser_next();
+	return cond;
+}
 
-		ast_t *right = parser_rule_add();
-		if (right == NULL) {
-			free(left);
+ast_t *parser_rule_for_part(int end_type, token_t start, const char *message) {
+	ast_t *expr = NULL;
+	if (parser_current_type() != end_type) {
+		expr = parser_rule_expr();
+		if (parser_error_check()) {
+			ast_free(expr);
 			return NULL;
 		}
-
-		left = ast_binary(left, op, right);
 	}
 
-	return left;
-}
-
-ast_t *parser_rule_add() {
-	ast_t *left = parser_rule_term();
-	if (left == NULL) {
+	token_t end = parser_current_token();
+	if (end.type != end_type) {
+		ast_free(expr);
+		parser_error_set(end.filepath, end.src, start.start, end.end, message);
 		return NULL;
 	}
+	parser_next();
 
-	while (parser_current_token().type == TT_PLUS || 
-		parser_current_token().type == TT_MINUS) {
-		token_t op = parser_current_token();
-		parser_next();
-
-		ast_t *right = parser_rule_term();
-		if (right == NULL) {
-			free(left);
-			return NULL;
-		}
-
-		left = ast_binary(left, op, right);
-	}
-
-	return left;
+	return expr;
 }
 
-ast_t *parser_rule_term() {
-	ast_t *left = parser_rule_unary();
-	if (left == NULL) {
+ast_t *parser_rule_expr_stmt() {
+	ast_t *expr = parser_rule_expr();
+	if (expr == NULL) {
 		return NULL;
 	}
 
-	while (parser_current_token().type == TT_STAR ||
-		parser_current_token().type == TT_FSLASH ||
-		parser_current_token().type == TT_MOD) {
-		token_t op = parser_current_token();
-		parser_next();
-
-		ast_t *right = parser_rule_unary();
-		if (right == NULL) {
-			free(left);
-			return NULL;
-		}
-
-		left = ast_binary(left, op, right);
+	token_t semicolon = parser_current_token();
+	if (semicolon.type != TT_SEMICOLON) {
+		parser_error_set(expr->filepath, expr->src, expr->start, semicolon.end, 
+			"Expected ';' after expression");
+		ast_free(expr);
+		return NULL;
 	}
+	parser_next();
 
-	return left;
+	return ast_expr_stmt(expr, semicolon);
 }
 
-ast_t *parser_rule_unary() {
-	if (parser_current_token().type == TT_BANG ||
-		parser_current_token().type == TT_TILDE ||
-		parser_current_token().type == TT_MINUS ||
-		parser_current_token().type == TT_PLUS ||
-		parser_current_token().type == TT_MINUS_MINUS ||
-		parser_current_token().type == TT_PLUS_PLUS) {
-		token_t op = parser_current_token();
-		parser_next();
+ast_t *parser_rule_expr() {
+	// Precedence climbing driven by an explicit stack of frames. A binary
+	// frame is one level of climbing: it collects its left operand, then
+	// folds infix operators binding at least min_prec, pushing a new binary
+	// frame for every right operand.
+	int base = g_frames_len;
+	token_t none = {};
+	parser_push_frame(PARSER_FRAME_BINARY, PREC_ASSIGN, none);
+
+	int need_operand = 1;
+	ast_t *value = NULL;
+	for (;;) {
+		if (need_operand) {
+			for (;;) {
+				int type = parser_current_type();
+				if (g_prefix_op[type]) {
+					parser_push_frame(PARSER_FRAME_UNARY, PREC_NONE, parser_current_token());
+					parser_next();
+				}
+				else if (type == TT_LPAREN) {
+					parser_push_frame(PARSER_FRAME_GROUP, PREC_NONE, parser_current_token());
+					parser_next();
+					parser_push_frame(PARSER_FRAME_BINARY, PREC_ASSIGN, none);
+				}
+				else break;
+			}
+
+			value = parser_rule_primary();
+			if (value == NULL) {
+				parser_unwind_frames(base);
+				return NULL;
+			}
+
+			// postfix '[' indexes an array and '(' calls a builtin
+			int type = parser_current_type();
+			if (value->type == AST_IDENTIFIER && type == TT_LBRACKET) {
+				parser_push_frame(PARSER_FRAME_INDEX, PREC_NONE, parser_current_token());
+				g_frames[g_frames_len - 1].left = value;
+				parser_next();
+				parser_push_frame(PARSER_FRAME_BINARY, PREC_ASSIGN, none);
+				continue;
+			}
+			if (value->type == AST_IDENTIFIER && type == TT_LPAREN) {
+				token_t name = value->identifier.token;
+				ast_free(value);
+				value = ast_builtin(name);
+				parser_next();
+
+				token_t rparen = parser_current_token();
+				if (rparen.type != TT_RPAREN) {
+					parser_push_frame(PARSER_FRAME_CALL, PREC_NONE, name);
+					g_frames[g_frames_len - 1].left = value;
+					parser_push_frame(PARSER_FRAME_BINARY, PREC_ASSIGN, none);
+					continue;
+				}
+				parser_next();
+				ast_builtin_close(value, rparen);
+			}
+			need_operand = 0;
+		}
 
-		ast_t *right = parser_rule_unary();
-		if (right == NULL) {
-			return NULL;
+		// hand the finished operand to the innermost frame
+		parser_frame_t *frame = &g_frames[g_frames_len - 1];
+		if (frame->kind == PARSER_FRAME_UNARY) {
+			value = ast_unary(frame->token, value);
+			g_frames_len--;
+			continue;
 		}
 
-		return ast_unary(op, right);
-	}
+		if (frame->kind == PARSER_FRAME_GROUP) {
+			token_t token = parser_current_token();
+			if (token.type != TT_RPAREN) {
+				parser_error_set(token.filepath, token.src, frame->token.start, token.end, 
+					"Expected ')' for grouping");
+				ast_free(value);
+				parser_unwind_frames(base);
+				return NULL;
+			}
+			parser_next();
+			g_frames_len--;
+			continue;
+		}
 
-	return parser_rule_group();
-}
+		if (frame->kind == PARSER_FRAME_INDEX) {
+			token_t token = parser_current_token();
+			if (token.type != TT_RBRACKET) {
+				parser_error_set(token.filepath, token.src, frame->token.start, token.end, 
+					"Expected ']' after the index");
+				ast_free(value);
+				parser_unwind_frames(base);
+				return NULL;
+			}
+			parser_next();
+			value = ast_index(frame->left, value, token);
+			frame->left = NULL;
+			g_frames_len--;
+			continue;
+		}
 
-ast_t *parser_rule_group() {
-	if (parser_current_token().type == TT_LPAREN) {
-		token_t lparen = parser_current_token();
-		parser_next();
+		if (frame->kind == PARSER_FRAME_CALL) {
+			ast_builtin_append(frame->left, value);
+
+			token_t token = parser_current_token();
+			if (token.type == TT_COMMA) {
+				parser_next();
+				parser_push_frame(PARSER_FRAME_BINARY, PREC_ASSIGN, none);
+				need_operand = 1;
+				continue;
+			}
+			if (token.type != TT_RPAREN) {
+				parser_error_set(token.filepath, token.src, frame->token.start, token.end, 
+					"Expected ',' or ')' after the argument");
+				parser_unwind_frames(base);
+				return NULL;
+			}
+			parser_next();
+			ast_builtin_close(frame->left, token);
+			value = frame->left;
+			frame->left = NULL;
+			g_frames_len--;
+			continue;
+		}
 
-		ast_t *res = parser_rule_expr();
-		if (res == NULL) {
-			return NULL;
+		switch (frame->state) {
+		case PARSER_WAIT_OPERAND:
+			frame->left = value;
+			break;
+		case PARSER_WAIT_RIGHT:
+			frame->left = ast_binary(frame->left, frame->token, value);
+			break;
+		case PARSER_WAIT_MID: {
+			frame->mid = value;
+
+			token_t colon = parser_current_token();
+			if (colon.type != TT_COLON) {
+				parser_error_set(colon.filepath, colon.src, frame->left->start, colon.end, 
+					"Expected ':' for ternary operator");
+				parser_unwind_frames(base);
+				return NULL;
+			}
+			parser_next();
+
+			frame->state = PARSER_WAIT_TERNARY_RIGHT;
+			parser_push_frame(PARSER_FRAME_BINARY, PREC_TERNARY, none);
+			need_operand = 1;
+			continue;
+		}
+		case PARSER_WAIT_TERNARY_RIGHT:
+			frame->left = ast_ternary(frame->left, frame->mid, value);
+			frame->mid = NULL;
+			break;
 		}
 
-		token_t token = parser_current_token();
-		if (token.type != TT_RPAREN) {
-			parser_error_set(token.filepath, token.src, lparen.start, token.end, 
-				"Expected ')' for grouping");
-			ast_free(res);
-			return NULL;
+		int prec = g_infix_prec[parser_current_type()];
+		if (prec == PREC_NONE || prec < frame->min_prec) {
+			value = frame->left;
+			g_frames_len--;
+			if (g_frames_len == base) {
+				return value;
+			}
+			continue;
 		}
+
+		if (prec == PREC_TERNARY) {
+			parser_next(); // pass '?'
+			frame->state = PARSER_WAIT_MID;
+			parser_push_frame(PARSER_FRAME_BINARY, PREC_TERNARY, none);
+			need_operand = 1;
+			continue;
+		}
+
+		frame->token = parser_current_token();
+		frame->state = PARSER_WAIT_RIGHT;
 		parser_next();
 
-		return res;
+		// assignment is right associative, everything else binds left
+		parser_push_frame(PARSER_FRAME_BINARY, prec == PREC_ASSIGN ? prec : prec + 1, none);
+		need_operand = 1;
 	}
-
-	return parser_rule_primary();
 }
 
 ast_t *parser_rule_primary() {
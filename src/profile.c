@@ -0,0 +1,210 @@
+#include "profile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// ========================================
+// helper declaration
+// ========================================
+
+#define PROFILE_TOP 10	// rows printed for the hottest lines, instructions and jumps
+
+typedef struct {
+	long long hits;
+	int key;	// line or instruction index the hits belong to
+} profile_row_t;
+
+typedef struct {
+	const char *name;
+	int is_proc;
+	int line;
+	long long hits;		// times the label was reached (calls for a procedure)
+	long long executed;	// instructions executed from the label up to the next one
+} profile_label_t;
+
+void profile_print_lines(FILE *fd, ir_builder_t *builder, const long long *hits, long long total,
+	const char *src, int src_len);
+void profile_print_instructions(FILE *fd, ir_builder_t *builder, const long long *hits);
+void profile_print_labels(FILE *fd, ir_builder_t *builder, const long long *hits);
+void profile_print_jumps(FILE *fd, ir_builder_t *builder, const long long *hits, const long long *taken);
+void profile_print_source(FILE *fd, const char *src, int src_len, int line);
+int profile_row_compare(const void *a, const void *b);
+int profile_label_compare(const void *a, const void *b);
+
+// ========================================
+// profile.h - definition
+// ========================================
+
+void profile_print(FILE *fd, ir_builder_t *builder, const long long *hits, const long long *taken,
+	const char *src, int src_len) {
+	long long total = 0;
+	for (int i = 0; i < builder->len; i++) {
+		total += hits[i];
+	}
+	fprintf(fd, "profile: %lld instructions executed\n", total);
+
+	profile_print_lines(fd, builder, hits, total, src, src_len);
+	profile_print_instructions(fd, builder, hits);
+	profile_print_labels(fd, builder, hits);
+	profile_print_jumps(fd, builder, hits, taken);
+}
+
+// ========================================
+// helper definition
+// ========================================
+
+void profile_print_lines(FILE *fd, ir_builder_t *builder, const long long *hits, long long total,
+	const char *src, int src_len) {
+	int lines_len = 1;
+	for (int i = 0; i < builder->positions_len; i++) {
+		if (builder->positions[i].start.line >= lines_len) lines_len = builder->positions[i].start.line + 1;
+	}
+
+	profile_row_t *rows = malloc(lines_len * sizeof(profile_row_t));
+	if (rows == NULL) {
+		perror("something went wrong with malloc in profile_print_lines");
+		exit(1);
+	}
+	for (int i = 0; i < lines_len; i++) {
+		rows[i] = (profile_row_t) {.hits = 0, .key = i};
+	}
+	for (int i = 0; i < builder->len; i++) {
+		rows[ir_builder_pos(builder, i).start.line].hits += hits[i];
+	}
+	qsort(rows, lines_len, sizeof(profile_row_t), profile_row_compare);
+
+	fprintf(fd, "\nhottest lines\n");
+	fprintf(fd, "%12s %7s %6s  %s\n", "hits", "%", "line", "source");
+	for (int i = 0; i < lines_len && i < PROFILE_TOP && rows[i].hits > 0; i++) {
+		fprintf(fd, "%12lld %6.2f%% %6d  ", rows[i].hits, 100.0 * rows[i].hits / total, rows[i].key);
+		profile_print_source(fd, src, src_len, rows[i].key);
+	}
+	free(rows);
+}
+
+void profile_print_instructions(FILE *fd, ir_builder_t *builder, const long long *hits) {
+	profile_row_t *rows = malloc(builder->len * sizeof(profile_row_t));
+	if (rows == NULL) {
+		perror("something went wrong with malloc in profile_print_instructions");
+		exit(1);
+	}
+	for (int i = 0; i < builder->len; i++) {
+		rows[i] = (profile_row_t) {.hits = hits[i], .key = i};
+	}
+	qsort(rows, builder->len, sizeof(profile_row_t), profile_row_compare);
+
+	fprintf(fd, "\nhottest instructions\n");
+	fprintf(fd, "%12s %6s %6s  %s\n", "hits", "line", "index", "instruction");
+	for (int i = 0; i < builder->len && i < PROFILE_TOP && rows[i].hits > 0; i++) {
+		fprintf(fd, "%12lld %6d %6d  ", rows[i].hits, ir_builder_pos(builder, rows[i].key).start.line, rows[i].key);
+		print_ir_instruction(builder, rows[i].key, fd);
+	}
+	free(rows);
+}
+
+void profile_print_labels(FILE *fd, ir_builder_t *builder, const long long *hits) {
+	ir_t *list = builder->list;
+	int labels_len = list[builder->len - 1].arg1_id;	// OP_END holds the number of label ids
+
+	long long *calls = calloc(labels_len + 1, sizeof(long long));
+	profile_label_t *labels = malloc(builder->len * sizeof(profile_label_t));
+	if (calls == NULL || labels == NULL) {
+		perror("something went wrong with malloc in profile_print_labels");
+		exit(1);
+	}
+	for (int i = 0; i < builder->len; i++) {
+		if (list[i].op == OP_CALL) calls[list[i].res_id] += hits[i];
+	}
+
+	// the instructions after a label count for it until the next label, or
+	// until the end of the procedure it belongs to
+	int len = 0;
+	int current = -1, proc_end = -1;
+	for (int i = 0; i < builder->len; i++) {
+		ir_t ir = list[i];
+		int line = ir_builder_pos(builder, i).start.line;
+		const char *name = NULL;
+		if (ir.op == OP_LABEL && (name = ir_label_name(builder, ir.res_id, IR_NAME_LABEL))) {
+			current = len++;
+			labels[current] = (profile_label_t) {.name = name, .is_proc = 0, .line = line,
+				.hits = hits[i], .executed = 0};
+		}
+		else if (ir.op == OP_PROC && (name = ir_label_name(builder, ir.res_id, IR_NAME_PROC))) {
+			// OP_PROC itself only jumps over the body
+			current = len++;
+			proc_end = ir.arg1_id;
+			labels[current] = (profile_label_t) {.name = name, .is_proc = 1, .line = line,
+				.hits = calls[ir.res_id], .executed = 0};
+			continue;
+		}
+		else if (ir.op == OP_LABEL && ir.res_id == proc_end) {
+			current = proc_end = -1;
+		}
+
+		if (current != -1) labels[current].executed += hits[i];
+	}
+	qsort(labels, len, sizeof(profile_label_t), profile_label_compare);
+
+	fprintf(fd, "\nlabels\n");
+	fprintf(fd, "%12s %12s %6s  %s\n", "hits", "instructions", "line", "label");
+	for (int i = 0; i < len; i++) {
+		fprintf(fd, "%12lld %12lld %6d  %s%s\n", labels[i].hits, labels[i].executed, labels[i].line,
+			labels[i].is_proc ? "proc " : "", labels[i].name);
+	}
+	free(calls);
+	free(labels);
+}
+
+void profile_print_jumps(FILE *fd, ir_builder_t *builder, const long long *hits, const long long *taken) {
+	profile_row_t *rows = malloc(builder->len * sizeof(profile_row_t));
+	if (rows == NULL) {
+		perror("something went wrong with malloc in profile_print_jumps");
+		exit(1);
+	}
+	int len = 0;
+	for (int i = 0; i < builder->len; i++) {
+		int op = builder->list[i].op;
+		if ((op == OP_JMP_TRUE || op == OP_JMP_FALSE) && hits[i] > 0) {
+			rows[len++] = (profile_row_t) {.hits = hits[i], .key = i};
+		}
+	}
+	qsort(rows, len, sizeof(profile_row_t), profile_row_compare);
+
+	fprintf(fd, "\nconditional jumps\n");
+	fprintf(fd, "%12s %12s %6s %6s  %s\n", "taken", "not taken", "line", "index", "instruction");
+	for (int i = 0; i < len && i < PROFILE_TOP; i++) {
+		int index = rows[i].key;
+		fprintf(fd, "%12lld %12lld %6d %6d  ", taken[index], hits[index] - taken[index],
+			ir_builder_pos(builder, index).start.line, index);
+		print_ir_instruction(builder, index, fd);
+	}
+	free(rows);
+}
+
+void profile_print_source(FILE *fd, const char *src, int src_len, int line) {
+	int index = 0;
+	for (int i = 1; i < line && index < src_len; index++) {
+		if (src[index] == '\n') i++;
+	}
+	while (index < src_len && (src[index] == ' ' || src[index] == '\t')) {
+		index++;
+	}
+
+	int end = index;
+	while (end < src_len && src[end] != '\n' && src[end] != '\r') {
+		end++;
+	}
+	fprintf(fd, "%.*s\n", end - index, src + index);
+}
+
+int profile_row_compare(const void *a, const void *b) {
+	const profile_row_t *left = a, *right = b;
+	if (left->hits != right->hits) return left->hits < right->hits ? 1 : -1;
+	return left->key - right->key;
+}
+
+int profile_label_compare(const void *a, const void *b) {
+	const profile_label_t *left = a, *right = b;
+	if (left->executed != right->executed) return left->executed < right->executed ? 1 : -1;
+	return left->line - right->line;
+}
@@ -0,0 +1,208 @@
+#include "sample.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ========================================
+// helper declaration
+// ========================================
+
+typedef struct {
+	char *stack;		// folded stack (NULL means empty)
+	long long count;	// number of samples with this stack
+} sample_t;
+
+static ir_builder_t *g_builder;
+static const char **g_regions;	// user label every instruction runs under (NULL if none)
+
+static sample_t *g_samples;
+static int g_samples_len, g_samples_cap;	// cap is always a power of two
+
+static char *g_stack;		// folded stack being built
+static int g_stack_len, g_stack_cap;
+
+void sample_push(const char *frame);
+void sample_count();
+void sample_grow();
+unsigned int sample_hash(const char *stack);
+int sample_compare(const void *a, const void *b);
+
+// ========================================
+// sample.h - definition
+// ========================================
+
+void sample_init(ir_builder_t *builder) {
+	g_builder = builder;
+	g_regions = malloc(builder->len * sizeof(const char *));
+	if (g_regions == NULL) {
+		perror("something went wrong with malloc in sample_init");
+		exit(1);
+	}
+
+	// the code after a user label runs under it until the next label or the
+	// end of the procedure; a procedure body runs under the call frame
+	const char *region = NULL, *outer = NULL;
+	int proc_end = -1;
+	for (int i = 0; i < builder->len; i++) {
+		ir_t ir = builder->list[i];
+		const char *name = NULL;
+		if (ir.op == OP_LABEL && (name = ir_label_name(builder, ir.res_id, IR_NAME_LABEL))) {
+			region = name;
+		}
+		else if (ir.op == OP_PROC) {
+			outer = region;
+			region = NULL;
+			proc_end = ir.arg1_id;
+		}
+		else if (ir.op == OP_LABEL && ir.res_id == proc_end) {
+			region = outer;
+			proc_end = -1;
+		}
+		g_regions[i] = region;
+	}
+
+	g_samples = NULL;
+	g_samples_len = g_samples_cap = 0;
+	g_stack = NULL;
+	g_stack_len = g_stack_cap = 0;
+}
+
+void sample_free() {
+	for (int i = 0; i < g_samples_cap; i++) {
+		free(g_samples[i].stack);
+	}
+	free(g_samples);
+	g_samples = NULL;
+	g_samples_len = g_samples_cap = 0;
+	free(g_stack);
+	g_stack = NULL;
+	g_stack_len = g_stack_cap = 0;
+	free(g_regions);
+	g_regions = NULL;
+}
+
+void sample_record(ir_t *ip, ir_t **calls, int calls_len) {
+	ir_t *list = g_builder->list;
+	g_stack_len = 0;
+	sample_push("main");
+
+	// every frame shows the label it runs under, then the procedure it calls
+	for (int i = 0; i <= calls_len; i++) {
+		ir_t *cur = i < calls_len ? calls[i] - 1 : ip;
+		if (i > 0) {
+			const char *name = ir_label_name(g_builder, calls[i - 1][-1].res_id, IR_NAME_PROC);
+			sample_push(name ? name : "?");
+		}
+		if (g_regions[cur - list]) sample_push(g_regions[cur - list]);
+	}
+
+	int line = ir_builder_pos(g_builder, ip - list).start.line;
+	if (line > 0) {
+		char frame[32];
+		snprintf(frame, sizeof(frame), "line %d", line);
+		sample_push(frame);
+	}
+	sample_count();
+}
+
+void sample_print(FILE *fd) {
+	// sorted so the same run always prints the same file
+	sample_t *samples = malloc((g_samples_len + 1) * sizeof(sample_t));
+	if (samples == NULL) {
+		perror("something went wrong with malloc in sample_print");
+		exit(1);
+	}
+	int len = 0;
+	for (int i = 0; i < g_samples_cap; i++) {
+		if (g_samples[i].stack) samples[len++] = g_samples[i];
+	}
+	qsort(samples, len, sizeof(sample_t), sample_compare);
+
+	for (int i = 0; i < len; i++) {
+		fprintf(fd, "%s %lld\n", samples[i].stack, samples[i].count);
+	}
+	free(samples);
+}
+
+// ========================================
+// helper definition
+// ========================================
+
+void sample_push(const char *frame) {
+	int len = strlen(frame);
+	if (g_stack_cap <= g_stack_len + len + 2) {
+		while (g_stack_cap <= g_stack_len + len + 2) {
+			g_stack_cap = (g_stack_cap + 1) * 2;
+		}
+		g_stack = realloc(g_stack, g_stack_cap);
+		if (g_stack == NULL) {
+			perror("something went wrong with realloc in sample_push");
+			exit(1);
+		}
+	}
+
+	if (g_stack_len > 0) g_stack[g_stack_len++] = ';';
+	memcpy(g_stack + g_stack_len, frame, len);
+	g_stack_len += len;
+	g_stack[g_stack_len] = '\0';
+}
+
+void sample_count() {
+	if (g_samples_cap <= 2 * (g_samples_len + 1)) {
+		sample_grow();
+	}
+
+	unsigned int mask = g_samples_cap - 1;
+	unsigned int slot = sample_hash(g_stack) & mask;
+	while (g_samples[slot].stack && strcmp(g_samples[slot].stack, g_stack) != 0) {
+		slot = (slot + 1) & mask;
+	}
+
+	if (g_samples[slot].stack == NULL) {
+		g_samples[slot].stack = malloc(g_stack_len + 1);
+		if (g_samples[slot].stack == NULL) {
+			perror("something went wrong with malloc in sample_count");
+			exit(1);
+		}
+		memcpy(g_samples[slot].stack, g_stack, g_stack_len + 1);
+		g_samples_len++;
+	}
+	g_samples[slot].count++;
+}
+
+void sample_grow() {
+	sample_t *old = g_samples;
+	int old_cap = g_samples_cap;
+
+	g_samples_cap = g_samples_cap ? g_samples_cap * 2 : 64;
+	g_samples = calloc(g_samples_cap, sizeof(sample_t));
+	if (g_samples == NULL) {
+		perror("something went wrong with calloc in sample_grow");
+		exit(1);
+	}
+
+	unsigned int mask = g_samples_cap - 1;
+	for (int i = 0; i < old_cap; i++) {
+		if (old[i].stack == NULL) continue;
+
+		unsigned int slot = sample_hash(old[i].stack) & mask;
+		while (g_samples[slot].stack) slot = (slot + 1) & mask;
+		g_samples[slot] = old[i];
+	}
+	free(old);
+}
+
+unsigned int sample_hash(const char *stack) {
+	// FNV-1a
+	unsigned int hash = 2166136261u;
+	for (const char *ch = stack; *ch; ch++) {
+		hash = (hash ^ (unsigned char) *ch) * 16777619u;
+	}
+	return hash;
+}
+
+int sample_compare(const void *a, const void *b) {
+	const sample_t *left = a, *right = b;
+	return strcmp(left->stack, right->stack);
+}
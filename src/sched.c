@@ -0,0 +1,369 @@
+#include "sched.h"
+#include "vm.h"
+
+#include <pthread.h>
+#include <setjmp.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// ========================================
+// helper declaration
+// ========================================
+
+typedef struct {
+	vm_t vm;
+	int status;
+	char *output;		// print output, valid once vm.out is closed
+	size_t output_len;
+	long long slices;	// turns the program got
+	double finished;	// seconds from the start of sched_run to the end of the program
+} sched_program_t;
+
+typedef struct {
+	pthread_t thread;
+	pthread_mutex_t lock;	// guards the queue
+	int *queue;		// ring buffer of program ids, as big as the number of programs
+	int head, len;
+	int *stolen;		// room for the ids taken in one steal
+	long long slices, steals, executed;
+} sched_worker_t;
+
+static sched_program_t **g_programs;	// allocated one by one, open_memstream keeps pointers into them
+static int g_programs_len, g_programs_cap;
+
+static sched_worker_t *g_workers;
+static int g_workers_len;
+static long long g_slice, g_max_steps;
+static double g_start, g_wall;
+
+// a worker with nothing to run or steal sleeps until a program is queued again
+// or every program is done; g_queued can dip below zero for a moment because a
+// program is counted only after it is pushed
+static atomic_int g_queued;	// programs sitting in a queue
+static atomic_int g_remaining;	// programs not done yet
+static atomic_int g_idle;	// workers sleeping or about to
+static pthread_mutex_t g_idle_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_idle_cond = PTHREAD_COND_INITIALIZER;
+
+void *sched_worker(void *arg);
+int sched_pop(sched_worker_t *worker);
+int sched_steal(sched_worker_t *worker);
+void sched_push(sched_worker_t *worker, int id);
+int sched_wait();
+void sched_turn(sched_worker_t *worker, int id);
+double sched_now();
+int sched_compare(const void *a, const void *b);
+
+// ========================================
+// sched.h - definition
+// ========================================
+
+void sched_init(int workers, long long slice, long long max_steps) {
+	g_programs = NULL;
+	g_programs_len = g_programs_cap = 0;
+	g_workers = calloc(workers, sizeof(sched_worker_t));
+	if (g_workers == NULL) {
+		perror("something went wrong with calloc in sched_init");
+		exit(1);
+	}
+	g_workers_len = workers;
+	g_slice = slice;
+	g_max_steps = max_steps;
+	g_wall = 0;
+}
+
+void sched_free() {
+	for (int i = 0; i < g_programs_len; i++) {
+		vm_free(&g_programs[i]->vm);
+		free(g_programs[i]->output);
+		free(g_programs[i]);
+	}
+	free(g_programs);
+	g_programs = NULL;
+	g_programs_len = g_programs_cap = 0;
+
+	for (int i = 0; i < g_workers_len; i++) {
+		free(g_workers[i].queue);
+		free(g_workers[i].stolen);
+	}
+	free(g_workers);
+	g_workers = NULL;
+	g_workers_len = 0;
+}
+
+int sched_add(ir_builder_t *builder, const char *filepath, const char *src) {
+	if (g_programs_cap <= g_programs_len) {
+		g_programs_cap = (g_programs_cap + 1) * 2;
+		g_programs = realloc(g_programs, g_programs_cap * sizeof(sched_program_t *));
+		if (g_programs == NULL) {
+			perror("something went wrong with realloc in sched_add");
+			exit(1);
+		}
+	}
+
+	sched_program_t *program = malloc(sizeof(sched_program_t));
+	if (program == NULL) {
+		perror("something went wrong with malloc in sched_add");
+		exit(1);
+	}
+	g_programs[g_programs_len] = program;
+	vm_init(&program->vm, builder->list);
+	vm_set_source(&program->vm, builder, filepath, src);
+	program->output = NULL;
+	program->output_len = 0;
+	program->vm.out = open_memstream(&program->output, &program->output_len);
+	if (program->vm.out == NULL) {
+		perror("something went wrong with open_memstream in sched_add");
+		exit(1);
+	}
+	program->status = SCHED_DONE;
+	program->slices = 0;
+	program->finished = 0;
+	return g_programs_len++;
+}
+
+void sched_run() {
+	// the programs are dealt out round robin, stealing evens out the rest
+	for (int i = 0; i < g_workers_len; i++) {
+		sched_worker_t *worker = &g_workers[i];
+		worker->queue = malloc((g_programs_len + 1) * sizeof(int));
+		worker->stolen = malloc((g_programs_len + 1) * sizeof(int));
+		if (worker->queue == NULL || worker->stolen == NULL) {
+			perror("something went wrong with malloc in sched_run");
+			exit(1);
+		}
+		pthread_mutex_init(&worker->lock, NULL);
+		worker->head = worker->len = 0;
+		worker->slices = worker->steals = worker->executed = 0;
+	}
+	for (int i = 0; i < g_programs_len; i++) {
+		sched_worker_t *worker = &g_workers[i % g_workers_len];
+		worker->queue[worker->len++] = i;
+	}
+	atomic_store(&g_queued, g_programs_len);
+	atomic_store(&g_remaining, g_programs_len);
+	atomic_store(&g_idle, 0);
+
+	g_start = sched_now();
+	for (int i = 0; i < g_workers_len; i++) {
+		if (pthread_create(&g_workers[i].thread, NULL, sched_worker, &g_workers[i]) != 0) {
+			perror("something went wrong with pthread_create in sched_run");
+			exit(1);
+		}
+	}
+	for (int i = 0; i < g_workers_len; i++) {
+		pthread_join(g_workers[i].thread, NULL);
+	}
+	for (int i = 0; i < g_workers_len; i++) {
+		pthread_mutex_destroy(&g_workers[i].lock);
+	}
+	g_wall = sched_now() - g_start;
+
+	// closing the streams makes the output buffers final
+	for (int i = 0; i < g_programs_len; i++) {
+		fclose(g_programs[i]->vm.out);
+		g_programs[i]->vm.out = NULL;
+	}
+}
+
+int sched_status(int id) {
+	return g_programs[id]->status;
+}
+
+const char *sched_error(int id) {
+	return g_programs[id]->status == SCHED_FAILED ? g_programs[id]->vm.error : NULL;
+}
+
+void sched_write_output(int id, FILE *fd) {
+	fwrite(g_programs[id]->output, 1, g_programs[id]->output_len, fd);
+}
+
+void sched_print(FILE *fd) {
+	long long executed = 0, slices = 0, steals = 0;
+	int failed = 0;
+	for (int i = 0; i < g_workers_len; i++) {
+		executed += g_workers[i].executed;
+		slices += g_workers[i].slices;
+		steals += g_workers[i].steals;
+	}
+
+	double *latencies = malloc((g_programs_len + 1) * sizeof(double));
+	if (latencies == NULL) {
+		perror("something went wrong with malloc in sched_print");
+		exit(1);
+	}
+	for (int i = 0; i < g_programs_len; i++) {
+		latencies[i] = g_programs[i]->finished;
+		failed += g_programs[i]->status == SCHED_FAILED;
+	}
+	qsort(latencies, g_programs_len, sizeof(double), sched_compare);
+
+	fprintf(fd, "%-24s %12d\n", "programs", g_programs_len);
+	fprintf(fd, "%-24s %12d\n", "failed", failed);
+	fprintf(fd, "%-24s %12d\n", "workers", g_workers_len);
+	fprintf(fd, "%-24s %12lld\n", "slice", g_slice);
+	fprintf(fd, "%-24s %12.3f\n", "wall time (ms)", g_wall * 1e3);
+	fprintf(fd, "%-24s %12lld\n", "instructions", executed);
+	fprintf(fd, "%-24s %12lld\n", "slices", slices);
+	fprintf(fd, "%-24s %12lld\n", "steals", steals);
+	fprintf(fd, "%-24s %12.2f\n", "programs per second", g_wall > 0 ? g_programs_len / g_wall : 0);
+	fprintf(fd, "%-24s %12.2f\n", "million instructions/s", g_wall > 0 ? executed / g_wall / 1e6 : 0);
+
+	// latency is the time from the start of the run to the end of a program
+	if (g_programs_len > 0) {
+		static const int percentiles[] = {50, 90, 99, 100};
+		for (int i = 0; i < 4; i++) {
+			int index = (int) ((long long) percentiles[i] * (g_programs_len - 1) / 100);
+			char name[32];
+			snprintf(name, sizeof(name), "latency p%d (ms)", percentiles[i]);
+			fprintf(fd, "%-24s %12.3f\n", name, latencies[index] * 1e3);
+		}
+	}
+	free(latencies);
+
+	fprintf(fd, "\n%-8s %16s %12s %12s\n", "worker", "instructions", "slices", "steals");
+	for (int i = 0; i < g_workers_len; i++) {
+		fprintf(fd, "%-8d %16lld %12lld %12lld\n", i, g_workers[i].executed, g_workers[i].slices,
+			g_workers[i].steals);
+	}
+}
+
+// ========================================
+// helper definition
+// ========================================
+
+void *sched_worker(void *arg) {
+	sched_worker_t *worker = arg;
+	for (;;) {
+		int id = sched_pop(worker);
+		if (id == -1) id = sched_steal(worker);
+		if (id != -1) {
+			sched_turn(worker, id);
+			continue;
+		}
+		if (!sched_wait()) break;
+	}
+	return NULL;
+}
+
+int sched_pop(sched_worker_t *worker) {
+	int id = -1;
+	pthread_mutex_lock(&worker->lock);
+	if (worker->len > 0) {
+		id = worker->queue[worker->head];
+		worker->head = (worker->head + 1) % g_programs_len;
+		worker->len--;
+	}
+	pthread_mutex_unlock(&worker->lock);
+
+	if (id != -1) atomic_fetch_sub(&g_queued, 1);
+	return id;
+}
+
+int sched_steal(sched_worker_t *worker) {
+	int self = worker - g_workers;
+	for (int i = 1; i < g_workers_len; i++) {
+		sched_worker_t *victim = &g_workers[(self + i) % g_workers_len];
+
+		// half of the queue (rounded up) from its back; only one lock is held at a time
+		int count = 0;
+		pthread_mutex_lock(&victim->lock);
+		int take = (victim->len + 1) / 2;
+		for (; count < take; count++) {
+			victim->len--;
+			worker->stolen[count] = victim->queue[(victim->head + victim->len) % g_programs_len];
+		}
+		pthread_mutex_unlock(&victim->lock);
+		if (count == 0) continue;
+
+		// the rest stays counted in g_queued, it only changes queue
+		pthread_mutex_lock(&worker->lock);
+		for (int j = 1; j < count; j++) {
+			worker->queue[(worker->head + worker->len) % g_programs_len] = worker->stolen[j];
+			worker->len++;
+		}
+		pthread_mutex_unlock(&worker->lock);
+		worker->steals++;
+		atomic_fetch_sub(&g_queued, 1);
+		return worker->stolen[0];
+	}
+	return -1;
+}
+
+void sched_push(sched_worker_t *worker, int id) {
+	pthread_mutex_lock(&worker->lock);
+	worker->queue[(worker->head + worker->len) % g_programs_len] = id;
+	worker->len++;
+	pthread_mutex_unlock(&worker->lock);
+
+	// a worker that counted itself idle before this is woken up; one that
+	// counts itself later sees g_queued above zero and does not sleep
+	atomic_fetch_add(&g_queued, 1);
+	if (atomic_load(&g_idle) > 0) {
+		pthread_mutex_lock(&g_idle_lock);
+		pthread_cond_signal(&g_idle_cond);
+		pthread_mutex_unlock(&g_idle_lock);
+	}
+}
+
+int sched_wait() {
+	pthread_mutex_lock(&g_idle_lock);
+	atomic_fetch_add(&g_idle, 1);
+	while (atomic_load(&g_remaining) > 0 && atomic_load(&g_queued) <= 0) {
+		pthread_cond_wait(&g_idle_cond, &g_idle_lock);
+	}
+	atomic_fetch_sub(&g_idle, 1);
+	int more = atomic_load(&g_remaining) > 0;
+	pthread_mutex_unlock(&g_idle_lock);
+	return more;
+}
+
+void sched_turn(sched_worker_t *worker, int id) {
+	sched_program_t *program = g_programs[id];
+	vm_t *vm = &program->vm;
+	long long before = vm->executed;
+	long long budget = g_slice;
+	if (budget > g_max_steps - before) budget = g_max_steps - before;
+
+	// a runtime error ends the program instead of the whole process
+	jmp_buf on_error;
+	int status = VM_PAUSED;
+	vm->on_error = &on_error;
+	if (setjmp(on_error) == 0) {
+		status = vm_exec(vm, budget);
+		if (status == VM_PAUSED && vm->executed >= g_max_steps) vm_step_limit(vm, g_max_steps);
+	}
+	else {
+		program->status = SCHED_FAILED;
+		status = VM_DONE;
+	}
+	vm->on_error = NULL;
+
+	program->slices++;
+	worker->slices++;
+	worker->executed += vm->executed - before;
+	if (status == VM_PAUSED) {
+		sched_push(worker, id);
+		return;
+	}
+
+	program->finished = sched_now() - g_start;
+	if (atomic_fetch_sub(&g_remaining, 1) == 1) {
+		pthread_mutex_lock(&g_idle_lock);
+		pthread_cond_broadcast(&g_idle_cond);
+		pthread_mutex_unlock(&g_idle_lock);
+	}
+}
+
+double sched_now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int sched_compare(const void *a, const void *b) {
+	double left = *(const double *) a, right = *(const double *) b;
+	return (left > right) - (left < right);
+}
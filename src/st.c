@@ -1,4 +1,6 @@
 #include "st.h"
+#include "mem.h"
+#include "intern.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -8,136 +10,171 @@
 // helper declaration
 // ========================================
 
-static name_t *g_types;
-static int g_types_len;
-static name_t *g_labels;
-static int g_labels_len;
-static name_t *g_vars;
-static int g_vars_len;
-
-char *copy_str(const char *str);
+typedef struct {
+	name_t *names;	// name with id i is stored at names[i-1]
+	int len;
+	int cap;
+	int *by_sym;	// index + 1 of the name for each symbol id (0 if absent)
+	int by_sym_cap;
+} st_table_t;
+
+static st_table_t g_types;
+static st_table_t g_labels;
+static st_table_t g_procs;
+static st_table_t g_vars;
+
+void st_table_init(st_table_t *table);
+void st_table_free(st_table_t *table);
+name_t st_table_create(st_table_t *table, int sym_id, int type_id);
+name_t st_table_check_sym(st_table_t *table, int sym_id);
+name_t st_table_check_id(st_table_t *table, int id);
+int st_sym(const char *name);
 
 // ========================================
 // st.h - definition
 // ========================================
 
 void st_init() {
-	g_types = NULL;
-	g_types_len = 0;
-	g_labels = NULL;
-	g_labels_len = 0;
-	g_vars = NULL;
-	g_vars_len = 0;
+	st_table_init(&g_types);
+	st_table_init(&g_labels);
+	st_table_init(&g_procs);
+	st_table_init(&g_vars);
 }
 
 void st_free() {
-	for (int i = 0; i < g_types_len; i++) free(g_types[i].name);
-	for (int i = 0; i < g_labels_len; i++) free(g_labels[i].name);
-	for (int i = 0; i < g_vars_len; i++) free(g_vars[i].name);
+	st_table_free(&g_types);
+	st_table_free(&g_labels);
+	st_table_free(&g_procs);
+	st_table_free(&g_vars);
+}
 
-	free(g_types);
-	free(g_labels);
-	free(g_vars);
+int st_count() {
+	return g_types.len + g_labels.len + g_procs.len + g_vars.len;
 }
 
 name_t st_check_type(const char *name) {
-	for (int i = 0; i < g_types_len; i++) {
-		name_t n = g_types[i];
-		if (strcmp(name, n.name) == 0) {
-			return n;
-		}
-	}
-	return (name_t) {.id=-1};
+	return st_table_check_sym(&g_types, st_sym(name));
 }
 
 name_t st_create_type(const char *name) {
-	g_types_len++;
-	g_types = realloc(g_types, g_types_len * sizeof(name_t));
-	if (g_types == NULL) {
-		perror("something went wrong with realloc in st_create_type");
-		exit(1);
-	}
-
-	char *name_copy = copy_str(name);
-	g_types[g_types_len-1] = (name_t) {.id = g_types_len, .name = name_copy, .type_id=-1};
-	return g_types[g_types_len-1];
+	return st_table_create(&g_types, intern(name, strlen(name)), -1);
 }
 
 name_t st_check_label(const char *name) {
-	for (int i = 0; i < g_labels_len; i++) {
-		name_t n = g_labels[i];
-		if (strcmp(name, n.name) == 0) {
-			return n;
-		}
-	}
-	return (name_t) {.id=-1};
+	return st_table_check_sym(&g_labels, st_sym(name));
+}
+
+name_t st_check_label_sym(int sym_id) {
+	return st_table_check_sym(&g_labels, sym_id);
 }
 
 name_t st_check_label_by_id(int label_id) {
-	for (int i = 0; i < g_labels_len; i++) {
-		name_t n = g_labels[i];
-		if (n.id == label_id) {
-			return n;
-		}
-	}
-	return (name_t) {.id=-1};
+	return st_table_check_id(&g_labels, label_id);
 }
 
 name_t st_create_label(const char *name) {
-	g_labels_len++;
-	g_labels = realloc(g_labels, g_labels_len * sizeof(name_t));
-	if (g_types == NULL) {
-		perror("something went wrong with realloc in st_create_label");
-		exit(1);
-	}
+	return st_table_create(&g_labels, intern(name, strlen(name)), -1);
+}
+
+name_t st_create_label_sym(int sym_id) {
+	return st_table_create(&g_labels, sym_id, -1);
+}
+
+name_t st_create_proc_sym(int sym_id) {
+	return st_table_create(&g_procs, sym_id, -1);
+}
 
-	char *name_copy = copy_str(name);
-	g_labels[g_labels_len-1] = (name_t) {.id = g_labels_len, .name = name_copy, .type_id=-1};
-	return g_labels[g_labels_len-1];
+name_t st_check_proc_sym(int sym_id) {
+	return st_table_check_sym(&g_procs, sym_id);
+}
+
+name_t st_check_proc_by_id(int proc_id) {
+	return st_table_check_id(&g_procs, proc_id);
 }
 
 name_t st_check_var(const char *name) {
-	for (int i = 0; i < g_vars_len; i++) {
-		name_t n = g_vars[i];
-		if (strcmp(name, n.name) == 0) {
-			return n;
-		}
-	}
-	return (name_t) {.id=-1};
+	return st_table_check_sym(&g_vars, st_sym(name));
+}
+
+name_t st_check_var_sym(int sym_id) {
+	return st_table_check_sym(&g_vars, sym_id);
 }
 
 name_t st_check_var_by_id(int var_id) {
-	for (int i = 0; i < g_vars_len; i++) {
-		name_t n = g_vars[i];
-		if (n.id == var_id) {
-			return n;
-		}
-	}
-	return (name_t) {.id=-1};
+	return st_table_check_id(&g_vars, var_id);
 }
 
 name_t st_create_var(const char *name, int type_id) {
-	g_vars_len++;
-	g_vars = realloc(g_vars, g_vars_len * sizeof(name_t));
-	if (g_types == NULL) {
-		perror("something went wrong with realloc in st_create_var");
-		exit(1);
-	}
+	return st_table_create(&g_vars, intern(name, strlen(name)), type_id);
+}
 
-	char *name_copy = copy_str(name);
-	g_vars[g_vars_len-1] = (name_t) {.id = g_vars_len, .name = name_copy, .type_id=type_id};
-	return g_vars[g_vars_len-1];
+name_t st_create_var_sym(int sym_id, int type_id) {
+	return st_table_create(&g_vars, sym_id, type_id);
 }
 
 // ========================================
 // helper definition
 // ========================================
 
-char *copy_str(const char *str) {
-	int len = strlen(str);
-	char *res = malloc((len + 1) * sizeof(char));
-	for (int i = 0; i < len; i++) res[i] = str[i];
-	res[len] = 0;
-	return res;
+void st_table_init(st_table_t *table) {
+	table->names = NULL;
+	table->len = table->cap = 0;
+	table->by_sym = NULL;
+	table->by_sym_cap = 0;
+}
+
+void st_table_free(st_table_t *table) {
+	mem_free(MEM_ST, table->names);
+	mem_free(MEM_ST, table->by_sym);
+	st_table_init(table);
+}
+
+name_t st_table_create(st_table_t *table, int sym_id, int type_id) {
+	if (table->cap <= table->len) {
+		table->cap = (table->cap + 1) * 2;
+		table->names = mem_realloc(MEM_ST, table->names, table->cap * sizeof(name_t));
+		if (table->names == NULL) {
+			perror("something went wrong with realloc in st_table_create");
+			exit(1);
+		}
+	}
+
+	if (table->by_sym_cap <= sym_id) {
+		int cap = (sym_id + 1) * 2;
+		table->by_sym = mem_realloc(MEM_ST, table->by_sym, cap * sizeof(int));
+		if (table->by_sym == NULL) {
+			perror("something went wrong with realloc in st_table_create");
+			exit(1);
+		}
+		memset(table->by_sym + table->by_sym_cap, 0, (cap - table->by_sym_cap) * sizeof(int));
+		table->by_sym_cap = cap;
+	}
+
+	table->len++;
+	table->names[table->len-1] = (name_t) {
+		.id = table->len,
+		.name = intern_str(sym_id),
+		.type_id = type_id,
+		.sym_id = sym_id,
+	};
+	table->by_sym[sym_id] = table->len;
+	return table->names[table->len-1];
 }
 
+name_t st_table_check_sym(st_table_t *table, int sym_id) {
+	if (sym_id < 0 || sym_id >= table->by_sym_cap || table->by_sym[sym_id] == 0) {
+		return (name_t) {.id=-1};
+	}
+	return table->names[table->by_sym[sym_id] - 1];
+}
+
+name_t st_table_check_id(st_table_t *table, int id) {
+	if (id < 1 || id > table->len) {
+		return (name_t) {.id=-1};
+	}
+	return table->names[id - 1];
+}
+
+int st_sym(const char *name) {
+	return intern_find(name, strlen(name));
+}
@@ -0,0 +1,92 @@
+#include "stats.h"
+
+#include <time.h>
+
+// ========================================
+// helper declaration
+// ========================================
+
+static int g_enabled;
+static double g_times[STATS_PHASES];
+static int g_skipped[STATS_PHASES];
+static long long g_counters[STATS_COUNTERS];
+
+static const char *g_phase_names[STATS_PHASES] = {
+	"read_file",
+	"tokenize",
+	"parse",
+	"analyze",
+	"generate_ir",
+	"vm_run",
+};
+
+static const char *g_counter_names[STATS_COUNTERS] = {
+	"bytes",
+	"tokens",
+	"ast_nodes",
+	"symbols",
+	"ir_instructions",
+	"executed_instructions",
+};
+
+// ========================================
+// stats.h - definition
+// ========================================
+
+void stats_enable() {
+	g_enabled = 1;
+}
+
+double stats_now() {
+	if (!g_enabled) return 0;
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void stats_add_time(int phase, double start) {
+	if (!g_enabled) return;
+	g_times[phase] += stats_now() - start;
+}
+
+void stats_skip(int phase) {
+	g_skipped[phase] = 1;
+}
+
+void stats_set(int counter, long long value) {
+	g_counters[counter] = value;
+}
+
+void stats_print(FILE *fd) {
+	double total = 0;
+	fprintf(fd, "%-24s %12s\n", "phase", "time (ms)");
+	for (int i = 0; i < STATS_PHASES; i++) {
+		if (g_skipped[i]) {
+			fprintf(fd, "%-24s %12s\n", g_phase_names[i], "-");
+			continue;
+		}
+		fprintf(fd, "%-24s %12.3f\n", g_phase_names[i], g_times[i] * 1e3);
+		total += g_times[i];
+	}
+	fprintf(fd, "%-24s %12.3f\n", "total", total * 1e3);
+
+	fprintf(fd, "\n%-24s %12s\n", "counter", "value");
+	for (int i = 0; i < STATS_COUNTERS; i++) {
+		fprintf(fd, "%-24s %12lld\n", g_counter_names[i], g_counters[i]);
+	}
+}
+
+void stats_print_json(FILE *fd) {
+	// skipped phases are null so every key is always there
+	fprintf(fd, "{\"phases_ms\": {");
+	for (int i = 0; i < STATS_PHASES; i++) {
+		if (g_skipped[i]) fprintf(fd, "%s\"%s\": null", i ? ", " : "", g_phase_names[i]);
+		else fprintf(fd, "%s\"%s\": %.3f", i ? ", " : "", g_phase_names[i], g_times[i] * 1e3);
+	}
+	fprintf(fd, "}, \"counters\": {");
+	for (int i = 0; i < STATS_COUNTERS; i++) {
+		fprintf(fd, "%s\"%s\": %lld", i ? ", " : "", g_counter_names[i], g_counters[i]);
+	}
+	fprintf(fd, "}}\n");
+}
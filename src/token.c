@@ -11,9 +11,14 @@ const char *token_type_str(token_t token) {
 	if (token.type == TT_EOF) return "TT_EOF";
 	if (token.type == TT_COLON) return "TT_COLON";
 	if (token.type == TT_SEMICOLON) return "TT_SEMICOLON";
+	if (token.type == TT_COMMA) return "TT_COMMA";
 	if (token.type == TT_QUESTION) return "TT_QUESTION";
 	if (token.type == TT_LPAREN) return "TT_LPAREN";
 	if (token.type == TT_RPAREN) return "TT_RPAREN";
+	if (token.type == TT_LBRACE) return "TT_LBRACE";
+	if (token.type == TT_RBRACE) return "TT_RBRACE";
+	if (token.type == TT_LBRACKET) return "TT_LBRACKET";
+	if (token.type == TT_RBRACKET) return "TT_RBRACKET";
 	if (token.type == TT_EQUAL) return "TT_EQUAL";
 	if (token.type == TT_EQUAL_EQUAL) return "TT_EQUAL_EQUAL";
 	if (token.type == TT_PIPE) return "TT_PIPE";
@@ -37,12 +42,30 @@ const char *token_type_str(token_t token) {
 	if (token.type == TT_FSLASH) return "TT_FSLASH";
 	if (token.type == TT_MOD) return "TT_MOD";
 	if (token.type == TT_TILDE) return "TT_TILDE";
+	if (token.type == TT_PLUS_EQUAL) return "TT_PLUS_EQUAL";
+	if (token.type == TT_MINUS_EQUAL) return "TT_MINUS_EQUAL";
+	if (token.type == TT_STAR_EQUAL) return "TT_STAR_EQUAL";
+	if (token.type == TT_FSLASH_EQUAL) return "TT_FSLASH_EQUAL";
+	if (token.type == TT_MOD_EQUAL) return "TT_MOD_EQUAL";
+	if (token.type == TT_LSHIFT_EQUAL) return "TT_LSHIFT_EQUAL";
+	if (token.type == TT_RSHIFT_EQUAL) return "TT_RSHIFT_EQUAL";
+	if (token.type == TT_AMPERSAND_EQUAL) return "TT_AMPERSAND_EQUAL";
+	if (token.type == TT_PIPE_EQUAL) return "TT_PIPE_EQUAL";
+	if (token.type == TT_CARET_EQUAL) return "TT_CARET_EQUAL";
 	if (token.type == TT_IDENTIFIER) return "TT_IDENTIFIER";
 	if (token.type == TT_VAR_KEYWORD) return "TT_VAR_KEYWORD";
 	if (token.type == TT_IF_KEYWORD) return "TT_IF_KEYWORD";
 	if (token.type == TT_ELSE_KEYWORD) return "TT_ELSE_KEYWORD";
 	if (token.type == TT_GOTO_KEYWORD) return "TT_GOTO_KEYWORD";
 	if (token.type == TT_PRINT_KEYWORD) return "TT_PRINT_KEYWORD";
+	if (token.type == TT_WHILE_KEYWORD) return "TT_WHILE_KEYWORD";
+	if (token.type == TT_FOR_KEYWORD) return "TT_FOR_KEYWORD";
+	if (token.type == TT_SWITCH_KEYWORD) return "TT_SWITCH_KEYWORD";
+	if (token.type == TT_CASE_KEYWORD) return "TT_CASE_KEYWORD";
+	if (token.type == TT_DEFAULT_KEYWORD) return "TT_DEFAULT_KEYWORD";
+	if (token.type == TT_PROC_KEYWORD) return "TT_PROC_KEYWORD";
+	if (token.type == TT_CALL_KEYWORD) return "TT_CALL_KEYWORD";
+	if (token.type == TT_RETURN_KEYWORD) return "TT_RETURN_KEYWORD";
 	if (token.type == TT_INT_LITERAL) return "TT_INT_LITERAL";
 	return "UNKNOWN";
 }
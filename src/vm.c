@@ -1,181 +1,669 @@
 #include "vm.h"
-#include "st.h"
+#include "mem.h"
+#include "bigint.h"
+#include "error.h"
+#include "sample.h"
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 // ========================================
 // helper definition
 // ========================================
 
-static int *g_vars;
-static int g_vars_len;
-static ir_t **g_labels;
-static int g_labels_len;
+static long long g_executed;	// instructions executed by the last vm_run
+static long long *g_hits, *g_taken;	// profile counters per instruction (NULL when not profiling)
+static int g_sample_period;		// instructions between two samples (0 when not sampling)
 
-void vm_init(ir_t *ir_list);
-void vm_free();
+// A function the compiler must inline, so each constant argument gets a copy
+#if defined(__GNUC__)
+#define VM_INLINE inline __attribute__((always_inline))
+#else
+#define VM_INLINE inline
+#endif
 
-void vm_set_var(int id, int value);
-int vm_get_var(int id);
-void vm_set_label(int id, ir_t *ir_ptr);
-ir_t *vm_get_label(int id);
+// A function only called on rare paths, kept out of the interpreter loop
+#if defined(__GNUC__)
+#define VM_COLD __attribute__((cold, noinline))
+#else
+#define VM_COLD
+#endif
+
+// Copies of the interpreter loop
+enum {
+	VM_RUN_PLAIN = 0,
+	VM_RUN_PROFILE,	// count every instruction (see vm_profile)
+	VM_RUN_SAMPLE,	// record the stack every g_sample_period instructions
+};
+
+// restrict promises that stores into the variables never change the vm_t
+// itself, so the compiler keeps its fields in registers across the loop
+static VM_INLINE int vm_loop(vm_t *restrict vm, long long budget, const int mode);
+static VM_INLINE int vm_pause(vm_t *vm, ir_t *ip, long long executed);
+
+void vm_set_var(vm_t *vm, int id, int value);
+int vm_get_var(vm_t *vm, int id);
+void vm_set_var64(vm_t *vm, int id, long long value);
+long long vm_get_var64(vm_t *vm, int id);
+bigint_t *vm_big(vm_t *vm, int id);
+void vm_set_label(vm_t *vm, int id, ir_t *ir_ptr);
+ir_t *vm_get_label(vm_t *vm, int id);
+void vm_push_call(vm_t *vm, ir_t *ret);
+void vm_error(vm_t *vm, ir_t *ip, const char *message);
+// the loop only checks for a divisor of 0 or -1, the two that can trap
+VM_COLD long long vm_divide_edge(vm_t *vm, ir_t *ip, long long executed, long long left, long long right,
+	long long min);
+
+// Bulk array builtins run on 16 byte vectors (the SSE2 and NEON width), which
+// GCC and Clang lower without extra -m flags; other compilers get plain loops
+#if defined(__GNUC__)
+#define VM_VECTOR 4	// ints per vector
+typedef int vm_vec_t __attribute__((vector_size(16), aligned(4), may_alias));
+typedef unsigned int vm_uvec_t __attribute__((vector_size(16), aligned(4), may_alias));
+#endif
+
+int vm_element(vm_t *vm, ir_t *ip, long long executed, int array_id, int index);
+int *vm_array(vm_t *vm, int array_id);
+void vm_fill(int *dst, int len, int value);
+int vm_sum(const int *src, int len);
+int vm_min(const int *src, int len);
+int vm_max(const int *src, int len);
 
 // ========================================
 // vm.h - definition
 // ========================================
 
+void vm_init(vm_t *vm, ir_t *ir_list) {
+	vm->ir_list = ir_list;
+	vm->ip = ir_list;
+	vm->executed = 0;
+	ir_t *end = ir_list;
+	while (end->op != OP_END) end++;
+
+	// every variable id starts as 0; constants get their value up front
+	vm->vars_len = end->res_id + 1;
+	vm->vars = mem_calloc(MEM_VM, vm->vars_len, sizeof(int));
+	vm->labels_len = end->arg1_id + 1;
+	vm->labels = mem_calloc(MEM_VM, vm->labels_len, sizeof(ir_t*));
+	if (vm->vars == NULL || vm->labels == NULL) {
+		perror("something went wrong with calloc in vm_init");
+		exit(1);
+	}
+	vm->bigs = NULL;
+	vm->bigs_len = vm->bigs_cap = 0;
+
+	for (ir_t *ir_ptr = ir_list; ir_ptr != end; ir_ptr++) {
+		if (ir_ptr->op == OP_CONST) {
+			vm_set_var(vm, ir_ptr->res_id, ir_ptr->arg1_id);
+		}
+		else if (ir_ptr->op == OP_CONST_I64) {
+			vm_set_var(vm, ir_ptr->res_id, ir_ptr->arg1_id);
+			vm_set_var(vm, ir_ptr->res_id + 1, ir_ptr->arg2_id);
+		}
+		else if (ir_ptr->op == OP_CONST_BIG) {
+			bigint_set_chunk(vm_big(vm, ir_ptr->res_id), ir_ptr->arg2_id, (unsigned int) ir_ptr->arg1_id);
+		}
+		else if (ir_ptr->op == OP_LABEL) {
+			vm_set_label(vm, ir_ptr->res_id, ir_ptr);
+		}
+		else if (ir_ptr->op == OP_PROC) {
+			vm_set_label(vm, ir_ptr->res_id, ir_ptr + 1);
+		}
+	}
+
+	// the constants the program starts with are already set
+	while (vm->ip->op == OP_CONST || vm->ip->op == OP_CONST_I64 || vm->ip->op == OP_CONST_BIG) vm->ip++;
+
+	vm->calls = NULL;
+	vm->calls_len = vm->calls_cap = 0;
+	vm->out = stdout;
+	vm->source = NULL;
+	vm->filepath = vm->src = NULL;
+	vm->on_error = NULL;
+	vm->error[0] = '\0';
+}
+
+int vm_exec(vm_t *vm, long long budget) {
+	// profiling and sampling get copies of their own so the plain loop pays nothing for them
+	if (g_hits == NULL && g_sample_period == 0) return vm_loop(vm, budget, VM_RUN_PLAIN);
+	else if (g_hits) return vm_loop(vm, budget, VM_RUN_PROFILE);
+	else return vm_loop(vm, budget, VM_RUN_SAMPLE);
+}
+
+void vm_free(vm_t *vm) {
+	mem_free(MEM_VM, vm->vars);
+	mem_free(MEM_VM, vm->labels);
+	mem_free(MEM_VM, vm->calls);
+	for (int i = 0; i < vm->bigs_len; i++) {
+		bigint_free(vm->bigs[i]);
+		mem_free(MEM_VM, vm->bigs[i]);
+	}
+	mem_free(MEM_VM, vm->bigs);
+}
+
+void vm_step_limit(vm_t *vm, long long max_steps) {
+	char message[128];
+	snprintf(message, sizeof(message), "runtime error: stopped after the step limit of %lld instructions", max_steps);
+	vm_error(vm, vm->ip, message);
+}
+
 void vm_run(ir_t *ir_list) {
-	vm_init(ir_list);
+	vm_t vm;
+	vm_init(&vm, ir_list);
+	vm_exec(&vm, VM_UNLIMITED);
+	g_executed = vm.executed;
+	vm_free(&vm);
+}
+
+long long vm_executed() {
+	return g_executed;
+}
+
+void vm_profile(long long *hits, long long *taken) {
+	g_hits = hits;
+	g_taken = taken;
+}
+
+void vm_sample(int period) {
+	g_sample_period = period;
+}
+
+void vm_set_source(vm_t *vm, ir_builder_t *builder, const char *filepath, const char *src) {
+	vm->source = builder;
+	vm->filepath = filepath;
+	vm->src = src;
+}
+
+// ========================================
+// helper declaration
+// ========================================
 
-	ir_t *ip = ir_list;
+static VM_INLINE int vm_loop(vm_t *restrict vm, long long budget, const int mode) {
+	ir_t *ir_list = vm->ir_list;
+	ir_t *ip = vm->ip;
 	int running = 1;
+	long long executed = vm->executed;
+	long long limit = budget > VM_UNLIMITED - executed ? VM_UNLIMITED : executed + budget;
+	int countdown = g_sample_period;
+
+	// the budget is checked only where the program can go back: jumps and
+	// calls to an earlier instruction, so straight code runs unchecked
 	while (running) {
+		executed++;
+		if (mode == VM_RUN_PROFILE) g_hits[ip - ir_list]++;
+		if (mode == VM_RUN_SAMPLE && --countdown == 0) {
+			countdown = g_sample_period;
+			sample_record(ip, vm->calls, vm->calls_len);
+		}
 		switch (ip->op) {
 		case OP_ADD: {
-			int left = vm_get_var(ip->arg1_id);
-			int right = vm_get_var(ip->arg2_id);
-			vm_set_var(ip->res_id, left + right);
+			int left = vm_get_var(vm, ip->arg1_id);
+			int right = vm_get_var(vm, ip->arg2_id);
+			vm_set_var(vm, ip->res_id, left + right);
 			break;
 		}
 		case OP_SUB: {
-			int left = vm_get_var(ip->arg1_id);
-			int right = vm_get_var(ip->arg2_id);
-			vm_set_var(ip->res_id, left - right);
+			int left = vm_get_var(vm, ip->arg1_id);
+			int right = vm_get_var(vm, ip->arg2_id);
+			vm_set_var(vm, ip->res_id, left - right);
 			break;
 		}
 		case OP_MUL: {
-			int left = vm_get_var(ip->arg1_id);
-			int right = vm_get_var(ip->arg2_id);
-			vm_set_var(ip->res_id, left * right);
+			int left = vm_get_var(vm, ip->arg1_id);
+			int right = vm_get_var(vm, ip->arg2_id);
+			vm_set_var(vm, ip->res_id, left * right);
 			break;
 		}
 		case OP_DIV: {
-			int left = vm_get_var(ip->arg1_id);
-			int right = vm_get_var(ip->arg2_id);
-			vm_set_var(ip->res_id, left / right);
+			int left = vm_get_var(vm, ip->arg1_id);
+			int right = vm_get_var(vm, ip->arg2_id);
+			if ((unsigned int) right + 1 <= 1) vm_set_var(vm, ip->res_id, vm_divide_edge(vm, ip, executed, left, right, INT_MIN));
+			else vm_set_var(vm, ip->res_id, left / right);
 			break;
 		}
 		case OP_MOD: {
-			int left = vm_get_var(ip->arg1_id);
-			int right = vm_get_var(ip->arg2_id);
-			vm_set_var(ip->res_id, left % right);
+			int left = vm_get_var(vm, ip->arg1_id);
+			int right = vm_get_var(vm, ip->arg2_id);
+			if ((unsigned int) right + 1 <= 1) vm_set_var(vm, ip->res_id, vm_divide_edge(vm, ip, executed, left, right, INT_MIN));
+			else vm_set_var(vm, ip->res_id, left % right);
 			break;
 		}
 		case OP_LSHIFT: {
-			int left = vm_get_var(ip->arg1_id);
-			int right = vm_get_var(ip->arg2_id);
-			vm_set_var(ip->res_id, left << right);
+			int left = vm_get_var(vm, ip->arg1_id);
+			int right = vm_get_var(vm, ip->arg2_id);
+			vm_set_var(vm, ip->res_id, left << right);
 			break;
 		}
 		case OP_RSHIFT: {
-			int left = vm_get_var(ip->arg1_id);
-			int right = vm_get_var(ip->arg2_id);
-			vm_set_var(ip->res_id, left >> right);
+			int left = vm_get_var(vm, ip->arg1_id);
+			int right = vm_get_var(vm, ip->arg2_id);
+			vm_set_var(vm, ip->res_id, left >> right);
 			break;
 		}
 		case OP_EQUAL_EQUAL: {
-			int left = vm_get_var(ip->arg1_id);
-			int right = vm_get_var(ip->arg2_id);
-			vm_set_var(ip->res_id, left == right);
+			int left = vm_get_var(vm, ip->arg1_id);
+			int right = vm_get_var(vm, ip->arg2_id);
+			vm_set_var(vm, ip->res_id, left == right);
 			break;
 		}
 		case OP_NOT_EQUAL: {
-			int left = vm_get_var(ip->arg1_id);
-			int right = vm_get_var(ip->arg2_id);
-			vm_set_var(ip->res_id, left != right);
+			int left = vm_get_var(vm, ip->arg1_id);
+			int right = vm_get_var(vm, ip->arg2_id);
+			vm_set_var(vm, ip->res_id, left != right);
 			break;
 		}
 		case OP_LESSER: {
-			int left = vm_get_var(ip->arg1_id);
-			int right = vm_get_var(ip->arg2_id);
-			vm_set_var(ip->res_id, left < right);
+			int left = vm_get_var(vm, ip->arg1_id);
+			int right = vm_get_var(vm, ip->arg2_id);
+			vm_set_var(vm, ip->res_id, left < right);
 			break;
 		}
 		case OP_LESSER_EQUAL: {
-			int left = vm_get_var(ip->arg1_id);
-			int right = vm_get_var(ip->arg2_id);
-			vm_set_var(ip->res_id, left <= right);
+			int left = vm_get_var(vm, ip->arg1_id);
+			int right = vm_get_var(vm, ip->arg2_id);
+			vm_set_var(vm, ip->res_id, left <= right);
 			break;
 		}
 		case OP_GREATER: {
-			int left = vm_get_var(ip->arg1_id);
-			int right = vm_get_var(ip->arg2_id);
-			vm_set_var(ip->res_id, left > right);
+			int left = vm_get_var(vm, ip->arg1_id);
+			int right = vm_get_var(vm, ip->arg2_id);
+			vm_set_var(vm, ip->res_id, left > right);
 			break;
 		}
 		case OP_GREATER_EQUAL: {
-			int left = vm_get_var(ip->arg1_id);
-			int right = vm_get_var(ip->arg2_id);
-			vm_set_var(ip->res_id, left >= right);
+			int left = vm_get_var(vm, ip->arg1_id);
+			int right = vm_get_var(vm, ip->arg2_id);
+			vm_set_var(vm, ip->res_id, left >= right);
 			break;
 		}
 		case OP_BITWISE_AND: {
-			int left = vm_get_var(ip->arg1_id);
-			int right = vm_get_var(ip->arg2_id);
-			vm_set_var(ip->res_id, left & right);
+			int left = vm_get_var(vm, ip->arg1_id);
+			int right = vm_get_var(vm, ip->arg2_id);
+			vm_set_var(vm, ip->res_id, left & right);
 			break;
 		}
 		case OP_BITWISE_OR: {
-			int left = vm_get_var(ip->arg1_id);
-			int right = vm_get_var(ip->arg2_id);
-			vm_set_var(ip->res_id, left | right);
+			int left = vm_get_var(vm, ip->arg1_id);
+			int right = vm_get_var(vm, ip->arg2_id);
+			vm_set_var(vm, ip->res_id, left | right);
 			break;
 		}
 		case OP_BITWISE_XOR: {
-			int left = vm_get_var(ip->arg1_id);
-			int right = vm_get_var(ip->arg2_id);
-			vm_set_var(ip->res_id, left ^ right);
+			int left = vm_get_var(vm, ip->arg1_id);
+			int right = vm_get_var(vm, ip->arg2_id);
+			vm_set_var(vm, ip->res_id, left ^ right);
 			break;
 		}
 		case OP_LOGICAL_AND: {
-			int left = vm_get_var(ip->arg1_id);
-			int right = vm_get_var(ip->arg2_id);
-			vm_set_var(ip->res_id, left && right);
+			int left = vm_get_var(vm, ip->arg1_id);
+			int right = vm_get_var(vm, ip->arg2_id);
+			vm_set_var(vm, ip->res_id, left && right);
 			break;
 		}
 		case OP_LOGICAL_OR: {
-			int left = vm_get_var(ip->arg1_id);
-			int right = vm_get_var(ip->arg2_id);
-			vm_set_var(ip->res_id, left || right);
+			int left = vm_get_var(vm, ip->arg1_id);
+			int right = vm_get_var(vm, ip->arg2_id);
+			vm_set_var(vm, ip->res_id, left || right);
 			break;
 		}
 		case OP_LOGICAL_NOT: {
-			int left = vm_get_var(ip->arg1_id);
-			vm_set_var(ip->res_id, !left);
+			int left = vm_get_var(vm, ip->arg1_id);
+			vm_set_var(vm, ip->res_id, !left);
 			break;
 		}
 		case OP_BITWISE_NOT: {
-			int left = vm_get_var(ip->arg1_id);
-			vm_set_var(ip->res_id, ~left);
+			int left = vm_get_var(vm, ip->arg1_id);
+			vm_set_var(vm, ip->res_id, ~left);
+			break;
+		}
+		case OP_ADD_I64: {
+			long long left = vm_get_var64(vm, ip->arg1_id);
+			long long right = vm_get_var64(vm, ip->arg2_id);
+			vm_set_var64(vm, ip->res_id, left + right);
+			break;
+		}
+		case OP_SUB_I64: {
+			long long left = vm_get_var64(vm, ip->arg1_id);
+			long long right = vm_get_var64(vm, ip->arg2_id);
+			vm_set_var64(vm, ip->res_id, left - right);
+			break;
+		}
+		case OP_MUL_I64: {
+			long long left = vm_get_var64(vm, ip->arg1_id);
+			long long right = vm_get_var64(vm, ip->arg2_id);
+			vm_set_var64(vm, ip->res_id, left * right);
+			break;
+		}
+		case OP_DIV_I64: {
+			long long left = vm_get_var64(vm, ip->arg1_id);
+			long long right = vm_get_var64(vm, ip->arg2_id);
+			if ((unsigned long long) right + 1 <= 1) vm_set_var64(vm, ip->res_id, vm_divide_edge(vm, ip, executed, left, right, LLONG_MIN));
+			else vm_set_var64(vm, ip->res_id, left / right);
+			break;
+		}
+		case OP_MOD_I64: {
+			long long left = vm_get_var64(vm, ip->arg1_id);
+			long long right = vm_get_var64(vm, ip->arg2_id);
+			if ((unsigned long long) right + 1 <= 1) vm_set_var64(vm, ip->res_id, vm_divide_edge(vm, ip, executed, left, right, LLONG_MIN));
+			else vm_set_var64(vm, ip->res_id, left % right);
+			break;
+		}
+		case OP_LSHIFT_I64: {
+			long long left = vm_get_var64(vm, ip->arg1_id);
+			long long right = vm_get_var64(vm, ip->arg2_id);
+			vm_set_var64(vm, ip->res_id, left << right);
+			break;
+		}
+		case OP_RSHIFT_I64: {
+			long long left = vm_get_var64(vm, ip->arg1_id);
+			long long right = vm_get_var64(vm, ip->arg2_id);
+			vm_set_var64(vm, ip->res_id, left >> right);
+			break;
+		}
+		case OP_EQUAL_EQUAL_I64: {
+			long long left = vm_get_var64(vm, ip->arg1_id);
+			long long right = vm_get_var64(vm, ip->arg2_id);
+			vm_set_var(vm, ip->res_id, left == right);
+			break;
+		}
+		case OP_NOT_EQUAL_I64: {
+			long long left = vm_get_var64(vm, ip->arg1_id);
+			long long right = vm_get_var64(vm, ip->arg2_id);
+			vm_set_var(vm, ip->res_id, left != right);
+			break;
+		}
+		case OP_LESSER_I64: {
+			long long left = vm_get_var64(vm, ip->arg1_id);
+			long long right = vm_get_var64(vm, ip->arg2_id);
+			vm_set_var(vm, ip->res_id, left < right);
+			break;
+		}
+		case OP_LESSER_EQUAL_I64: {
+			long long left = vm_get_var64(vm, ip->arg1_id);
+			long long right = vm_get_var64(vm, ip->arg2_id);
+			vm_set_var(vm, ip->res_id, left <= right);
+			break;
+		}
+		case OP_GREATER_I64: {
+			long long left = vm_get_var64(vm, ip->arg1_id);
+			long long right = vm_get_var64(vm, ip->arg2_id);
+			vm_set_var(vm, ip->res_id, left > right);
+			break;
+		}
+		case OP_GREATER_EQUAL_I64: {
+			long long left = vm_get_var64(vm, ip->arg1_id);
+			long long right = vm_get_var64(vm, ip->arg2_id);
+			vm_set_var(vm, ip->res_id, left >= right);
+			break;
+		}
+		case OP_BITWISE_AND_I64: {
+			long long left = vm_get_var64(vm, ip->arg1_id);
+			long long right = vm_get_var64(vm, ip->arg2_id);
+			vm_set_var64(vm, ip->res_id, left & right);
+			break;
+		}
+		case OP_BITWISE_OR_I64: {
+			long long left = vm_get_var64(vm, ip->arg1_id);
+			long long right = vm_get_var64(vm, ip->arg2_id);
+			vm_set_var64(vm, ip->res_id, left | right);
+			break;
+		}
+		case OP_BITWISE_XOR_I64: {
+			long long left = vm_get_var64(vm, ip->arg1_id);
+			long long right = vm_get_var64(vm, ip->arg2_id);
+			vm_set_var64(vm, ip->res_id, left ^ right);
+			break;
+		}
+		case OP_BITWISE_NOT_I64: {
+			long long left = vm_get_var64(vm, ip->arg1_id);
+			vm_set_var64(vm, ip->res_id, ~left);
+			break;
+		}
+		case OP_ADD_BIG: {
+			bigint_t *left = vm_big(vm, ip->arg1_id);
+			bigint_t *right = vm_big(vm, ip->arg2_id);
+			bigint_add(vm_big(vm, ip->res_id), left, right);
+			break;
+		}
+		case OP_SUB_BIG: {
+			bigint_t *left = vm_big(vm, ip->arg1_id);
+			bigint_t *right = vm_big(vm, ip->arg2_id);
+			bigint_sub(vm_big(vm, ip->res_id), left, right);
+			break;
+		}
+		case OP_MUL_BIG: {
+			bigint_t *left = vm_big(vm, ip->arg1_id);
+			bigint_t *right = vm_big(vm, ip->arg2_id);
+			bigint_mul(vm_big(vm, ip->res_id), left, right);
+			break;
+		}
+		case OP_DIV_BIG: {
+			bigint_t *left = vm_big(vm, ip->arg1_id);
+			bigint_t *right = vm_big(vm, ip->arg2_id);
+			if (!bigint_divmod(vm_big(vm, ip->res_id), NULL, left, right)) {
+				vm->executed = executed;
+				vm_error(vm, ip, "runtime error: bigint division by zero");
+			}
+			break;
+		}
+		case OP_MOD_BIG: {
+			bigint_t *left = vm_big(vm, ip->arg1_id);
+			bigint_t *right = vm_big(vm, ip->arg2_id);
+			if (!bigint_divmod(NULL, vm_big(vm, ip->res_id), left, right)) {
+				vm->executed = executed;
+				vm_error(vm, ip, "runtime error: bigint division by zero");
+			}
+			break;
+		}
+		case OP_EQUAL_EQUAL_BIG: {
+			bigint_t *left = vm_big(vm, ip->arg1_id);
+			bigint_t *right = vm_big(vm, ip->arg2_id);
+			vm_set_var(vm, ip->res_id, bigint_compare(left, right) == 0);
+			break;
+		}
+		case OP_NOT_EQUAL_BIG: {
+			bigint_t *left = vm_big(vm, ip->arg1_id);
+			bigint_t *right = vm_big(vm, ip->arg2_id);
+			vm_set_var(vm, ip->res_id, bigint_compare(left, right) != 0);
+			break;
+		}
+		case OP_LESSER_BIG: {
+			bigint_t *left = vm_big(vm, ip->arg1_id);
+			bigint_t *right = vm_big(vm, ip->arg2_id);
+			vm_set_var(vm, ip->res_id, bigint_compare(left, right) < 0);
+			break;
+		}
+		case OP_LESSER_EQUAL_BIG: {
+			bigint_t *left = vm_big(vm, ip->arg1_id);
+			bigint_t *right = vm_big(vm, ip->arg2_id);
+			vm_set_var(vm, ip->res_id, bigint_compare(left, right) <= 0);
+			break;
+		}
+		case OP_GREATER_BIG: {
+			bigint_t *left = vm_big(vm, ip->arg1_id);
+			bigint_t *right = vm_big(vm, ip->arg2_id);
+			vm_set_var(vm, ip->res_id, bigint_compare(left, right) > 0);
+			break;
+		}
+		case OP_GREATER_EQUAL_BIG: {
+			bigint_t *left = vm_big(vm, ip->arg1_id);
+			bigint_t *right = vm_big(vm, ip->arg2_id);
+			vm_set_var(vm, ip->res_id, bigint_compare(left, right) >= 0);
 			break;
 		}
 		case OP_LABEL:
+		case OP_CONST:	// already set by vm_init
+		case OP_CONST_I64:
+		case OP_CONST_BIG:
+			break;
+		case OP_INC: {
+			int value = vm_get_var(vm, ip->res_id);
+			vm_set_var(vm, ip->res_id, value + 1);
+			break;
+		}
+		case OP_DEC: {
+			int value = vm_get_var(vm, ip->res_id);
+			vm_set_var(vm, ip->res_id, value - 1);
+			break;
+		}
+		case OP_ADD_IMM: {
+			int value = vm_get_var(vm, ip->res_id);
+			vm_set_var(vm, ip->res_id, value + ip->arg1_id);
+			break;
+		}
+		case OP_INC_I64: {
+			long long value = vm_get_var64(vm, ip->res_id);
+			vm_set_var64(vm, ip->res_id, value + 1);
+			break;
+		}
+		case OP_DEC_I64: {
+			long long value = vm_get_var64(vm, ip->res_id);
+			vm_set_var64(vm, ip->res_id, value - 1);
+			break;
+		}
+		case OP_ADD_IMM_I64: {
+			long long value = vm_get_var64(vm, ip->res_id);
+			vm_set_var64(vm, ip->res_id, value + ip->arg1_id);
+			break;
+		}
+		case OP_WIDEN: {
+			int left = vm_get_var(vm, ip->arg1_id);
+			vm_set_var64(vm, ip->res_id, left);
+			break;
+		}
+		case OP_INC_BIG: {
+			bigint_add_int(vm_big(vm, ip->res_id), 1);
+			break;
+		}
+		case OP_DEC_BIG: {
+			bigint_add_int(vm_big(vm, ip->res_id), -1);
+			break;
+		}
+		case OP_ADD_IMM_BIG: {
+			bigint_add_int(vm_big(vm, ip->res_id), ip->arg1_id);
+			break;
+		}
+		case OP_WIDEN_BIG: {
+			bigint_set(vm_big(vm, ip->res_id), vm_get_var(vm, ip->arg1_id));
+			break;
+		}
+		case OP_WIDEN_I64_BIG: {
+			bigint_set(vm_big(vm, ip->res_id), vm_get_var64(vm, ip->arg1_id));
 			break;
+		}
+		case OP_LOAD: {
+			int id = vm_element(vm, ip, executed, ip->arg1_id, vm_get_var(vm, ip->arg2_id));
+			vm_set_var(vm, ip->res_id, vm_get_var(vm, id));
+			break;
+		}
+		case OP_STORE: {
+			int id = vm_element(vm, ip, executed, ip->res_id, vm_get_var(vm, ip->arg1_id));
+			vm_set_var(vm, id, vm_get_var(vm, ip->arg2_id));
+			break;
+		}
+		case OP_FILL: {
+			vm_fill(vm_array(vm, ip->res_id), vm_get_var(vm, ip->res_id), vm_get_var(vm, ip->arg1_id));
+			break;
+		}
+		case OP_ARRAY_COPY: {
+			// only the elements both arrays have are copied
+			int len = vm_get_var(vm, ip->res_id);
+			if (vm_get_var(vm, ip->arg1_id) < len) len = vm_get_var(vm, ip->arg1_id);
+			memmove(vm_array(vm, ip->res_id), vm_array(vm, ip->arg1_id), len * sizeof(int));
+			break;
+		}
+		case OP_SUM: {
+			vm_set_var(vm, ip->res_id, vm_sum(vm_array(vm, ip->arg1_id), vm_get_var(vm, ip->arg1_id)));
+			break;
+		}
+		case OP_MIN: {
+			vm_set_var(vm, ip->res_id, vm_min(vm_array(vm, ip->arg1_id), vm_get_var(vm, ip->arg1_id)));
+			break;
+		}
+		case OP_MAX: {
+			vm_set_var(vm, ip->res_id, vm_max(vm_array(vm, ip->arg1_id), vm_get_var(vm, ip->arg1_id)));
+			break;
+		}
 		case OP_JMP: {
-			ip = vm_get_label(ip->res_id);
+			ir_t *target = vm_get_label(vm, ip->res_id);
+			if (target <= ip && executed >= limit) return vm_pause(vm, target, executed);
+			ip = target;
+			continue;
+		}
+		case OP_JMP_TABLE: {
+			// the jumps follow the table; the last one is for values out of range
+			unsigned int index = (unsigned int) vm_get_var(vm, ip->res_id) - (unsigned int) ip->arg1_id;
+			if (index > (unsigned int) ip->arg2_id) index = ip->arg2_id;
+			ip += 1 + index;
+			continue;
+		}
+		case OP_PROC: {
+			ip = vm_get_label(vm, ip->arg1_id);
+			continue;
+		}
+		case OP_CALL: {
+			ir_t *target = vm_get_label(vm, ip->res_id);
+			vm_push_call(vm, ip + 1);
+			if (target <= ip && executed >= limit) return vm_pause(vm, target, executed);
+			ip = target;
+			continue;
+		}
+		case OP_RET: {
+			ip = vm->calls[--vm->calls_len];
 			continue;
 		}
 		case OP_JMP_TRUE: {
-			int left = vm_get_var(ip->arg1_id);
-			if (left) ip = vm_get_label(ip->res_id);
+			int left = vm_get_var(vm, ip->arg1_id);
+			if (left) {
+				if (mode == VM_RUN_PROFILE) g_taken[ip - ir_list]++;
+				ir_t *target = vm_get_label(vm, ip->res_id);
+				if (target <= ip && executed >= limit) return vm_pause(vm, target, executed);
+				ip = target;
+			}
 			else ip++;
 			continue;
 		}
 		case OP_JMP_FALSE: {
-			int left = vm_get_var(ip->arg1_id);
-			if (!left) ip = vm_get_label(ip->res_id);
+			int left = vm_get_var(vm, ip->arg1_id);
+			if (!left) {
+				if (mode == VM_RUN_PROFILE) g_taken[ip - ir_list]++;
+				ir_t *target = vm_get_label(vm, ip->res_id);
+				if (target <= ip && executed >= limit) return vm_pause(vm, target, executed);
+				ip = target;
+			}
 			else ip++;
 			continue;
 		}
 		case OP_COPY: {
-			int left = vm_get_var(ip->arg1_id);
-			vm_set_var(ip->res_id, left);
+			int left = vm_get_var(vm, ip->arg1_id);
+			vm_set_var(vm, ip->res_id, left);
+			break;
+		}
+		case OP_COPY_I64: {
+			long long left = vm_get_var64(vm, ip->arg1_id);
+			vm_set_var64(vm, ip->res_id, left);
+			break;
+		}
+		case OP_COPY_BIG: {
+			bigint_t *left = vm_big(vm, ip->arg1_id);
+			bigint_copy(vm_big(vm, ip->res_id), left);
 			break;
 		}
 		case OP_PRINT: {
-			int res = vm_get_var(ip->res_id);
-			printf("%d\n", res);
+			int res = vm_get_var(vm, ip->res_id);
+			fprintf(vm->out, "%d\n", res);
+			break;
+		}
+		case OP_PRINT_I64: {
+			long long res = vm_get_var64(vm, ip->res_id);
+			fprintf(vm->out, "%lld\n", res);
+			break;
+		}
+		case OP_PRINT_BIG: {
+			char *res = bigint_str(vm_big(vm, ip->res_id));
+			fprintf(vm->out, "%s\n", res);
+			mem_free(MEM_VM, res);
 			break;
 		}
 		case OP_END:
@@ -188,60 +676,205 @@ void vm_run(ir_t *ir_list) {
 		ip++;
 	}
 
-	vm_free();
+	// OP_END stays the next instruction, so running a finished vm again ends at once
+	vm->ip = ip - 1;
+	vm->executed = executed;
+	return VM_DONE;
 }
 
-// ========================================
-// helper declaration
-// ========================================
+static VM_INLINE int vm_pause(vm_t *vm, ir_t *ip, long long executed) {
+	vm->ip = ip;
+	vm->executed = executed;
+	return VM_PAUSED;
+}
+
+void vm_set_var(vm_t *vm, int id, int value) {
+	if (id >= vm->vars_len) {
+		vm->vars_len = (id + 1) * 2;
+		vm->vars = mem_realloc(MEM_VM, vm->vars, vm->vars_len * sizeof(int));
+	}
+	vm->vars[id] = value;
+}
+
+int vm_get_var(vm_t *vm, int id) {
+	return vm->vars[id];
+}
+
+// An i64 is kept in two consecutive int slots, low half first
+void vm_set_var64(vm_t *vm, int id, long long value) {
+	unsigned long long bits = (unsigned long long) value;
+	vm_set_var(vm, id + 1, (int) (unsigned int) (bits >> 32));
+	vm_set_var(vm, id, (int) (unsigned int) bits);
+}
 
-void vm_init(ir_t *ir_list) {
-	g_vars = NULL;
-	g_vars_len = 0;
+long long vm_get_var64(vm_t *vm, int id) {
+	unsigned long long low = (unsigned int) vm->vars[id];
+	unsigned long long high = (unsigned int) vm->vars[id + 1];
+	return (long long) (high << 32 | low);
+}
 
-	for (int i = 1; st_check_var_by_id(i).id != -1; i++) {
-		name_t n = st_check_var_by_id(i);
-		int literal = -1;
-		sscanf(n.name, ".LITERAL_%d", &literal);
-		if (literal != -1) {
-			vm_set_var(n.id, literal);
+bigint_t *vm_big(vm_t *vm, int id) {
+	// bigints are allocated one by one, so the pointers stay valid as more are added
+	if (vm->vars[id] == 0) {
+		if (vm->bigs_cap <= vm->bigs_len) {
+			vm->bigs_cap = (vm->bigs_cap + 1) * 2;
+			vm->bigs = mem_realloc(MEM_VM, vm->bigs, vm->bigs_cap * sizeof(bigint_t *));
+			if (vm->bigs == NULL) {
+				perror("something went wrong with realloc in vm_big");
+				exit(1);
+			}
 		}
-		else {
-			vm_set_var(n.id, 0);
+		bigint_t *big = mem_malloc(MEM_VM, sizeof(bigint_t));
+		if (big == NULL) {
+			perror("something went wrong with malloc in vm_big");
+			exit(1);
 		}
+		bigint_init(big);
+		vm->bigs[vm->bigs_len++] = big;
+		vm->vars[id] = vm->bigs_len;
+	}
+	return vm->bigs[vm->vars[id] - 1];
+}
+
+void vm_set_label(vm_t *vm, int id, ir_t *ir_ptr) {
+	if (id >= vm->labels_len) {
+		vm->labels_len = (id + 1) * 2;
+		vm->labels = mem_realloc(MEM_VM, vm->labels, vm->labels_len * sizeof(ir_t*));
 	}
+	vm->labels[id] = ir_ptr;
+}
 
-	for (ir_t *ir_ptr = ir_list; ir_ptr->op != OP_END; ir_ptr++) {
-		if (ir_ptr->op == OP_LABEL) {
-			vm_set_label(ir_ptr->res_id, ir_ptr);
+ir_t *vm_get_label(vm_t *vm, int id) {
+	return vm->labels[id];
+}
+
+void vm_push_call(vm_t *vm, ir_t *ret) {
+	if (vm->calls_cap <= vm->calls_len) {
+		vm->calls_cap = (vm->calls_cap + 1) * 2;
+		vm->calls = mem_realloc(MEM_VM, vm->calls, vm->calls_cap * sizeof(ir_t *));
+		if (vm->calls == NULL) {
+			perror("something went wrong with realloc in vm_push_call");
+			exit(1);
+		}
+	}
+	vm->calls[vm->calls_len++] = ret;
+}
+
+void vm_error(vm_t *vm, ir_t *ip, const char *message) {
+	// the position is only looked up here, the run itself never touches it
+	ir_pos_t pos = {.index = 0};
+	if (vm->source) pos = ir_builder_pos(vm->source, ip - vm->ir_list);
+
+	if (vm->on_error) {
+		if (pos.start.line > 0) {
+			snprintf(vm->error, VM_ERROR_SIZE, "%s:%d:%d: %s", vm->filepath, pos.start.line, pos.start.column,
+				message);
 		}
+		else snprintf(vm->error, VM_ERROR_SIZE, "%s", message);
+		longjmp(*vm->on_error, 1);
 	}
+
+	if (pos.start.line > 0) error_print(vm->filepath, vm->src, pos.start, pos.end, message);
+	else fprintf(stderr, "%s\n", message);
+	exit(1);
 }
 
-void vm_free() {
-	free(g_vars);
+VM_COLD long long vm_divide_edge(vm_t *vm, ir_t *ip, long long executed, long long left, long long right,
+	long long min) {
+	// the loop keeps its count in a local, vm_error may longjmp out of it
+	vm->executed = executed;
+	if (right == 0) vm_error(vm, ip, "runtime error: division by zero");
+
+	// right is -1: min % -1 is 0 and min / -1 overflows, but both trap in C
+	if (ip->op == OP_MOD || ip->op == OP_MOD_I64) return 0;
+	if (left == min) vm_error(vm, ip, "runtime error: division overflow");
+	return -left;
 }
 
-void vm_set_var(int id, int value) {
-	if (id >= g_vars_len) {
-		g_vars_len = (id + 1) * 2;
-		g_vars = realloc(g_vars, g_vars_len * sizeof(int));
+int vm_element(vm_t *vm, ir_t *ip, long long executed, int array_id, int index) {
+	int len = vm_get_var(vm, array_id);
+	if ((unsigned int) index >= (unsigned int) len) {
+		vm->executed = executed;
+		char message[128];
+		snprintf(message, sizeof(message), "runtime error: index %d is out of bounds for an array of length %d",
+			index, len);
+		vm_error(vm, ip, message);
 	}
-	g_vars[id] = value;
+	return array_id + 1 + index;
 }
 
-int vm_get_var(int id) {
-	return g_vars[id];
+int *vm_array(vm_t *vm, int array_id) {
+	return &vm->vars[array_id + 1];
 }
 
-void vm_set_label(int id, ir_t *ir_ptr) {
-	if (id >= g_labels_len) {
-		g_labels_len = (id + 1) * 2;
-		g_labels = realloc(g_labels, g_labels_len * sizeof(ir_t*));
+void vm_fill(int *dst, int len, int value) {
+	int i = 0;
+#ifdef VM_VECTOR
+	vm_vec_t vec = {value, value, value, value};
+	for (; i + VM_VECTOR <= len; i += VM_VECTOR) {
+		*(vm_vec_t *) (dst + i) = vec;
 	}
-	g_labels[id] = ir_ptr;
+#endif
+	for (; i < len; i++) dst[i] = value;
 }
 
-ir_t *vm_get_label(int id) {
-	return g_labels[id];
+int vm_sum(const int *src, int len) {
+	// summed as unsigned so overflow wraps around
+	unsigned int sum = 0;
+	int i = 0;
+#ifdef VM_VECTOR
+	vm_uvec_t acc = {0, 0, 0, 0};
+	for (; i + VM_VECTOR <= len; i += VM_VECTOR) {
+		acc += *(const vm_uvec_t *) (src + i);
+	}
+	sum = acc[0] + acc[1] + acc[2] + acc[3];
+#endif
+	for (; i < len; i++) sum += (unsigned int) src[i];
+	return (int) sum;
+}
+
+int vm_min(const int *src, int len) {
+	// arrays have at least one element
+	int res = src[0];
+	int i = 0;
+#ifdef VM_VECTOR
+	if (len >= VM_VECTOR) {
+		vm_vec_t acc = *(const vm_vec_t *) src;
+		for (i = VM_VECTOR; i + VM_VECTOR <= len; i += VM_VECTOR) {
+			vm_vec_t vec = *(const vm_vec_t *) (src + i);
+			vm_vec_t mask = vec < acc;
+			acc = (vec & mask) | (acc & ~mask);
+		}
+		for (int k = 0; k < VM_VECTOR; k++) {
+			if (acc[k] < res) res = acc[k];
+		}
+	}
+#endif
+	for (; i < len; i++) {
+		if (src[i] < res) res = src[i];
+	}
+	return res;
+}
+
+int vm_max(const int *src, int len) {
+	// arrays have at least one element
+	int res = src[0];
+	int i = 0;
+#ifdef VM_VECTOR
+	if (len >= VM_VECTOR) {
+		vm_vec_t acc = *(const vm_vec_t *) src;
+		for (i = VM_VECTOR; i + VM_VECTOR <= len; i += VM_VECTOR) {
+			vm_vec_t vec = *(const vm_vec_t *) (src + i);
+			vm_vec_t mask = vec > acc;
+			acc = (vec & mask) | (acc & ~mask);
+		}
+		for (int k = 0; k < VM_VECTOR; k++) {
+			if (acc[k] > res) res = acc[k];
+		}
+	}
+#endif
+	for (; i < len; i++) {
+		if (src[i] > res) res = src[i];
+	}
+	return res;
 }
@@ -0,0 +1,71 @@
+#!/bin/sh
+# Compile and run programs nested 10^6 levels deep with a small stack, so any
+# recursion left in the parser, analyzer or ir builder crashes the run.
+#
+# Usage: tests/deep.sh [path to smol] [depth]
+
+SMOL=${1:-./build/smol}
+DEPTH=${2:-1000000}
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+fail=0
+
+# check <name> <expected output>: runs $DIR/<name>.smol
+check() {
+	out=$(ulimit -s 512; "$SMOL" "$DIR/$1.smol" 2>&1 | tail -n 1)
+	if [ "$out" = "$2" ]; then
+		echo "ok   $1"
+	else
+		echo "FAIL $1: expected '$2', got '$out'"
+		fail=1
+	fi
+}
+
+awk -v n="$DEPTH" 'BEGIN {
+	printf "print "
+	for (i = 0; i < n; i++) printf "("
+	printf "7"
+	for (i = 0; i < n; i++) printf ")"
+	print ";"
+}' > "$DIR/parens.smol"
+check parens 7
+
+awk -v n="$DEPTH" 'BEGIN {
+	printf "print "
+	for (i = 0; i < n; i++) printf "- "
+	print "7;"
+}' > "$DIR/unary.smol"
+check unary $((DEPTH % 2 ? -7 : 7))
+
+awk -v n="$DEPTH" 'BEGIN {
+	for (i = 0; i < n; i++) printf "if (1) "
+	print "print 7;"
+}' > "$DIR/ifs.smol"
+check ifs 7
+
+awk -v n="$DEPTH" 'BEGIN {
+	print "var x = " n - 1 ";"
+	printf "if (x == 0) print 0;"
+	for (i = 1; i < n; i++) printf " else if (x == %d) print %d;", i, i
+	print ""
+}' > "$DIR/else_if.smol"
+check else_if $((DEPTH - 1))
+
+awk -v n="$DEPTH" 'BEGIN {
+	printf "print 7"
+	for (i = 1; i < n; i++) printf " + 7"
+	print ";"
+}' > "$DIR/binary.smol"
+check binary $((DEPTH * 7))
+
+awk -v n="$DEPTH" 'BEGIN {
+	printf "print "
+	for (i = 0; i < n; i++) printf "1 ? "
+	printf "7"
+	for (i = 0; i < n; i++) printf " : 0"
+	print ";"
+}' > "$DIR/ternary.smol"
+check ternary 7
+
+exit $fail
@@ -0,0 +1,74 @@
+#!/bin/sh
+# Run programs that fail at runtime and check that they exit with 1, keep the
+# output printed before the error and report the line of the failing statement.
+#
+# Usage: tests/errors.sh [path to smol]
+
+SMOL=${1:-./build/smol}
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+fail=0
+
+# check <name> <expected output> <expected error>: runs $DIR/<name>.smol
+check() {
+	out=$("$SMOL" "$DIR/$1.smol" 2> "$DIR/$1.err")
+	rc=$?
+	err=$(head -n 1 "$DIR/$1.err")
+	if [ $rc -eq 1 ] && [ "$out" = "$2" ] && [ "$err" = "$DIR/$1.smol:$3" ]; then
+		echo "ok   $1"
+	else
+		echo "FAIL $1: exit $rc, output '$out', error '$err'"
+		fail=1
+	fi
+}
+
+cat > "$DIR/div_zero.smol" << EOF
+var a = 7;
+var b = 0;
+print 1;
+print a / b;
+EOF
+check div_zero 1 "4:1: runtime error: division by zero"
+
+cat > "$DIR/mod_zero.smol" << EOF
+var a = 7;
+var b = 0;
+print 1;
+a %= b;
+EOF
+check mod_zero 1 "4:1: runtime error: division by zero"
+
+cat > "$DIR/div_overflow.smol" << EOF
+var a = -2147483647 - 1;
+var b = -1;
+print a % b;
+print a / b;
+EOF
+check div_overflow 0 "4:1: runtime error: division overflow"
+
+cat > "$DIR/div_zero_i64.smol" << EOF
+var a: i64 = 7;
+var b: i64 = 0;
+print 1;
+print a % b;
+EOF
+check div_zero_i64 1 "4:1: runtime error: division by zero"
+
+cat > "$DIR/div_overflow_i64.smol" << EOF
+var a: i64 = -9223372036854775807 - 1;
+var b: i64 = -1;
+print a % b;
+print a / b;
+EOF
+check div_overflow_i64 0 "4:1: runtime error: division overflow"
+
+cat > "$DIR/bounds.smol" << EOF
+var a[3];
+var i = 3;
+print 1;
+print a[i];
+EOF
+check bounds 1 "4:1: runtime error: index 3 is out of bounds for an array of length 3"
+
+exit $fail
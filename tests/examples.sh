@@ -0,0 +1,23 @@
+#!/bin/sh
+# Run every tests/*.smol and compare its output with the tests/*.out next to
+# it, with and without inlining.
+#
+# Usage: tests/examples.sh [path to smol]
+
+SMOL=${1:-./build/smol}
+TESTS=$(dirname "$0")
+
+fail=0
+for src in "$TESTS"/*.smol; do
+	name=$(basename "$src" .smol)
+	for flag in "" --no-inline; do
+		if "$SMOL" $flag "$src" 2>&1 | cmp -s - "$TESTS/$name.out"; then
+			echo "ok   $name $flag"
+		else
+			echo "FAIL $name $flag"
+			fail=1
+		fi
+	done
+done
+
+exit $fail
@@ -0,0 +1,72 @@
+#!/bin/sh
+# Run several programs with --workers where one of them fails at runtime, and
+# check that the others still run to their end and keep their output, and that
+# the instructions of the failing slice are still counted by --stats.
+#
+# Usage: tests/workers.sh [path to smol]
+
+SMOL=${1:-./build/smol}
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+fail=0
+
+cat > "$DIR/good.smol" << EOF
+var i = 0;
+var s = 0;
+while (i < 50000) {
+	s = (s + i) % 1000;
+	++i;
+}
+print i;
+print s;
+EOF
+
+# fails after running for several slices
+cat > "$DIR/bad.smol" << EOF
+print 5;
+var d = 2000;
+var x = 0;
+while (d >= 0) {
+	x += 100000 / d;
+	--d;
+}
+print x;
+EOF
+
+expected_out="50000
+0
+5
+50000
+0"
+expected_err="$DIR/bad.smol:5:2: runtime error: division by zero"
+
+# instructions of one run of good.smol on its own
+good=$("$SMOL" --stats "$DIR/good.smol" 2>&1 | awk '$1 == "executed_instructions" { print $2 }')
+
+# the total has to be the same however the run is cut into slices, so that the
+# slice that fails is counted too
+total=
+for workers in 1 2 4; do
+	for slice in 7 1000 10000; do
+		out=$("$SMOL" --workers $workers --slice $slice --stats "$DIR/good.smol" "$DIR/bad.smol" \
+			"$DIR/good.smol" 2> "$DIR/err")
+		rc=$?
+		err=$(head -n 1 "$DIR/err")
+		instructions=$(awk '$1 == "instructions" { print $2 }' "$DIR/err")
+		per_worker=$(awk '$1 == "worker" { rows = 1; next } rows && NF == 4 { sum += $2 } END { print sum }' \
+			"$DIR/err")
+		[ -z "$total" ] && total=$instructions
+		if [ $rc -eq 1 ] && [ "$out" = "$expected_out" ] && [ "$err" = "$expected_err" ] \
+			&& [ "$instructions" = "$total" ] && [ "$per_worker" = "$total" ] \
+			&& [ "$instructions" -gt $((good * 2)) ]; then
+			echo "ok   --workers $workers --slice $slice"
+		else
+			echo "FAIL --workers $workers --slice $slice: exit $rc, output '$out', error '$err'," \
+				"instructions $instructions (per worker $per_worker, first run $total)"
+			fail=1
+		fi
+	done
+done
+
+exit $fail